@@ -0,0 +1,93 @@
+// Code generation throughput on a synthetic program of about 100k
+// statements: functions whose bodies nest loops and ifs several levels deep,
+// so the cost of assembling nested output shows up.
+//
+// Usage: codegen_bench [statements] [repetitions]
+#include "compiler/lexer.h"
+#include "compiler/parser.h"
+#include "compiler/codegen.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace umbrella;
+
+namespace {
+const int DEPTH = 8;
+
+// One function: at each nesting level a few statements, then the next level.
+void emitFunction(std::ostringstream& source, int index, int& statements) {
+    source << "function f" << index << "(n: number, s: string): number {\n";
+    source << "    let acc = 0;\n";
+    source << "    let text = s;\n";
+    statements += 2;
+    std::string pad = "    ";
+    for (int level = 0; level < DEPTH; level++) {
+        std::string v = "i" + std::to_string(level);
+        switch (level % 3) {
+            case 0:
+                source << pad << "for (let " << v << " = 0; " << v << " < n; " << v << " = " << v << " + 1) {\n";
+                break;
+            case 1:
+                source << pad << "if (acc > " << level << " && n != " << level << ") {\n";
+                break;
+            default:
+                source << pad << "while (acc < " << (level + 1) * 100 << ") {\n";
+                break;
+        }
+        statements++;
+        pad += "    ";
+        source << pad << "acc = acc + " << level << " * 2 - (acc / 3);\n";
+        source << pad << "text = text + \"x\" + toString(acc);\n";
+        source << pad << "let t" << level << " = acc > 10 ? acc - 1 : acc + 1;\n";
+        source << pad << "acc = Math.max(acc, t" << level << ");\n";
+        statements += 4;
+    }
+    for (int level = DEPTH; level > 0; level--) {
+        pad.resize(pad.size() - 4);
+        source << pad << "}\n";
+    }
+    source << "    println(text);\n";
+    source << "    return acc;\n";
+    source << "}\n\n";
+    statements += 2;
+}
+}
+
+int main(int argc, char* argv[]) {
+    int target = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::ostringstream source;
+    int statements = 0;
+    int functions = 0;
+    while (statements < target) emitFunction(source, functions++, statements);
+    source << "function main() {\n";
+    for (int i = 0; i < functions; i++) source << "    f" << i << "(3, \"a\");\n";
+    source << "}\n";
+    statements += functions;
+
+    Lexer lexer(source.str());
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    auto program = parser.parse();
+
+    double best = 1e300;
+    size_t bytes = 0;
+    for (int i = 0; i < repetitions; i++) {
+        CodeGenerator codegen;
+        auto start = std::chrono::steady_clock::now();
+        std::string code = codegen.generate(*program);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        bytes = code.size();
+    }
+    std::cout << "statements:  " << statements << " in " << functions << " functions\n";
+    std::cout << "output:      " << bytes / 1024 << " KiB of C++\n";
+    std::cout << "generate():  " << best * 1000 << " ms (best of " << repetitions << ")\n";
+    std::cout << "throughput:  " << statements / best / 1e6 << " M statements/s, "
+              << bytes / best / (1024 * 1024) << " MiB/s\n";
+    return 0;
+}
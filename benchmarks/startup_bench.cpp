@@ -0,0 +1,82 @@
+// Process startup latency: compiles an Umbrella program with the default
+// settings and with --fast-start, then runs each binary many times (output
+// discarded) and reports the wall-clock time from spawn to exit.
+//
+// Usage: startup_bench <umbrella> <program.umb> [runs]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+struct Variant {
+    const char* name;
+    const char* flags;
+};
+
+// Microseconds for each run of the binary, or an empty vector if it fails.
+std::vector<double> timeRuns(const std::string& binary, int runs) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    char* argv[] = {const_cast<char*>(binary.c_str()), nullptr};
+    char* envp[] = {nullptr};
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid;
+        if (posix_spawn(&pid, binary.c_str(), &actions, nullptr, argv, envp) != 0) break;
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status)) break;
+        times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    if (static_cast<int>(times.size()) != runs) times.clear();
+    return times;
+}
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: startup_bench <umbrella> <program.umb> [runs]\n";
+        return 1;
+    }
+    std::string umbrella = argv[1];
+    std::string program = argv[2];
+    int runs = argc > 3 ? std::atoi(argv[3]) : 500;
+
+    const Variant variants[] = {{"default", ""}, {"--fast-start", " --fast-start"}};
+    std::cout << "program: " << program << ", " << runs << " runs each\n";
+    for (const auto& variant : variants) {
+        std::string binary = "/tmp/umbrella_startup_bench_" + std::to_string(getpid()) + "_" +
+                             (variant.flags[0] ? "fast" : "default");
+        std::string compile = umbrella + " " + program + " --no-run -o " + binary + variant.flags + " > /dev/null";
+        if (std::system(compile.c_str()) != 0) {
+            std::cerr << "Error: could not compile " << program << variant.flags << "\n";
+            return 1;
+        }
+        timeRuns(binary, std::min(runs, 20)); // warm the page cache
+        std::vector<double> times = timeRuns(binary, runs);
+        std::remove(binary.c_str());
+        if (times.empty()) {
+            std::cerr << "Error: " << program << " (" << variant.name << ") did not exit normally\n";
+            return 1;
+        }
+        std::sort(times.begin(), times.end());
+        double mean = 0;
+        for (double t : times) mean += t;
+        mean /= times.size();
+        std::cout << variant.name << ": min " << times.front() << " us, median " << times[times.size() / 2]
+                  << " us, mean " << mean << " us, p99 " << times[times.size() * 99 / 100] << " us\n";
+    }
+    return 0;
+}
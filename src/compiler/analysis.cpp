@@ -0,0 +1,659 @@
+#include "analysis.h"
+#include <algorithm>
+namespace umbrella {
+namespace {
+// Array helpers that call their callback before returning and never store it.
+const std::set<std::string> synchronousHelpers = {
+    "map", "filter", "reduce", "forEach", "find", "findIndex", "some", "every", "sort",
+    "tryFind", "findOr", "parallelMap", "parallelFilter", "parallelReduce"
+};
+// Runtime methods that do not modify their receiver (all const in runtime.h,
+// or rewritten to static String helpers by the code generator).
+const std::set<std::string> readOnlyMethods = {
+    "length", "join", "map", "filter", "reduce", "forEach", "find", "findIndex", "some",
+    "every", "includes", "indexOf", "slice", "get", "has", "size", "keys", "values",
+    "toString", "toUpperCase", "toLowerCase", "substring", "replace", "split", "trim",
+    "startsWith", "endsWith", "repeat", "padStart", "padEnd", "isEmpty", "concat",
+    "lastIndexOf", "at", "lazy", "toArray", "parallelMap", "parallelFilter", "parallelReduce",
+    "tryFind", "findOr", "tryGet", "getOrDefault"
+};
+// Operations that run a lazy pipeline (Array::lazy) to completion.
+const std::set<std::string> pipelineTerminals = {"reduce", "forEach", "some", "every", "toArray"};
+
+// Whether `call` is a map/filter stage of a chain that starts at `.lazy()`.
+bool isLazyStage(const CallExpression* call) {
+    const Expression* expr = call;
+    while (auto stage = dynamic_cast<const CallExpression*>(expr)) {
+        auto member = dynamic_cast<const MemberExpression*>(stage->callee.get());
+        if (!member) return false;
+        if (member->property == "lazy") return stage != call;
+        if (member->property != "map" && member->property != "filter") return false;
+        expr = member->object.get();
+    }
+    return false;
+}
+
+// `a` for `a`, `a.b` and `a.b.c`; nullptr once an index or call is involved.
+const Identifier* memberRoot(const Expression* expr) {
+    while (auto member = dynamic_cast<const MemberExpression*>(expr)) expr = member->object.get();
+    return dynamic_cast<const Identifier*>(expr);
+}
+
+class ResizeCollector : public ASTVisitor {
+public:
+    std::set<std::string> resized;
+    bool visitExpression(const Expression* expr) override {
+        if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            if (auto root = memberRoot(assign->left.get())) resized.insert(root->name);
+        } else if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            auto member = dynamic_cast<const MemberExpression*>(call->callee.get());
+            auto root = member ? memberRoot(member->object.get()) : nullptr;
+            if (root && !readOnlyMethods.count(member->property)) resized.insert(root->name);
+        }
+        return true;
+    }
+};
+
+// A call or `new` that may run user code: functions, callbacks held in
+// variables, user methods and constructors, and runtime helpers handed a
+// callback that is not an inline lambda (inline ones are scanned in place).
+bool isUserCall(const Expression* expr, const std::set<std::string>& userMethods,
+                const std::set<std::string>& objectClasses) {
+    if (auto newExpr = dynamic_cast<const NewExpression*>(expr)) {
+        return objectClasses.count(newExpr->className) > 0;
+    }
+    auto call = dynamic_cast<const CallExpression*>(expr);
+    if (!call) return false;
+    if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) {
+        return id->name != "print" && id->name != "println" && id->name != "toString";
+    }
+    auto member = dynamic_cast<const MemberExpression*>(call->callee.get());
+    if (!member) return true;
+    if (userMethods.count(member->property)) return true;
+    if (!synchronousHelpers.count(member->property)) return false;
+    for (const auto& arg : call->arguments) {
+        if (!dynamic_cast<const FunctionExpression*>(arg.get())) return true;
+    }
+    return false;
+}
+class UserCallFinder : public ASTVisitor {
+public:
+    const std::set<std::string>& userMethods;
+    const std::set<std::string>& objectClasses;
+    bool found = false;
+    UserCallFinder(const std::set<std::string>& methods, const std::set<std::string>& classes)
+        : userMethods(methods), objectClasses(classes) {}
+    bool visitExpression(const Expression* expr) override {
+        found |= isUserCall(expr, userMethods, objectClasses);
+        return !found;
+    }
+};
+
+struct Local {
+    int count = 0;
+    const VariableDeclaration* decl = nullptr;
+    const FunctionParameter* param = nullptr;
+    long declSeq = 0;
+    size_t lambdaDepth = 0;
+    Type type = Type::ANY;
+    bool mutated = false;
+    // Assigned as a whole (`x = ...`), as opposed to through a member or index.
+    bool reassigned = false;
+    bool forInit = false;
+    // Root of `container[i]...` when the local is initialized from an element.
+    std::string elementOf;
+};
+struct Use {
+    const Identifier* node;
+    std::string name;
+    long seq;
+    bool callee;
+    bool sink;
+    size_t lambdaDepth;
+    long statementStart;
+    long region;
+};
+struct Lambda {
+    const FunctionExpression* node;
+    long start = 0;
+    long end = 0;
+    long statementStart = 0;
+    std::vector<long> regions;
+};
+
+const Identifier* rootIdentifier(const Expression* expr) {
+    while (true) {
+        if (auto access = dynamic_cast<const ArrayAccess*>(expr)) {
+            expr = access->array.get();
+        } else if (auto member = dynamic_cast<const MemberExpression*>(expr)) {
+            expr = member->object.get();
+        } else {
+            return dynamic_cast<const Identifier*>(expr);
+        }
+    }
+}
+
+// Records declarations, uses, mutations and lambdas of one function in
+// source order. Loops and lambdas are "regions" whose code may run more
+// than once per declaration of the variables outside them.
+class FunctionScanner : public ASTVisitor {
+public:
+    std::map<std::string, Local> locals;
+    std::vector<Use> uses;
+    std::vector<Lambda> lambdas;
+    std::set<const FunctionExpression*> synchronous;
+    std::map<std::string, const FunctionExpression*> lambdaLocals;
+    // Positions of calls that may run user code (see isUserCall).
+    std::vector<long> userCalls;
+
+    FunctionScanner(const std::set<std::string>& methods, const std::set<std::string>& classes)
+        : userMethods(methods), objectClasses(classes) {}
+
+    void declare(const std::string& name, Type type, const VariableDeclaration* decl,
+                 const FunctionParameter* param = nullptr) {
+        Local& local = locals[name];
+        local.count++;
+        local.decl = decl;
+        local.param = param;
+        local.declSeq = seq;
+        local.lambdaDepth = open.size();
+        local.type = type;
+        local.forInit = decl && forInits.count(decl);
+    }
+    bool visitStatement(const Statement* stmt) override {
+        seq++;
+        statements.push_back(seq);
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+            declare(decl->name, decl->varType, decl);
+            if (auto lambda = dynamic_cast<const FunctionExpression*>(decl->initializer.get())) {
+                lambdaLocals[decl->name] = lambda;
+            }
+            if (auto id = dynamic_cast<const Identifier*>(decl->initializer.get())) sinks.insert(id);
+            if (auto access = dynamic_cast<const ArrayAccess*>(decl->initializer.get())) {
+                if (auto root = rootIdentifier(access)) locals[decl->name].elementOf = root->name;
+            }
+        } else if (auto forStmt = dynamic_cast<const ForStatement*>(stmt)) {
+            regions.push_back(seq);
+            if (auto init = dynamic_cast<const VariableDeclaration*>(forStmt->initializer.get())) {
+                forInits.insert(init);
+            }
+        } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+            // The bindings alias elements (or are per-iteration copies), so they
+            // are neither boxed nor moved from.
+            regions.push_back(seq);
+            declare(forOf->name, Type::ANY, nullptr);
+            if (!forOf->valueName.empty()) declare(forOf->valueName, Type::ANY, nullptr);
+        } else if (dynamic_cast<const WhileStatement*>(stmt)) {
+            regions.push_back(seq);
+        }
+        return true;
+    }
+    void leaveStatement(const Statement* stmt) override {
+        statements.pop_back();
+        if (dynamic_cast<const ForStatement*>(stmt) || dynamic_cast<const ForOfStatement*>(stmt) ||
+            dynamic_cast<const WhileStatement*>(stmt)) {
+            regions.pop_back();
+        }
+    }
+    bool visitExpression(const Expression* expr) override {
+        seq++;
+        if (isUserCall(expr, userMethods, objectClasses)) userCalls.push_back(seq);
+        if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            for (const auto& arg : call->arguments) {
+                if (auto id = dynamic_cast<const Identifier*>(arg.get())) sinks.insert(id);
+            }
+            if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) {
+                callees.insert(id);
+            } else if (auto lambda = dynamic_cast<const FunctionExpression*>(call->callee.get())) {
+                synchronous.insert(lambda);
+            } else if (auto member = dynamic_cast<const MemberExpression*>(call->callee.get())) {
+                // Lazy stages keep their callback until a terminal operation
+                // runs the pipeline; the callbacks escape unless that happens
+                // in the same expression. A user method of the same name may
+                // keep its callback, so only runtime helpers count.
+                bool userMethod = userMethods.count(member->property) > 0;
+                if (synchronousHelpers.count(member->property) && !userMethod && !isLazyStage(call)) {
+                    for (const auto& arg : call->arguments) {
+                        if (auto lambda = dynamic_cast<const FunctionExpression*>(arg.get())) {
+                            synchronous.insert(lambda);
+                        }
+                    }
+                }
+                if (pipelineTerminals.count(member->property) && !userMethod) {
+                    auto stage = dynamic_cast<const CallExpression*>(member->object.get());
+                    while (stage && isLazyStage(stage)) {
+                        for (const auto& arg : stage->arguments) {
+                            if (auto lambda = dynamic_cast<const FunctionExpression*>(arg.get())) {
+                                synchronous.insert(lambda);
+                            }
+                        }
+                        stage = dynamic_cast<const CallExpression*>(
+                            static_cast<const MemberExpression*>(stage->callee.get())->object.get());
+                    }
+                }
+                auto root = rootIdentifier(member->object.get());
+                bool readOnly = readOnlyMethods.count(member->property) && !userMethod;
+                if (root && !readOnly) markMutated(root->name);
+            }
+        } else if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            if (auto root = rootIdentifier(assign->left.get())) markMutated(root->name);
+            if (auto target = dynamic_cast<const Identifier*>(assign->left.get())) {
+                auto it = locals.find(target->name);
+                if (it != locals.end()) it->second.reassigned = true;
+            }
+            if (auto id = dynamic_cast<const Identifier*>(assign->right.get())) {
+                if (assign->op == "=") sinks.insert(id);
+            }
+        } else if (auto id = dynamic_cast<const Identifier*>(expr)) {
+            uses.push_back({id, id->name, seq, callees.count(id) > 0, sinks.count(id) > 0, open.size(),
+                            statements.empty() ? 0 : statements.back(), regions.empty() ? 0 : regions.back()});
+        } else if (auto lambda = dynamic_cast<const FunctionExpression*>(expr)) {
+            Lambda info;
+            info.node = lambda;
+            info.start = seq;
+            info.statementStart = statements.empty() ? 0 : statements.back();
+            info.regions = regions;
+            open.push_back(lambdas.size());
+            lambdas.push_back(info);
+            regions.push_back(seq);
+            for (const auto& param : lambda->parameters) declare(param.name, param.type, nullptr, &param);
+        }
+        return true;
+    }
+    void leaveExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) {
+            lambdas[open.back()].end = seq;
+            open.pop_back();
+            regions.pop_back();
+        }
+    }
+private:
+    long seq = 0;
+    std::vector<long> statements;
+    std::vector<long> regions;
+    std::vector<size_t> open;
+    std::set<const Identifier*> callees;
+    std::set<const Identifier*> sinks;
+    std::set<const VariableDeclaration*> forInits;
+    const std::set<std::string>& userMethods;
+    const std::set<std::string>& objectClasses;
+
+    void markMutated(const std::string& name) {
+        auto it = locals.find(name);
+        if (it != locals.end()) it->second.mutated = true;
+    }
+};
+}
+
+bool isReadOnlyMethod(const std::string& name) {
+    return readOnlyMethods.count(name) > 0;
+}
+
+bool isSynchronousHelper(const std::string& name) {
+    return synchronousHelpers.count(name) > 0;
+}
+
+std::set<std::string> collectResizedNames(const std::vector<std::unique_ptr<Statement>>& body) {
+    ResizeCollector collector;
+    walk(body, collector);
+    return std::move(collector.resized);
+}
+std::set<std::string> collectResizedNames(const Statement* stmt) {
+    ResizeCollector collector;
+    walk(stmt, collector);
+    return std::move(collector.resized);
+}
+
+void CaptureAnalysis::analyze(const Program& program) {
+    lambdas.clear();
+    boxed.clear();
+    globals.clear();
+    userMethods.clear();
+    objectClasses.clear();
+    readOnlyParams.clear();
+    elementReferences.clear();
+    lastUses.clear();
+    for (const auto& stmt : program.statements) {
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt.get())) {
+            globals.insert(decl->name);
+        } else if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt.get())) {
+            // User methods are emitted non-const, so calling one may mutate.
+            for (const auto& method : classDecl->methods) userMethods.insert(method.name);
+            if (!classDecl->soa) objectClasses.insert(classDecl->name);
+        }
+    }
+    for (const auto& stmt : program.statements) {
+        if (auto func = dynamic_cast<const FunctionDeclaration*>(stmt.get())) {
+            analyzeFunction(func->parameters, func->body);
+        } else if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt.get())) {
+            if (classDecl->constructor) {
+                analyzeFunction(classDecl->constructor->parameters, classDecl->constructor->body);
+            }
+            for (const auto& method : classDecl->methods) {
+                analyzeFunction(method.parameters, method.body);
+            }
+        }
+    }
+}
+
+void CaptureAnalysis::analyzeFunction(const std::vector<FunctionParameter>& params,
+                                      const std::vector<std::unique_ptr<Statement>>& body) {
+    FunctionScanner scanner(userMethods, objectClasses);
+    for (const auto& param : params) scanner.declare(param.name, param.type, nullptr, &param);
+    walk(body, scanner);
+
+    std::set<std::string> called, captured;
+    for (const auto& use : scanner.uses) {
+        if (use.callee) called.insert(use.name);
+        if (use.lambdaDepth != scanner.locals[use.name].lambdaDepth) captured.insert(use.name);
+    }
+    auto heavy = [](Type type) {
+        return type != Type::NUMBER && type != Type::BOOLEAN && type != Type::FUNCTION && type != Type::VOID;
+    };
+
+    // Parameters that are only read are passed by const reference. Untyped
+    // parameters that are called might be mutable lambdas and stay by value.
+    // A parameter declared with a class type is a Ref: writes to the object's
+    // fields go through a const Ref& as well, so only reassigning it counts,
+    // and passing it costs no reference count update. Other values keep
+    // their copy when the function calls user code, which could change the
+    // global or field the caller passed.
+    for (const auto& entry : scanner.locals) {
+        const Local& local = entry.second;
+        if (!local.param || local.count != 1 || !heavy(local.type)) continue;
+        bool object = objectClasses.count(local.param->cppType) > 0;
+        if (local.mutated && (local.reassigned || !object)) continue;
+        if (local.type == Type::ANY && called.count(entry.first)) continue;
+        if (!object && !scanner.userCalls.empty()) continue;
+        readOnlyParams.insert(local.param);
+    }
+
+    // `let row = rows[i]` binds a const reference when neither the element
+    // nor its container (a local of this function, never resized meanwhile)
+    // is modified in this function and no user code runs after the binding.
+    for (const auto& entry : scanner.locals) {
+        const Local& local = entry.second;
+        if (!local.decl || local.count != 1 || local.mutated || local.elementOf.empty()) continue;
+        if (!heavy(local.type)) continue;
+        auto container = scanner.locals.find(local.elementOf);
+        if (container == scanner.locals.end() || container->second.count != 1 || !container->second.decl ||
+            container->second.mutated || globals.count(local.elementOf)) {
+            continue;
+        }
+        if (!scanner.userCalls.empty() && scanner.userCalls.back() > local.declSeq) continue;
+        // Indexing a string yields a char, not a std::string to refer to.
+        if (local.type == Type::STRING && container->second.type != Type::ARRAY) continue;
+        elementReferences.insert(local.decl);
+    }
+
+    // A local holding a lambda that is only ever called, never passed on or
+    // captured, dies with the function and can capture by reference too.
+    for (const auto& entry : scanner.lambdaLocals) {
+        const Local& local = scanner.locals[entry.first];
+        if (local.count != 1) continue;
+        bool onlyCalled = true;
+        for (const auto& use : scanner.uses) {
+            if (use.name == entry.first && (!use.callee || use.lambdaDepth != local.lambdaDepth)) {
+                onlyCalled = false;
+                break;
+            }
+        }
+        if (onlyCalled) scanner.synchronous.insert(entry.second);
+    }
+
+    auto capturedBy = [&](const Lambda& lambda) {
+        std::vector<std::string> names;
+        for (const auto& use : scanner.uses) {
+            if (use.seq <= lambda.start || use.seq > lambda.end) continue;
+            const Local& local = scanner.locals[use.name];
+            if (local.count != 1 || local.declSeq >= lambda.start) continue;
+            if (std::find(names.begin(), names.end(), use.name) == names.end()) names.push_back(use.name);
+        }
+        return names;
+    };
+
+    // Shared state: mutated locals (or objects, which have reference
+    // semantics) captured by a lambda that outlives the call.
+    for (const auto& lambda : scanner.lambdas) {
+        if (scanner.synchronous.count(lambda.node)) continue;
+        for (const auto& name : capturedBy(lambda)) {
+            const Local& local = scanner.locals[name];
+            if (!local.decl || local.forInit || globals.count(name)) continue;
+            bool isObject = dynamic_cast<const NewExpression*>(local.decl->initializer.get()) != nullptr;
+            if (local.mutated || isObject) boxed.insert(local.decl);
+        }
+    }
+
+    for (const auto& lambda : scanner.lambdas) {
+        LambdaInfo& info = lambdas[lambda.node];
+        info.escapes = !scanner.synchronous.count(lambda.node);
+        if (!info.escapes) continue;
+        for (const auto& name : capturedBy(lambda)) {
+            const Local& local = scanner.locals[name];
+            if (local.forInit || boxed.count(local.decl) || (local.decl && local.decl->isConst)) continue;
+            if (readOnlyParams.count(local.param) || elementReferences.count(local.decl)) continue;
+            if (local.type == Type::NUMBER || local.type == Type::BOOLEAN || local.type == Type::FUNCTION) continue;
+            // The capture runs once per declaration only if no loop or lambda
+            // between the declaration and the capture can repeat it.
+            bool once = true;
+            for (long region : lambda.regions) {
+                if (local.declSeq <= region) once = false;
+            }
+            // Nothing else in this statement or after it may read the local.
+            bool lastUse = true;
+            for (const auto& use : scanner.uses) {
+                bool inside = use.seq > lambda.start && use.seq <= lambda.end;
+                if (use.name == name && !inside && use.seq >= lambda.statementStart) lastUse = false;
+            }
+            if (once && lastUse) info.moved.push_back(name);
+        }
+    }
+
+    // Move a local into a call argument, assignment or initializer when that
+    // is its last use: nothing later in the function, nothing else in the same
+    // statement, no loop around the use that outlives the local, and no
+    // closure that could still read it.
+    for (const auto& use : scanner.uses) {
+        if (!use.sink) continue;
+        const Local& local = scanner.locals[use.name];
+        if (local.count != 1 || !heavy(local.type) || local.forInit || globals.count(use.name)) continue;
+        if (!local.decl && !local.param) continue;
+        if (local.decl && (local.decl->isConst || boxed.count(local.decl) || elementReferences.count(local.decl))) continue;
+        if (readOnlyParams.count(local.param) || captured.count(use.name)) continue;
+        if (use.region > local.declSeq) continue;
+        bool last = true;
+        for (const auto& other : scanner.uses) {
+            if (other.name == use.name && other.node != use.node && other.seq >= use.statementStart) {
+                last = false;
+                break;
+            }
+        }
+        if (last) lastUses.insert(use.node);
+    }
+}
+
+bool CaptureAnalysis::isAnalyzed(const FunctionExpression* lambda) const {
+    return lambdas.count(lambda) > 0;
+}
+
+bool CaptureAnalysis::escapes(const FunctionExpression* lambda) const {
+    auto it = lambdas.find(lambda);
+    return it == lambdas.end() || it->second.escapes;
+}
+
+const std::vector<std::string>& CaptureAnalysis::movedCaptures(const FunctionExpression* lambda) const {
+    static const std::vector<std::string> none;
+    auto it = lambdas.find(lambda);
+    return it == lambdas.end() ? none : it->second.moved;
+}
+
+bool CaptureAnalysis::isBoxed(const VariableDeclaration* decl) const {
+    return boxed.count(decl) > 0;
+}
+
+bool CaptureAnalysis::isReadOnlyParameter(const FunctionParameter* param) const {
+    return readOnlyParams.count(param) > 0;
+}
+
+bool CaptureAnalysis::isElementReference(const VariableDeclaration* decl) const {
+    return elementReferences.count(decl) > 0;
+}
+
+bool CaptureAnalysis::isLastUse(const Identifier* id) const {
+    return lastUses.count(id) > 0;
+}
+
+bool CaptureAnalysis::isGlobal(const std::string& name) const {
+    return globals.count(name) > 0;
+}
+
+bool CaptureAnalysis::callsUserCode(const std::vector<std::unique_ptr<Statement>>& body) const {
+    UserCallFinder finder(userMethods, objectClasses);
+    walk(body, finder);
+    return finder.found;
+}
+
+void ClassHierarchy::analyze(const Program& program) {
+    classes.clear();
+    children.clear();
+    for (const auto& stmt : program.statements) {
+        if (auto decl = dynamic_cast<const ClassDeclaration*>(stmt.get())) classes[decl->name] = decl;
+    }
+    for (const auto& [name, decl] : classes) {
+        if (classes.count(decl->superclass)) children[decl->superclass].push_back(decl);
+    }
+}
+
+const ClassDeclaration* ClassHierarchy::find(const std::string& name) const {
+    auto it = classes.find(name);
+    return it == classes.end() ? nullptr : it->second;
+}
+
+bool ClassHierarchy::isExtended(const std::string& name) const {
+    return children.count(name) > 0;
+}
+
+const ClassDeclaration* ClassHierarchy::definingClass(const std::string& name, const std::string& method) const {
+    // Bounded by the number of classes in case of an `extends` cycle.
+    const ClassDeclaration* decl = find(name);
+    for (size_t depth = 0; decl && depth <= classes.size(); depth++) {
+        if (findMethod(decl, method)) return decl;
+        decl = find(decl->superclass);
+    }
+    return nullptr;
+}
+
+std::vector<const ClassDeclaration*> ClassHierarchy::descendants(const std::string& name) const {
+    std::vector<const ClassDeclaration*> result;
+    std::set<std::string> seen = {name};
+    std::vector<std::string> pending = {name};
+    while (!pending.empty()) {
+        auto it = children.find(pending.back());
+        pending.pop_back();
+        if (it == children.end()) continue;
+        for (const ClassDeclaration* child : it->second) {
+            if (!seen.insert(child->name).second) continue;
+            result.push_back(child);
+            pending.push_back(child->name);
+        }
+    }
+    return result;
+}
+
+const MethodDeclaration* findMethod(const ClassDeclaration* decl, const std::string& name) {
+    for (const auto& method : decl->methods) {
+        if (method.name == name) return &method;
+    }
+    return nullptr;
+}
+
+namespace {
+// Finds an error that leaves the statements: a `throw` or a call that can
+// throw, outside every try block (a `try` stops any error, with or without
+// `catch`). Lambdas are not entered, and neither are finally blocks, which
+// cannot pass an error on.
+class EscapingThrowFinder : public ASTVisitor {
+public:
+    explicit EscapingThrowFinder(const ThrowAnalysis& analysis) : analysis(analysis) {}
+    bool found = false;
+    bool visitStatement(const Statement* stmt) override {
+        if (found) return false;
+        if (auto tryStmt = dynamic_cast<const TryStatement*>(stmt)) {
+            walk(tryStmt->catchBlock, *this);
+            return false;
+        }
+        if (dynamic_cast<const ThrowStatement*>(stmt)) found = true;
+        return !found;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (found || dynamic_cast<const FunctionExpression*>(expr)) return false;
+        if (auto call = dynamic_cast<const CallExpression*>(expr)) found = analysis.callThrows(call);
+        return !found;
+    }
+private:
+    const ThrowAnalysis& analysis;
+};
+class ValueReturnFinder : public ASTVisitor {
+public:
+    bool found = false;
+    bool visitStatement(const Statement* stmt) override {
+        auto ret = dynamic_cast<const ReturnStatement*>(stmt);
+        if (ret && ret->value) found = true;
+        return !found;
+    }
+    bool visitExpression(const Expression* expr) override {
+        return !dynamic_cast<const FunctionExpression*>(expr);
+    }
+};
+}
+
+void ThrowAnalysis::analyze(const Program& program) {
+    functions.clear();
+    methods.clear();
+    // Until no more callers turn out to throw.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& stmt : program.statements) {
+            if (auto func = dynamic_cast<const FunctionDeclaration*>(stmt.get())) {
+                // main reports its own errors: it cannot return a Result.
+                if (func->name == "main" || functions.count(func->name) || !bodyThrows(func->body)) continue;
+                functions.insert(func->name);
+                changed = true;
+            } else if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt.get())) {
+                for (const auto& method : classDecl->methods) {
+                    if (methods.count(method.name) || !bodyThrows(method.body)) continue;
+                    methods.insert(method.name);
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool ThrowAnalysis::functionThrows(const std::string& name) const {
+    return functions.count(name) > 0;
+}
+
+bool ThrowAnalysis::methodThrows(const std::string& name) const {
+    return methods.count(name) > 0;
+}
+
+bool ThrowAnalysis::callThrows(const CallExpression* call) const {
+    if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) return functionThrows(id->name);
+    if (auto member = dynamic_cast<const MemberExpression*>(call->callee.get())) return methodThrows(member->property);
+    return false;
+}
+
+bool ThrowAnalysis::bodyThrows(const std::vector<std::unique_ptr<Statement>>& body) const {
+    EscapingThrowFinder finder(*this);
+    walk(body, finder);
+    return finder.found;
+}
+
+bool returnsValue(const std::vector<std::unique_ptr<Statement>>& body) {
+    ValueReturnFinder finder;
+    walk(body, finder);
+    return finder.found;
+}
+}
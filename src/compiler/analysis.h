@@ -0,0 +1,107 @@
+#pragma once
+#include "ast.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+namespace umbrella {
+// Runtime methods that never modify their receiver (e.g. join, slice, get).
+bool isReadOnlyMethod(const std::string& name);
+// Array helpers (map, forEach, sort, ...) that call their callback before returning.
+bool isSynchronousHelper(const std::string& name);
+// Variables whose length or identity the statements may change: assignment
+// targets and receivers of methods that are not read-only, reduced to their
+// root through member accesses (`this` for `this.items.push(x)`).
+std::set<std::string> collectResizedNames(const std::vector<std::unique_ptr<Statement>>& body);
+std::set<std::string> collectResizedNames(const Statement* stmt);
+
+// Capture and lifetime analysis, run per function before code generation.
+//
+// A lambda that cannot outlive the function that creates it (an argument to
+// an Array helper such as map/filter/forEach, or a local that is only ever
+// called) captures by reference. A lambda that escapes (returned, stored,
+// handed to Thread.spawn or Timer.setTimeout, ...) captures by value; locals
+// it captures that are not used afterwards are moved into it, and locals that
+// are mutated on either side are shared through a heap box so that writes are
+// seen by both the function and the closure.
+//
+// The same scan decides which parameters can be passed by const reference,
+// which locals can bind a reference to a container element, and which uses
+// of a local are its last and can be moved from.
+class CaptureAnalysis {
+public:
+    void analyze(const Program& program);
+
+    // False for lambdas the analysis has not seen (e.g. at file scope).
+    bool isAnalyzed(const FunctionExpression* lambda) const;
+    bool escapes(const FunctionExpression* lambda) const;
+    // Locals to move into the lambda's init-capture list, in source order.
+    const std::vector<std::string>& movedCaptures(const FunctionExpression* lambda) const;
+    // Whether the declared local lives in a shared heap box.
+    bool isBoxed(const VariableDeclaration* decl) const;
+    // Non-primitive parameter never modified in its function (for objects:
+    // never reassigned).
+    bool isReadOnlyParameter(const FunctionParameter* param) const;
+    // `let x = container[i]` that can be `const T& x = container[i]`.
+    bool isElementReference(const VariableDeclaration* decl) const;
+    // Use of a local after which it is dead, to be wrapped in std::move.
+    bool isLastUse(const Identifier* id) const;
+    bool isGlobal(const std::string& name) const;
+    // Whether the statements may run user code (functions, methods,
+    // constructors, callbacks held in variables) that could resize a global
+    // or an array held by an object.
+    bool callsUserCode(const std::vector<std::unique_ptr<Statement>>& body) const;
+private:
+    struct LambdaInfo {
+        bool escapes = true;
+        std::vector<std::string> moved;
+    };
+    std::map<const FunctionExpression*, LambdaInfo> lambdas;
+    std::set<const VariableDeclaration*> boxed;
+    std::set<std::string> globals;
+    std::set<std::string> userMethods;
+    // Classes whose instances are held by Ref (all but @soa classes).
+    std::set<std::string> objectClasses;
+    std::set<const FunctionParameter*> readOnlyParams;
+    std::set<const VariableDeclaration*> elementReferences;
+    std::set<const Identifier*> lastUses;
+
+    void analyzeFunction(const std::vector<FunctionParameter>& params,
+                         const std::vector<std::unique_ptr<Statement>>& body);
+};
+
+// Whole-program class hierarchy: which classes are extended and where each
+// method is (re)defined. Only top-level classes take part.
+class ClassHierarchy {
+public:
+    void analyze(const Program& program);
+    const ClassDeclaration* find(const std::string& name) const;
+    bool isExtended(const std::string& name) const;
+    // Nearest class at or above `name` that defines the method, or nullptr.
+    const ClassDeclaration* definingClass(const std::string& name, const std::string& method) const;
+    // Every class below `name`, directly or indirectly.
+    std::vector<const ClassDeclaration*> descendants(const std::string& name) const;
+private:
+    std::map<std::string, const ClassDeclaration*> classes;
+    std::map<std::string, std::vector<const ClassDeclaration*>> children;
+};
+const MethodDeclaration* findMethod(const ClassDeclaration* decl, const std::string& name);
+
+// Which functions and methods can end with an error they do not catch: a
+// `throw`, or a call to one of them, outside any `try`. Lambdas are left
+// out; methods are tracked by name, so every method of that name counts.
+// Under --no-exceptions these return a Result.
+class ThrowAnalysis {
+public:
+    void analyze(const Program& program);
+    bool functionThrows(const std::string& name) const;
+    bool methodThrows(const std::string& name) const;
+    bool callThrows(const CallExpression* call) const;
+private:
+    std::set<std::string> functions;
+    std::set<std::string> methods;
+    bool bodyThrows(const std::vector<std::unique_ptr<Statement>>& body) const;
+};
+// Whether the body has a `return <value>` of its own (not in a lambda).
+bool returnsValue(const std::vector<std::unique_ptr<Statement>>& body);
+}
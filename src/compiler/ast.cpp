@@ -1,5 +1,6 @@
 #include "ast.h"
 #include <sstream>
+#include <charconv>
 namespace umbrella {
 std::string typeToString(Type type) {
     switch (type) {
@@ -14,8 +15,31 @@ std::string typeToString(Type type) {
         default: return "unknown";
     }
 }
+static std::string bodyToString(const std::vector<std::unique_ptr<Statement>>& body) {
+    std::stringstream ss;
+    ss << "{\n";
+    for (const auto& stmt : body) {
+        std::istringstream lines(stmt->toString());
+        std::string line;
+        while (std::getline(lines, line)) {
+            ss << "  " << line << "\n";
+        }
+    }
+    ss << "}";
+    return ss.str();
+}
+static std::string paramsToString(const std::vector<FunctionParameter>& params) {
+    std::stringstream ss;
+    for (size_t i = 0; i < params.size(); i++) {
+        if (i > 0) ss << ", ";
+        ss << params[i].name << ": " << typeToString(params[i].type);
+    }
+    return ss.str();
+}
 std::string NumberLiteral::toString() const {
-    return std::to_string(value);
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
 }
 std::string StringLiteral::toString() const {
     return "\"" + value + "\"";
@@ -50,7 +74,6 @@ std::string ArrayExpression::toString() const {
         ss << elements[i]->toString();
     }
     ss << "]";
-    ss << "]";
     return ss.str();
 }
 std::string MapLiteral::toString() const {
@@ -103,17 +126,25 @@ std::string VariableDeclaration::toString() const {
 }
 
 std::string FunctionExpression::toString() const {
-    return "function (...) { ... }";
+    return "function (" + paramsToString(parameters) + "): " + typeToString(returnType) +
+           " " + bodyToString(body);
 }
 
 std::string FunctionDeclaration::toString() const {
     std::stringstream ss;
-    ss << "function " << name << "(";
-    for (size_t i = 0; i < parameters.size(); i++) {
-        if (i > 0) ss << ", ";
-        ss << parameters[i].name << ": " << typeToString(parameters[i].type);
+    if (isPure) ss << "/* pure */ ";
+    if (memo) {
+        ss << "@memo";
+        if (memoCapacity || memoSync) {
+            ss << "(";
+            if (memoCapacity) ss << memoCapacity << (memoSync ? ", " : "");
+            if (memoSync) ss << "sync";
+            ss << ")";
+        }
+        ss << " ";
     }
-    ss << "): " << typeToString(returnType) << " { ... }";
+    ss << "function " << name << "(" << paramsToString(parameters) << "): "
+       << typeToString(returnType) << " " << bodyToString(body);
     return ss.str();
 }
 std::string ReturnStatement::toString() const {
@@ -124,27 +155,39 @@ std::string ReturnStatement::toString() const {
 }
 std::string IfStatement::toString() const {
     std::stringstream ss;
-    ss << "if (" << condition->toString() << ") { ... }";
+    ss << "if (" << condition->toString() << ") " << bodyToString(thenBranch);
     if (!elseBranch.empty()) {
-        ss << " else { ... }";
+        ss << " else " << bodyToString(elseBranch);
     }
     return ss.str();
 }
 std::string WhileStatement::toString() const {
-    return "while (" + condition->toString() + ") { ... }";
+    return "while (" + condition->toString() + ") " + bodyToString(body);
 }
 std::string ForStatement::toString() const {
-    return "for (...) { ... }";
+    std::stringstream ss;
+    ss << (parallel ? "parallel for (" : "for (") << (initializer ? initializer->toString() : ";") << " "
+       << (condition ? condition->toString() : "") << "; "
+       << (increment ? increment->toString() : "") << ") " << bodyToString(body);
+    return ss.str();
 }
-std::string BlockStatement::toString() const {
+std::string ForOfStatement::toString() const {
     std::stringstream ss;
-    ss << "{\n";
-    for (const auto& stmt : statements) {
-        ss << "  " << stmt->toString() << "\n";
+    ss << "for (" << (isConst ? "const " : "let ");
+    if (valueName.empty()) {
+        ss << name;
+    } else {
+        ss << "[" << name << ", " << valueName << "]";
     }
-    ss << "}";
+    ss << " of " << iterable->toString() << ") " << bodyToString(body);
     return ss.str();
 }
+std::string ContinueStatement::toString() const {
+    return "continue;";
+}
+std::string BlockStatement::toString() const {
+    return bodyToString(statements);
+}
 std::string Program::toString() const {
     std::stringstream ss;
     for (const auto& stmt : statements) {
@@ -154,25 +197,131 @@ std::string Program::toString() const {
 }
 std::string ClassDeclaration::toString() const {
     std::stringstream ss;
-    ss << "class " << name;
+    ss << (soa ? "@soa class " : "class ") << name;
     if (!superclass.empty()) {
         ss << " extends " << superclass;
     }
-    ss << " { ... }";
+    ss << " {\n";
+    for (const auto& member : members) {
+        ss << "  " << member.name << ": " << typeToString(member.type);
+        if (member.initializer) {
+            ss << " = " << member.initializer->toString();
+        }
+        ss << ";\n";
+    }
+    std::vector<std::string> parts;
+    if (constructor) {
+        parts.push_back("constructor(" + paramsToString(constructor->parameters) + ") " +
+                        bodyToString(constructor->body));
+    }
+    for (const auto& method : methods) {
+        parts.push_back(method.name + "(" + paramsToString(method.parameters) + "): " +
+                        typeToString(method.returnType) + " " + bodyToString(method.body));
+    }
+    for (const auto& part : parts) {
+        std::istringstream lines(part);
+        std::string line;
+        while (std::getline(lines, line)) {
+            ss << "  " << line << "\n";
+        }
+    }
+    ss << "}";
     return ss.str();
 }
 std::string TryStatement::toString() const {
     std::stringstream ss;
-    ss << "try { ... }";
-    if (!catchBlock.empty()) {
-        ss << " catch (" << catchVar << ") { ... }";
+    ss << "try " << bodyToString(tryBlock);
+    if (!catchBlock.empty() || !catchVar.empty()) {
+        ss << " catch (" << catchVar << ") " << bodyToString(catchBlock);
     }
     if (!finallyBlock.empty()) {
-        ss << " finally { ... }";
+        ss << " finally " << bodyToString(finallyBlock);
     }
     return ss.str();
 }
 std::string ThrowStatement::toString() const {
     return "throw " + expression->toString() + ";";
 }
-}  
+void walk(const std::vector<std::unique_ptr<Statement>>& body, ASTVisitor& visitor) {
+    for (const auto& stmt : body) {
+        if (stmt) walk(stmt.get(), visitor);
+    }
+}
+void walk(const Statement* stmt, ASTVisitor& visitor) {
+    if (!visitor.visitStatement(stmt)) return;
+    if (auto varDecl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+        if (varDecl->initializer) walk(varDecl->initializer.get(), visitor);
+    } else if (auto funcDecl = dynamic_cast<const FunctionDeclaration*>(stmt)) {
+        walk(funcDecl->body, visitor);
+    } else if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt)) {
+        for (const auto& member : classDecl->members) {
+            if (member.initializer) walk(member.initializer.get(), visitor);
+        }
+        if (classDecl->constructor) walk(classDecl->constructor->body, visitor);
+        for (const auto& method : classDecl->methods) {
+            walk(method.body, visitor);
+        }
+    } else if (auto retStmt = dynamic_cast<const ReturnStatement*>(stmt)) {
+        if (retStmt->value) walk(retStmt->value.get(), visitor);
+    } else if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt)) {
+        walk(ifStmt->condition.get(), visitor);
+        walk(ifStmt->thenBranch, visitor);
+        walk(ifStmt->elseBranch, visitor);
+    } else if (auto whileStmt = dynamic_cast<const WhileStatement*>(stmt)) {
+        walk(whileStmt->condition.get(), visitor);
+        walk(whileStmt->body, visitor);
+    } else if (auto forStmt = dynamic_cast<const ForStatement*>(stmt)) {
+        if (forStmt->initializer) walk(forStmt->initializer.get(), visitor);
+        if (forStmt->condition) walk(forStmt->condition.get(), visitor);
+        if (forStmt->increment) walk(forStmt->increment.get(), visitor);
+        walk(forStmt->body, visitor);
+    } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+        walk(forOf->iterable.get(), visitor);
+        walk(forOf->body, visitor);
+    } else if (auto blockStmt = dynamic_cast<const BlockStatement*>(stmt)) {
+        walk(blockStmt->statements, visitor);
+    } else if (auto tryStmt = dynamic_cast<const TryStatement*>(stmt)) {
+        walk(tryStmt->tryBlock, visitor);
+        walk(tryStmt->catchBlock, visitor);
+        walk(tryStmt->finallyBlock, visitor);
+    } else if (auto throwStmt = dynamic_cast<const ThrowStatement*>(stmt)) {
+        walk(throwStmt->expression.get(), visitor);
+    } else if (auto exprStmt = dynamic_cast<const ExpressionStatement*>(stmt)) {
+        walk(exprStmt->expression.get(), visitor);
+    }
+    visitor.leaveStatement(stmt);
+}
+void walk(const Expression* expr, ASTVisitor& visitor) {
+    if (!visitor.visitExpression(expr)) return;
+    if (auto binExpr = dynamic_cast<const BinaryExpression*>(expr)) {
+        walk(binExpr->left.get(), visitor);
+        walk(binExpr->right.get(), visitor);
+    } else if (auto unExpr = dynamic_cast<const UnaryExpression*>(expr)) {
+        walk(unExpr->operand.get(), visitor);
+    } else if (auto assignExpr = dynamic_cast<const AssignmentExpression*>(expr)) {
+        walk(assignExpr->left.get(), visitor);
+        walk(assignExpr->right.get(), visitor);
+    } else if (auto callExpr = dynamic_cast<const CallExpression*>(expr)) {
+        walk(callExpr->callee.get(), visitor);
+        for (const auto& arg : callExpr->arguments) walk(arg.get(), visitor);
+    } else if (auto arrExpr = dynamic_cast<const ArrayExpression*>(expr)) {
+        for (const auto& element : arrExpr->elements) walk(element.get(), visitor);
+    } else if (auto mapLit = dynamic_cast<const MapLiteral*>(expr)) {
+        for (const auto& value : mapLit->values) walk(value.get(), visitor);
+    } else if (auto accessExpr = dynamic_cast<const ArrayAccess*>(expr)) {
+        walk(accessExpr->array.get(), visitor);
+        walk(accessExpr->index.get(), visitor);
+    } else if (auto memExpr = dynamic_cast<const MemberExpression*>(expr)) {
+        walk(memExpr->object.get(), visitor);
+    } else if (auto newExpr = dynamic_cast<const NewExpression*>(expr)) {
+        for (const auto& arg : newExpr->arguments) walk(arg.get(), visitor);
+    } else if (auto condExpr = dynamic_cast<const ConditionalExpression*>(expr)) {
+        walk(condExpr->condition.get(), visitor);
+        walk(condExpr->thenExpr.get(), visitor);
+        walk(condExpr->elseExpr.get(), visitor);
+    } else if (auto funcExpr = dynamic_cast<const FunctionExpression*>(expr)) {
+        walk(funcExpr->body, visitor);
+    }
+    visitor.leaveExpression(expr);
+}
+}
@@ -8,6 +8,10 @@ class ASTNode {
 public:
     virtual ~ASTNode() = default;
     virtual std::string toString() const = 0;
+    // Position of the node's first token in the .umb source (1-based).
+    // 0 for nodes synthesized by the optimizer.
+    int line = 0;
+    int column = 0;
 };
 enum class Type {
     NUMBER,
@@ -92,8 +96,9 @@ class ArrayAccess : public Expression {
 public:
     std::unique_ptr<Expression> array;
     std::unique_ptr<Expression> index;
+    bool unchecked; // index proven in range by the optimizer
     ArrayAccess(std::unique_ptr<Expression> arr, std::unique_ptr<Expression> idx)
-        : array(std::move(arr)), index(std::move(idx)) {}
+        : array(std::move(arr)), index(std::move(idx)), unchecked(false) {}
     std::string toString() const override;
 };
 class MemberExpression : public Expression {
@@ -147,15 +152,18 @@ public:
     std::string cppType; // Preserved C++ type string
     std::unique_ptr<Expression> initializer;
     bool isConst;
+    bool isReference; // const alias of its initializer (hoisted member chains)
     VariableDeclaration(const std::string& n, Type t, 
                        std::unique_ptr<Expression> init, bool constant = false, std::string explicitType = "")
-        : name(n), varType(t), cppType(explicitType), initializer(std::move(init)), isConst(constant) {}
+        : name(n), varType(t), cppType(explicitType), initializer(std::move(init)), isConst(constant),
+          isReference(false) {}
     std::string toString() const override;
 };
 class FunctionParameter {
 public:
     std::string name;
     Type type;
+    std::string cppType; // Declared type as written (see VariableDeclaration)
     FunctionParameter(const std::string& n, Type t) : name(n), type(t) {}
 };
 
@@ -173,10 +181,18 @@ public:
     std::string name;
     std::vector<FunctionParameter> parameters;
     Type returnType;
+    std::string returnCppType; // Declared type as written (see VariableDeclaration)
     std::vector<std::unique_ptr<Statement>> body;
+    bool isPure; // set by the optimizer when calls can be evaluated at compile time
+    // @memo: results are cached by argument values, keeping at most
+    // memoCapacity entries (least recently used evicted first; 0 = no limit).
+    // memoSync makes the cache safe to share between threads.
+    bool memo = false;
+    size_t memoCapacity = 0;
+    bool memoSync = false;
 
     FunctionDeclaration(const std::string& n, Type retType = Type::ANY)
-        : name(n), returnType(retType) {}
+        : name(n), returnType(retType), isPure(false) {}
     
     std::string toString() const override;
 };
@@ -205,6 +221,12 @@ public:
         : condition(std::move(cond)) {}
     std::string toString() const override;
 };
+// Next iteration of the innermost loop. Has no source syntax: the optimizer
+// emits it for self tail calls turned into loops.
+class ContinueStatement : public Statement {
+public:
+    std::string toString() const override;
+};
 class TryStatement : public Statement {
 public:
     std::vector<std::unique_ptr<Statement>> tryBlock;
@@ -226,6 +248,20 @@ public:
     std::unique_ptr<Expression> condition;
     std::unique_ptr<Expression> increment;
     std::vector<std::unique_ptr<Statement>> body;
+    // `parallel for`: iterations are independent and run on the thread pool.
+    bool parallel = false;
+    std::string toString() const override;
+};
+// for (const x of xs) / for (const [key, value] of map)
+class ForOfStatement : public Statement {
+public:
+    std::string name;
+    std::string valueName; // set for a [key, value] binding
+    bool isConst;
+    std::unique_ptr<Expression> iterable;
+    std::vector<std::unique_ptr<Statement>> body;
+    ForOfStatement(const std::string& n, const std::string& value, bool c, std::unique_ptr<Expression> iter)
+        : name(n), valueName(value), isConst(c), iterable(std::move(iter)) {}
     std::string toString() const override;
 };
 class BlockStatement : public Statement {
@@ -237,6 +273,7 @@ class ClassMember {
 public:
     std::string name;
     Type type;
+    std::string cppType; // Declared type as written (see VariableDeclaration)
     std::unique_ptr<Expression> initializer;
     ClassMember(const std::string& n, Type t, std::unique_ptr<Expression> init = nullptr)
         : name(n), type(t), initializer(std::move(init)) {}
@@ -246,7 +283,10 @@ public:
     std::string name;
     std::vector<FunctionParameter> parameters;
     Type returnType;
+    std::string returnCppType; // Declared type as written (see VariableDeclaration)
     std::vector<std::unique_ptr<Statement>> body;
+    int line = 0;
+    int column = 0;
     MethodDeclaration(const std::string& n, Type ret)
         : name(n), returnType(ret) {}
 };
@@ -254,6 +294,8 @@ class ConstructorDeclaration {
 public:
     std::vector<FunctionParameter> parameters;
     std::vector<std::unique_ptr<Statement>> body;
+    int line = 0;
+    int column = 0;
 };
 class ClassDeclaration : public Statement {
 public:
@@ -262,6 +304,8 @@ public:
     std::vector<ClassMember> members;
     std::vector<MethodDeclaration> methods;
     std::unique_ptr<ConstructorDeclaration> constructor;
+    // @soa: Array<ThisClass> stores each field in its own column.
+    bool soa = false;
     ClassDeclaration(const std::string& n) : name(n) {}
     std::string toString() const override;
 };
@@ -270,4 +314,18 @@ public:
     std::vector<std::unique_ptr<Statement>> statements;
     std::string toString() const override;
 };
+
+// Read-only pre-order traversal shared by the optimizer and analyses.
+// Returning false from visit* skips the children of that node.
+class ASTVisitor {
+public:
+    virtual ~ASTVisitor() = default;
+    virtual bool visitStatement(const Statement*) { return true; }
+    virtual bool visitExpression(const Expression*) { return true; }
+    virtual void leaveStatement(const Statement*) {}
+    virtual void leaveExpression(const Expression*) {}
+};
+void walk(const Statement* stmt, ASTVisitor& visitor);
+void walk(const Expression* expr, ASTVisitor& visitor);
+void walk(const std::vector<std::unique_ptr<Statement>>& body, ASTVisitor& visitor);
 }  
@@ -2,24 +2,53 @@
 #include <sstream>
 #include <iostream> // Added
 #include <stdexcept>
+#include <charconv>
+#include <cctype>
+#include <utility>
 namespace umbrella {
 CodeGenerator::CodeGenerator() : indentLevel(0) {}
+void CodeGenerator::setLineDirectives(const std::string& source, const std::string& generated) {
+    sourcePath = source;
+    generatedPath = generated;
+}
+const std::vector<CodeGenerator::SourceMapping>& CodeGenerator::sourceMap() const {
+    return mappings;
+}
+void CodeGenerator::setProfiling(bool enabled) {
+    profiling = enabled;
+}
+void CodeGenerator::setExceptions(bool enabled) {
+    exceptions = enabled;
+}
+// The site is constant-initialized, so entering the function costs no
+// static-init guard.
+void CodeGenerator::emitProfileProbe(const std::string& name) {
+    if (!profiling) return;
+    out << indent() << "static constexpr ProfileSite _profileSite{\"" << escapeString(name) << "\"};\n";
+    out << indent() << "ProfileScope _profileScope(_profileSite);\n";
+}
 std::string CodeGenerator::generate(const Program& program) {
-    std::stringstream ss;
-    ss << "#include <iostream>\n";
-    ss << "#include <string>\n";
-    ss << "#include <vector>\n";
-    ss << "#include <cmath>\n";
-    ss << "#include <algorithm>\n";
-    ss << "#include <cstdlib>\n";
-    ss << "#include <ctime>\n";
-    ss << "#include \"runtime/runtime.h\"\n";
-    ss << "#include \"runtime/advanced.h\"\n\n";
-    ss << "using namespace umbrella::runtime;\n\n";
-    ss << "using namespace umbrella::runtime;\n\n";
-
-    std::stringstream mainBody;
-    std::stringstream declarations;
+    captures.analyze(program);
+    hierarchy.analyze(program);
+    if (!exceptions) throws.analyze(program);
+    errorTargets.clear();
+    errorHandlers = 0;
+    checkedCalls = 0;
+    objectMembers.clear();
+    std::vector<std::string> objectClasses;
+    for (const auto& stmt : program.statements) {
+        auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt.get());
+        if (!classDecl || classDecl->soa) continue;
+        objectClasses.push_back(classDecl->name);
+        for (const auto& member : classDecl->members) objectMembers.insert(member.name);
+        for (const auto& method : classDecl->methods) objectMembers.insert(method.name);
+    }
+    usedModules.clear();
+    literalNames.clear();
+    literalPool.take();
+    // Declarations go straight to the output; loose statements are collected
+    // in a second writer (swapped in while they are generated) for main.
+    CodeWriter mainBody;
     bool hasUserMain = false;
 
     // Separate declarations from executable statements
@@ -31,7 +60,8 @@ std::string CodeGenerator::generate(const Program& program) {
             if (auto func = dynamic_cast<const FunctionDeclaration*>(stmt.get())) {
                 if (func->name == "main") hasUserMain = true;
             }
-            declarations << generateStatement(stmt.get());
+            generateStatement(stmt.get());
+            out << generatedMarker();
         } else {
              // Executable statements go to main
              // Variables at top level are tricky: global or local to main?
@@ -47,73 +77,218 @@ std::string CodeGenerator::generate(const Program& program) {
              // If user defined main(), they probably shouldn't have loose code. 
              // But let's append loosely to declarations if it is a variable? No.
              // Let's accumulate them for a generated main.
-             mainBody << generateStatement(stmt.get());
+             std::swap(out, mainBody);
+             generateStatement(stmt.get());
+             std::swap(out, mainBody);
         }
     }
 
-    ss << declarations.str();
-
     if (!hasUserMain) {
-        ss << "int main() {\n";
+        out << "int main() {\n";
+        indentLevel++;
+        emitProfileProbe("main");
+        indentLevel--;
         // Indent main body
-        std::string body = mainBody.str();
         // Naive indentation or assumes generateStatement does it? 
         // generateStatement uses 'indent()'. we should probably set indentLevel 1 before generating?
         // But we are generating into a separate stream.
         // Let's just output raw for now or fixing indentation would be nice but not critical for compilation.
-        ss << body; 
-        ss << "    return 0;\n";
-        ss << "}\n";
+        out << mainBody.take() << generatedMarker();
+        out << "    return 0;\n";
+        out << "}\n";
     } else {
         // mixed mode? If user has main, but also top-statements.
         // In C++, those statements would be illegal at file scope (except var decls).
         // We will just put them in global scope and let C++ compile or fail (as it did before).
         // Actually, previous implementation just looped and outputted everything.
         // Reverting to global output if main exists might be safer if they are truly global variables?
-        if (mainBody.tellp() > 0) {
+        if (!mainBody.empty()) {
              // If we have content that isn't decls, and we have a main...
              // It's likely global variables.
-             ss << mainBody.str();
+             out << mainBody.take() << generatedMarker();
         }
     }
-    
-    return ss.str();
-}
-std::string CodeGenerator::generateStatement(const Statement* stmt) {
-    if (auto varDecl = dynamic_cast<const VariableDeclaration*>(stmt)) {
-        return generateVariableDeclaration(varDecl);
-    }
-    if (auto funcDecl = dynamic_cast<const FunctionDeclaration*>(stmt)) {
-        return generateFunctionDeclaration(funcDecl);
-    }
-    if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt)) {
-        return generateClassDeclaration(classDecl);
-    }
-    if (auto retStmt = dynamic_cast<const ReturnStatement*>(stmt)) {
-        return generateReturnStatement(retStmt);
+
+    // The includes depend on what the program turned out to use.
+    CodeWriter prelude;
+    prelude << "#include <string>\n";
+    prelude << "#include <vector>\n";
+    prelude << "#include <cmath>\n";
+    prelude << "#include <algorithm>\n";
+    prelude << "#include <cstdlib>\n";
+    prelude << "#include <ctime>\n";
+    for (const RuntimeModule* module : runtimeModules()) {
+        prelude << "#include \"" << module->header << "\"\n";
+    }
+    prelude << "\n";
+    prelude << "using namespace umbrella::runtime;\n\n";
+    prelude << "using namespace umbrella::runtime;\n\n";
+    if (!objectClasses.empty()) {
+        // Fields may hold a Ref to a class declared further down.
+        for (const auto& name : objectClasses) {
+            prelude << "struct " << name << ";\n";
+        }
+        prelude << "\n";
     }
-    if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt)) {
-        return generateIfStatement(ifStmt);
+    if (!literalPool.empty()) {
+        prelude << literalPool.take() << "\n";
     }
-    if (auto whileStmt = dynamic_cast<const WhileStatement*>(stmt)) {
-        return generateWhileStatement(whileStmt);
+    prelude << out.take();
+    return resolveLineMarkers(prelude.take());
+}
+std::vector<const RuntimeModule*> CodeGenerator::runtimeModules() const {
+    std::vector<const RuntimeModule*> modules;
+    for (const auto& module : RUNTIME_MODULES) {
+        if (module.name == std::string_view("core") || usedModules.count(module.name)) {
+            modules.push_back(&module);
+        }
     }
-    if (auto forStmt = dynamic_cast<const ForStatement*>(stmt)) {
-        return generateForStatement(forStmt);
+    return modules;
+}
+void CodeGenerator::useModule(const std::string& name) {
+    usedModules.insert(name);
+}
+// Records the modules behind the runtime class names in a piece of generated
+// code (a type such as Array<Thread>, a static class, a constructor call).
+void CodeGenerator::useModulesOf(std::string_view code) {
+    size_t i = 0;
+    while (i < code.size()) {
+        if (!std::isalpha(static_cast<unsigned char>(code[i])) && code[i] != '_') {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < code.size() && (std::isalnum(static_cast<unsigned char>(code[i])) || code[i] == '_')) i++;
+        if (const RuntimeModule* module = moduleForClass(code.substr(start, i - start))) {
+            usedModules.insert(module->name);
+        }
     }
-    if (auto blockStmt = dynamic_cast<const BlockStatement*>(stmt)) {
-        return generateBlockStatement(blockStmt);
+}
+// Instances of user classes (except @soa ones) are held by Ref<T>; see
+// runtime/objects.h.
+bool CodeGenerator::isObjectClass(const std::string& name) const {
+    const ClassDeclaration* decl = hierarchy.find(name);
+    return decl && !decl->soa;
+}
+// A declared type with each object class wrapped: Array<Node> becomes
+// Array<Ref<Node>>.
+std::string CodeGenerator::objectTypes(std::string_view type) const {
+    std::string result;
+    size_t i = 0;
+    while (i < type.size()) {
+        if (!std::isalpha(static_cast<unsigned char>(type[i])) && type[i] != '_') {
+            result += type[i++];
+            continue;
+        }
+        size_t start = i;
+        while (i < type.size() && (std::isalnum(static_cast<unsigned char>(type[i])) || type[i] == '_')) i++;
+        std::string name(type.substr(start, i - start));
+        result += isObjectClass(name) ? "Ref<" + name + ">" : name;
     }
-    if (auto tryStmt = dynamic_cast<const TryStatement*>(stmt)) {
-        return generateTryStatement(tryStmt);
+    return result;
+}
+// With line directives on, generated statements are preceded by a marker line
+// ("\x01<line> <column>") carrying their .umb position, and code the compiler
+// adds on its own by "\x02". Markers stay out of the way while pieces are
+// assembled; this pass replaces them with #line directives once the final
+// line numbers are known, and records the C++ line -> .umb line map.
+std::string CodeGenerator::positionMarker(int line, int column) {
+    if (sourcePath.empty() || line <= 0) return "";
+    return "\x01" + std::to_string(line) + " " + std::to_string(column) + "\n";
+}
+std::string CodeGenerator::generatedMarker() {
+    return sourcePath.empty() ? "" : "\x02\n";
+}
+std::string CodeGenerator::resolveLineMarkers(const std::string& code) {
+    mappings.clear();
+    if (sourcePath.empty()) return code;
+    CodeWriter resolved;
+    std::istringstream in(code);
+    std::string line;
+    int cppLine = 0;
+    int umbLine = 0; // .umb line the next output line is attributed to; 0 outside user code
+    int umbColumn = 0;
+    // A return to the generated file is only written once some glue code
+    // actually follows, so that back-to-back declarations don't ping-pong.
+    bool leavingSource = false;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[0] == '\x01') {
+            int target = std::stoi(line.substr(1));
+            umbColumn = std::stoi(line.substr(line.find(' ') + 1));
+            // Consecutive statements on consecutive lines need no directive.
+            leavingSource = false;
+            if (target != umbLine) {
+                resolved << "#line " << target << " \"" << escapeString(sourcePath) << "\"\n";
+                cppLine++;
+                umbLine = target;
+            }
+            continue;
+        }
+        if (!line.empty() && line[0] == '\x02') {
+            if (umbLine != 0) leavingSource = true;
+            umbLine = 0;
+            continue;
+        }
+        if (leavingSource) {
+            cppLine++;
+            resolved << "#line " << cppLine + 1 << " \"" << escapeString(generatedPath) << "\"\n";
+            leavingSource = false;
+        }
+        resolved << line << "\n";
+        cppLine++;
+        if (umbLine != 0) {
+            mappings.push_back({cppLine, umbLine, umbColumn});
+            umbLine++;
+            umbColumn = 0;
+        }
     }
-    if (auto throwStmt = dynamic_cast<const ThrowStatement*>(stmt)) {
-        return generateThrowStatement(throwStmt);
+    if (umbLine != 0 || leavingSource) {
+        resolved << "#line " << cppLine + 2 << " \"" << escapeString(generatedPath) << "\"\n";
     }
-    if (auto exprStmt = dynamic_cast<const ExpressionStatement*>(stmt)) {
-        return generateExpressionStatement(exprStmt);
+    return resolved.take();
+}
+void CodeGenerator::generateStatement(const Statement* stmt) {
+    out << positionMarker(stmt->line, stmt->column);
+    generateStatementCode(stmt);
+}
+void CodeGenerator::generateStatementCode(const Statement* stmt) {
+    if (auto varDecl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+        generateVariableDeclaration(varDecl);
+    } else if (auto funcDecl = dynamic_cast<const FunctionDeclaration*>(stmt)) {
+        generateFunctionDeclaration(funcDecl);
+    } else if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt)) {
+        generateClassDeclaration(classDecl);
+    } else if (auto retStmt = dynamic_cast<const ReturnStatement*>(stmt)) {
+        generateReturnStatement(retStmt);
+    } else if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt)) {
+        generateIfStatement(ifStmt);
+    } else if (auto whileStmt = dynamic_cast<const WhileStatement*>(stmt)) {
+        generateWhileStatement(whileStmt);
+    } else if (auto forStmt = dynamic_cast<const ForStatement*>(stmt)) {
+        generateForStatement(forStmt);
+    } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+        generateForOfStatement(forOf);
+    } else if (auto blockStmt = dynamic_cast<const BlockStatement*>(stmt)) {
+        generateBlockStatement(blockStmt);
+    } else if (dynamic_cast<const ContinueStatement*>(stmt)) {
+        out << indent() << "continue;\n";
+    } else if (auto tryStmt = dynamic_cast<const TryStatement*>(stmt)) {
+        generateTryStatement(tryStmt);
+    } else if (auto throwStmt = dynamic_cast<const ThrowStatement*>(stmt)) {
+        generateThrowStatement(throwStmt);
+    } else if (auto exprStmt = dynamic_cast<const ExpressionStatement*>(stmt)) {
+        generateExpressionStatement(exprStmt);
     }
-    return "";
+}
+// Runs emit against an empty buffer and returns what it wrote, for the few
+// pieces that are needed as a string (lambda bodies, methods shared with a
+// @soa element proxy, a for-loop initializer).
+std::string CodeGenerator::captureOutput(const std::function<void()>& emit) {
+    CodeWriter saved;
+    std::swap(out, saved);
+    emit();
+    std::swap(out, saved);
+    return saved.take();
 }
 std::string CodeGenerator::generateExpression(const Expression* expr) {
     if (auto numLit = dynamic_cast<const NumberLiteral*>(expr)) {
@@ -138,6 +313,7 @@ std::string CodeGenerator::generateExpression(const Expression* expr) {
         return generateUnaryExpression(unExpr);
     }
     if (auto callExpr = dynamic_cast<const CallExpression*>(expr)) {
+        if (!exceptions && throws.callThrows(callExpr)) return checkedCall(generateCallExpression(callExpr));
         return generateCallExpression(callExpr);
     }
     if (auto arrExpr = dynamic_cast<const ArrayExpression*>(expr)) {
@@ -170,67 +346,99 @@ std::string CodeGenerator::generateConditionalExpression(const ConditionalExpres
            generateExpression(expr->elseExpr.get()) + ")";
 }
 
-std::string CodeGenerator::generateThrowStatement(const ThrowStatement* stmt) {
-    return indent() + "throw " + generateExpression(stmt->expression.get()) + ";\n";
+void CodeGenerator::generateThrowStatement(const ThrowStatement* stmt) {
+    if (!exceptions) {
+        out << indent() << raiseError("thrownMessage(" + generateExpression(stmt->expression.get()) + ")") << "\n";
+        return;
+    }
+    out << indent() << "throw " << generateExpression(stmt->expression.get()) << ";\n";
 }
 
-std::string CodeGenerator::generateTryStatement(const TryStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "{\n"; // Enclose in block for scope
+void CodeGenerator::generateTryStatement(const TryStatement* stmt) {
+    out << indent() << "{\n"; // Enclose in block for scope
     indentLevel++;
     
     // Handle finally using RAII
     if (!stmt->finallyBlock.empty()) {
-        ss << indent() << "struct Finally {\n";
-        ss << indent() << "    std::function<void()> f;\n";
-        ss << indent() << "    Finally(std::function<void()> func) : f(func) {}\n";
-        ss << indent() << "    ~Finally() { f(); }\n";
-        ss << indent() << "} _finally([&]() {\n";
+        out << indent() << "ScopeExit _finally([&]() {\n";
         indentLevel++;
+        errorTargets.push_back({ErrorTarget::Fatal});
         for (const auto& s : stmt->finallyBlock) {
-            ss << generateStatement(s.get());
+            generateStatement(s.get());
         }
+        errorTargets.pop_back();
         indentLevel--;
-        ss << indent() << "});\n";
+        out << indent() << "});\n";
     }
 
-    ss << indent() << "try {\n";
-    indentLevel++;
-    for (const auto& s : stmt->tryBlock) {
-        ss << generateStatement(s.get());
-    }
-    indentLevel--;
-    ss << indent() << "} catch (const std::string& " << stmt->catchVar << ") { // Catch string exceptions\n";
-    indentLevel++;
-    for (const auto& s : stmt->catchBlock) {
-        ss << generateStatement(s.get());
+    if (!exceptions) {
+        // Errors raised in the try block store their message and jump to the
+        // catch block; without any, the catch block is left out.
+        std::string id = std::to_string(errorHandlers++);
+        errorTargets.push_back({ErrorTarget::Handler, "_error" + id, "_catch" + id});
+        indentLevel++;
+        std::string body = captureOutput([&] {
+            for (const auto& s : stmt->tryBlock) {
+                generateStatement(s.get());
+            }
+        });
+        indentLevel--;
+        bool caught = errorTargets.back().used;
+        errorTargets.pop_back();
+        if (caught) out << indent() << "std::string _error" << id << ";\n";
+        out << indent() << "{\n" << body << indent() << "}\n";
+        if (caught) {
+            out << indent() << "goto _tryEnd" << id << ";\n";
+            out << indent() << "_catch" << id << ": {\n";
+            indentLevel++;
+            if (!stmt->catchVar.empty()) {
+                out << indent() << "std::string " << sanitize(stmt->catchVar) << " = std::move(_error" << id << ");\n";
+            }
+            for (const auto& s : stmt->catchBlock) {
+                generateStatement(s.get());
+            }
+            indentLevel--;
+            out << indent() << "}\n";
+            out << indent() << "_tryEnd" << id << ":;\n";
+        }
+        indentLevel--;
+        out << indent() << "}\n";
+        return;
     }
-    indentLevel--;
-    ss << indent() << "} catch (const char* " << stmt->catchVar << "_ctr) { // Catch const char* exceptions\n";
+
+    out << indent() << "try {\n";
     indentLevel++;
-    ss << indent() << "std::string " << stmt->catchVar << "(" << stmt->catchVar << "_ctr);\n";
-    for (const auto& s : stmt->catchBlock) {
-        ss << generateStatement(s.get());
+    for (const auto& s : stmt->tryBlock) {
+        generateStatement(s.get());
     }
     indentLevel--;
-    ss << indent() << "} catch (...) {\n";
+    // One handler for every thrown type; the runtime turns it into the message.
+    out << indent() << "} catch (...) {\n";
     if (!stmt->catchVar.empty()) {
         indentLevel++;
-        ss << indent() << "std::string " << stmt->catchVar << " = \"Unknown error\";\n";
+        out << indent() << "std::string " << sanitize(stmt->catchVar) << " = exceptionMessage(std::current_exception());\n";
         for (const auto& s : stmt->catchBlock) {
-            ss << generateStatement(s.get());
+            generateStatement(s.get());
         }
         indentLevel--;
     }
-    ss << indent() << "}\n";
+    out << indent() << "}\n";
     
     indentLevel--;
-    ss << indent() << "}\n";
-    return ss.str();
+    out << indent() << "}\n";
 }
 
 std::string CodeGenerator::generateAssignmentExpression(const AssignmentExpression* expr) {
-    std::stringstream ss;
+    CodeWriter ss;
+    // `s = s + a + b` on a string copies the whole of s every time; append in place instead.
+    std::vector<const Expression*> pieces;
+    if (collectAppendPieces(expr, pieces)) {
+        ss << generateExpression(expr->left.get());
+        for (const Expression* piece : pieces) {
+            ss << ".append(" << generateExpression(piece) << ")";
+        }
+        return ss.take();
+    }
     std::string left = generateExpression(expr->left.get());
     std::string right = generateExpression(expr->right.get());
     
@@ -242,26 +450,99 @@ std::string CodeGenerator::generateAssignmentExpression(const AssignmentExpressi
     } else {
         ss << left << " " << expr->op << " " << right;
     }
-    return ss.str();
+    return ss.take();
+}
+
+namespace {
+class NameFinder : public ASTVisitor {
+public:
+    const std::string& name;
+    bool found = false;
+    NameFinder(const std::string& n) : name(n) {}
+    bool visitExpression(const Expression* expr) override {
+        if (auto id = dynamic_cast<const Identifier*>(expr)) found |= id->name == name;
+        return !found;
+    }
+};
+}
+
+bool CodeGenerator::collectAppendPieces(const AssignmentExpression* expr, std::vector<const Expression*>& pieces) {
+    if (expr->op != "=") return false;
+    auto target = dynamic_cast<const Identifier*>(expr->left.get());
+    if (!target) return false;
+    auto typeIt = variableTypes.find(target->name);
+    if (typeIt == variableTypes.end() || typeIt->second != Type::STRING) return false;
+    // Walk the left spine of ((s + a) + b) + c, collecting c, b, a.
+    const Expression* node = expr->right.get();
+    std::vector<const Expression*> reversed;
+    while (auto bin = dynamic_cast<const BinaryExpression*>(node)) {
+        if (bin->op != "+") break;
+        reversed.push_back(bin->right.get());
+        node = bin->left.get();
+    }
+    auto base = dynamic_cast<const Identifier*>(node);
+    if (reversed.empty() || !base || base->name != target->name) return false;
+    // `s = s + s` would append the already extended s.
+    NameFinder finder(target->name);
+    for (const Expression* piece : reversed) walk(piece, finder);
+    if (finder.found) return false;
+    pieces.assign(reversed.rbegin(), reversed.rend());
+    return true;
+}
+
+// Strings, arrays, maps and objects that the function never modifies are
+// taken by const reference instead of being copied on every call.
+std::string CodeGenerator::generateParameter(const FunctionParameter& param) {
+    return parameterType(param) + " " + sanitize(param.name);
+}
+std::string CodeGenerator::parameterType(const FunctionParameter& param) {
+    std::string type = typeToCppType(param.type);
+    if (captures.isReadOnlyParameter(&param)) {
+        return "const " + type + "&";
+    }
+    return type;
+}
+
+void CodeGenerator::declareParameters(const std::vector<FunctionParameter>& params) {
+    for (const auto& param : params) {
+        declaredVariables.insert(param.name);
+        variableTypes[param.name] = param.type;
+        // A parameter passed by const reference aliases the caller's data.
+        if (captures.isReadOnlyParameter(&param)) {
+            plainLocals.erase(param.name);
+        } else {
+            plainLocals.insert(param.name);
+        }
+    }
 }
 
 std::string CodeGenerator::generateNewExpression(const NewExpression* expr) {
-    std::stringstream ss;
-    ss << expr->className << "(";
+    useModulesOf(expr->className);
+    CodeWriter ss;
+    if (isObjectClass(expr->className)) {
+        ss << "makeRef<" << expr->className << ">(";
+    } else {
+        ss << objectTypes(expr->className) << "(";
+    }
     for (size_t i = 0; i < expr->arguments.size(); i++) {
         if (i > 0) ss << ", ";
         ss << generateExpression(expr->arguments[i].get());
     }
     ss << ")";
-    return ss.str();
+    return ss.take();
 }
 
 std::string CodeGenerator::generateArrayAccess(const ArrayAccess* expr) {
+    if (expr->unchecked) {
+        return "uncheckedAt(" + generateExpression(expr->array.get()) + ", " +
+               generateExpression(expr->index.get()) + ")";
+    }
     return generateExpression(expr->array.get()) + "[" + generateExpression(expr->index.get()) + "]";
 }
 
 std::string CodeGenerator::generateMapLiteral(const MapLiteral* expr) {
-    std::stringstream ss;
+    useModule("collections");
+    CodeWriter ss;
     std::string valueType = typeToCppType(expr->valueType);
     if (expr->values.empty() && expr->valueType == Type::ANY) {
         valueType = "std::string"; // Default for empty map?
@@ -272,7 +553,7 @@ std::string CodeGenerator::generateMapLiteral(const MapLiteral* expr) {
         ss << "{\"" << expr->keys[i] << "\", " << generateExpression(expr->values[i].get()) << "}";
     }
     ss << "})";
-    return ss.str();
+    return ss.take();
 }
 std::string CodeGenerator::generateMemberExpression(const MemberExpression* expr) {
     if (auto id = dynamic_cast<const Identifier*>(expr->object.get())) {
@@ -282,6 +563,7 @@ std::string CodeGenerator::generateMemberExpression(const MemberExpression* expr
         };
         for (const auto& className : staticClasses) {
             if (id->name == className) {
+                useModulesOf(className);
                 return className + "::" + expr->property;
             }
         }
@@ -294,24 +576,49 @@ std::string CodeGenerator::generateMemberExpression(const MemberExpression* expr
             return "this->" + expr->property;
         }
     }
-    return generateExpression(expr->object.get()) + "." + expr->property;
+    if (objectMembers.count(expr->property)) {
+        // Possibly a Ref (see deref).
+        return "deref(" + generateObjectExpression(expr->object.get()) + ")." + expr->property;
+    }
+    return generateObjectExpression(expr->object.get()) + "." + expr->property;
 }
-std::string CodeGenerator::generateVariableDeclaration(const VariableDeclaration* decl) {
-    std::stringstream ss;
-    ss << indent();
+void CodeGenerator::generateVariableDeclaration(const VariableDeclaration* decl) {
+    useModulesOf(decl->cppType);
+    std::string cppType = objectTypes(decl->cppType);
+    if (captures.isBoxed(decl)) {
+        generateBoxedDeclaration(decl);
+        return;
+    }
+    out << indent();
     if (decl->isConst) {
-        ss << "const ";
+        out << "const ";
     }
     std::string safeName = sanitize(decl->name);
+    if (decl->isReference) {
+        out << "auto& " << safeName << " = " << generateExpression(decl->initializer.get()) << ";\n";
+        declaredVariables.insert(decl->name);
+        variableTypes[decl->name] = decl->varType;
+        return;
+    }
     
+    if (captures.isElementReference(decl)) {
+        // Read-only view of an element: no copy of the row/array/map.
+        std::string type = cppType.empty() ? typeToCppType(decl->varType) : cppType;
+        out << (decl->isConst ? "" : "const ") << type << "& " << safeName << " = "
+            << generateExpression(decl->initializer.get()) << ";\n";
+        declaredVariables.insert(decl->name);
+        variableTypes[decl->name] = decl->varType;
+        return;
+    }
+
     // Use explicitly captured type if available (handles Generics like Array<Thread>)
-    if (!decl->cppType.empty()) {
-        ss << decl->cppType << " " << safeName;
+    if (!cppType.empty()) {
+        out << cppType << " " << safeName;
     } else {
         if (decl->varType != Type::ANY) {
-            ss << typeToCppType(decl->varType) << " " << safeName;
+            out << typeToCppType(decl->varType) << " " << safeName;
         } else {
-            ss << "auto " << safeName;
+            out << "auto " << safeName;
         }
     }
 
@@ -325,211 +632,525 @@ std::string CodeGenerator::generateVariableDeclaration(const VariableDeclaration
         }
         
         bool isEmptyGenericCtor = false;
-        if (!decl->cppType.empty()) {
+        if (!cppType.empty()) {
             if (auto newExpr = dynamic_cast<const NewExpression*>(decl->initializer.get())) {
-                if (newExpr->arguments.empty() && decl->cppType.find(newExpr->className) == 0) {
+                if (newExpr->arguments.empty() && cppType.find(newExpr->className) == 0 &&
+                    !isObjectClass(newExpr->className)) {
                      isEmptyGenericCtor = true;
                 }
             }
         }
 
-        if (isEmptyArray && !decl->cppType.empty()) {
+        if (isEmptyArray && !cppType.empty()) {
              // Array<Thread> threads = {};
-             ss << " = {}"; 
+             out << " = {}"; 
         } else if (isEmptyGenericCtor) {
              // Map<K,V> m; instead of = Map();
         } else {
-             ss << " = " << generateExpression(decl->initializer.get());
+             out << " = " << generateExpression(decl->initializer.get());
+        }
+    }
+    out << ";\n";
+    declaredVariables.insert(decl->name);
+    variableTypes[decl->name] = decl->varType;
+    plainLocals.insert(decl->name);
+}
+// A local shared with an escaping closure: both sides hold a shared_ptr to
+// one heap cell and every use is emitted as (*name).
+void CodeGenerator::generateBoxedDeclaration(const VariableDeclaration* decl) {
+    std::string cellType = objectTypes(decl->cppType);
+    if (cellType.empty() && decl->varType != Type::ANY) {
+        cellType = typeToCppType(decl->varType);
+    }
+    out << indent() << (decl->isConst ? "const " : "") << "auto " << sanitize(decl->name) << " = ";
+    auto newExpr = dynamic_cast<const NewExpression*>(decl->initializer.get());
+    auto arrExpr = dynamic_cast<const ArrayExpression*>(decl->initializer.get());
+    if (newExpr && !isObjectClass(newExpr->className) &&
+        (cellType.empty() || cellType == "auto" || cellType.find(newExpr->className) == 0)) {
+        // Construct in place: runtime objects such as Mutex are not copyable.
+        out << "std::make_shared<" << (cellType.empty() || cellType == "auto" ? newExpr->className : cellType) << ">(";
+        for (size_t i = 0; i < newExpr->arguments.size(); i++) {
+            if (i > 0) out << ", ";
+            out << generateExpression(newExpr->arguments[i].get());
         }
+        out << ")";
+    } else if (!decl->initializer || (arrExpr && arrExpr->elements.empty() && !decl->cppType.empty())) {
+        out << "std::make_shared<" << (cellType.empty() || cellType == "auto" ? "double" : cellType) << ">()";
+    } else if (!cellType.empty() && cellType != "auto") {
+        out << "std::make_shared<" << cellType << ">(" << generateExpression(decl->initializer.get()) << ")";
+    } else {
+        out << "box(" << generateExpression(decl->initializer.get()) << ")";
     }
-    ss << ";\n";
+    out << ";\n";
     declaredVariables.insert(decl->name);
     variableTypes[decl->name] = decl->varType;
-    return ss.str();
+    boxedVariables.insert(decl->name);
 }
-std::string CodeGenerator::generateFunctionDeclaration(const FunctionDeclaration* decl) {
-    std::stringstream ss;
+void CodeGenerator::generateFunctionDeclaration(const FunctionDeclaration* decl) {
     std::string returnType = typeToCppType(decl->returnType);
     std::string safeName = sanitize(decl->name);
     if (decl->name == "main") {
         returnType = "int";
         safeName = "main"; // Don't sanitize main
     }
-    ss << indent() << returnType << " " << safeName << "(";
+    bool result = !exceptions && throws.functionThrows(decl->name);
+    if (result) returnType = resultType(decl->name, decl->returnType, decl->returnCppType, decl->body);
+    std::string params, args;
     for (size_t i = 0; i < decl->parameters.size(); i++) {
-        if (i > 0) ss << ", ";
-        ss << typeToCppType(decl->parameters[i].type) << " " << sanitize(decl->parameters[i].name);
-    }
-    ss << ") {\n";
+        if (i > 0) {
+            params += ", ";
+            args += ", ";
+        }
+        params += generateParameter(decl->parameters[i]);
+        args += sanitize(decl->parameters[i].name);
+    }
+    std::string bodyName = safeName;
+    if (decl->memo) {
+        useModule("collections");
+        // The body moves to <name>_memoized; <name> consults the cache
+        // first, so recursive calls in the body are cached as well.
+        bodyName = safeName + "_memoized";
+        out << indent() << returnType << " " << safeName << "(" << params << ");\n";
+    }
+    out << indent() << returnType << " " << bodyName << "(" << params << ") {\n";
+    boxedVariables.clear();
+    plainLocals.clear();
+    declareParameters(decl->parameters);
     indentLevel++;
+    // A memoized function is profiled in its wrapper, so cache hits count as calls.
+    if (!decl->memo) emitProfileProbe(decl->name);
+    if (result) errorTargets.push_back({ErrorTarget::Return});
+    returnsVoidResult = returnType == "Result<void>";
     for (const auto& stmt : decl->body) {
-        ss << generateStatement(stmt.get());
+        generateStatement(stmt.get());
     }
+    if (returnsVoidResult) out << indent() << "return {};\n";
+    returnsVoidResult = false;
+    if (result) errorTargets.pop_back();
     indentLevel--;
-    ss << indent() << "}\n\n";
-    return ss.str();
+    out << indent() << "}\n\n";
+    if (decl->memo) {
+        out << generatedMarker();
+        std::string keyType = "std::tuple<";
+        for (size_t i = 0; i < decl->parameters.size(); i++) {
+            if (i > 0) keyType += ", ";
+            keyType += "std::decay_t<decltype(" + sanitize(decl->parameters[i].name) + ")>";
+        }
+        keyType += ">";
+        std::string valueType = returnType != "auto" ? returnType
+            : "std::decay_t<decltype(" + bodyName + "(" + args + "))>";
+        out << indent() << returnType << " " << safeName << "(" << params << ") {\n";
+        indentLevel++;
+        emitProfileProbe(decl->name);
+        out << indent() << "static " << (decl->memoSync ? "SharedMemoTable<" : "MemoTable<") << keyType << ", "
+            << valueType << "> memo(" << decl->memoCapacity << ");\n";
+        out << indent() << keyType << " key{" << args << "};\n";
+        out << indent() << "if (auto hit = memo.find(key)) return std::move(*hit);\n";
+        out << indent() << "auto result = " << bodyName << "(" << args << ");\n";
+        // A failed call is not cached: the next call tries again.
+        out << indent() << (result ? "if (!failed(result)) " : "") << "memo.insert(std::move(key), result);\n";
+        out << indent() << "return result;\n";
+        indentLevel--;
+        out << indent() << "}\n\n";
+    }
 }
 
 std::string CodeGenerator::generateFunctionExpression(const FunctionExpression* expr) {
-    std::stringstream ss;
-    ss << "[=](";
+    std::string code;
+    bool byReference = captures.isAnalyzed(expr) && !captures.escapes(expr);
+    if (byReference) {
+        // Runs before the enclosing function returns: no copies needed.
+        code += "[&](";
+    } else {
+        code += "[=";
+        for (const auto& name : captures.movedCaptures(expr)) {
+            code += ", " + sanitize(name) + " = std::move(" + sanitize(name) + ")";
+        }
+        code += "](";
+    }
     for (size_t i = 0; i < expr->parameters.size(); i++) {
-        if (i > 0) ss << ", ";
-        ss << typeToCppType(expr->parameters[i].type) << " " << sanitize(expr->parameters[i].name);
+        if (i > 0) code += ", ";
+        code += generateParameter(expr->parameters[i]);
     }
-    ss << ") mutable -> " << typeToCppType(expr->returnType) << " {\n"; // Added mutable
+    code += ")";
+    code += byReference ? "" : " mutable";
+    code += " -> " + typeToCppType(expr->returnType) + " {\n";
+    declareParameters(expr->parameters);
     indentLevel++;
-    for (const auto& stmt : expr->body) {
-        ss << generateStatement(stmt.get());
-    }
+    bool enclosingReturnsVoidResult = std::exchange(returnsVoidResult, false);
+    errorTargets.push_back({ErrorTarget::Fatal});
+    code += captureOutput([&] {
+        for (const auto& stmt : expr->body) {
+            generateStatement(stmt.get());
+        }
+    });
+    errorTargets.pop_back();
+    returnsVoidResult = enclosingReturnsVoidResult;
     indentLevel--;
-    ss << indent() << "}";
-    return ss.str();
+    code.append(indentLevel * 4, ' ');
+    code += "}";
+    return code;
 }
 
-std::string CodeGenerator::generateClassDeclaration(const ClassDeclaration* decl) {
-    std::stringstream ss;
-    ss << indent() << "struct " << decl->name;
+// Class hierarchy analysis decides the binding of each method. A method is
+// virtual only if a class below the one introducing it redefines it with the
+// same signature, and a subclass nothing extends is final, so classes without
+// overrides keep direct calls. Methods with `auto` in their signature are
+// templates, which cannot be virtual; they keep static binding.
+CodeGenerator::Dispatch CodeGenerator::methodDispatch(const ClassDeclaration* decl, const MethodDeclaration& method) {
+    std::string signature = methodSignature(method);
+    if (signature.find("auto") != std::string::npos) return Dispatch::Static;
+    const ClassDeclaration* top = decl;
+    std::set<std::string> seen = {decl->name};
+    while (auto above = hierarchy.definingClass(top->superclass, method.name)) {
+        if (!seen.insert(above->name).second) break;
+        top = above;
+    }
+    if (top == decl) {
+        return isOverriddenBelow(decl->name, method.name, signature) ? Dispatch::Virtual : Dispatch::Static;
+    }
+    if (methodSignature(*findMethod(top, method.name)) != signature) return Dispatch::Static;
+    return isOverriddenBelow(decl->name, method.name, signature) ? Dispatch::Override : Dispatch::FinalOverride;
+}
+std::string CodeGenerator::methodSignature(const MethodDeclaration& method) {
+    std::string signature = typeToCppType(method.returnType) + "(";
+    for (const auto& param : method.parameters) {
+        signature += parameterType(param) + ",";
+    }
+    return signature + ")";
+}
+bool CodeGenerator::isOverriddenBelow(const std::string& className, const std::string& method,
+                                      const std::string& signature) {
+    for (const ClassDeclaration* below : hierarchy.descendants(className)) {
+        const MethodDeclaration* redefined = findMethod(below, method);
+        if (redefined && methodSignature(*redefined) == signature) return true;
+    }
+    return false;
+}
+void CodeGenerator::generateClassDeclaration(const ClassDeclaration* decl) {
+    currentClass = decl;
+    bool isFinal = !decl->superclass.empty() && !hierarchy.isExtended(decl->name);
+    out << indent() << "struct " << decl->name;
+    if (isFinal) {
+        out << " final";
+    }
     if (!decl->superclass.empty()) {
-        ss << " : public " << decl->superclass;
+        out << " : public " << decl->superclass;
+    } else if (!decl->soa) {
+        useModule("objects");
+        out << " : public RefCounted";
     }
-    ss << " {\n";
+    out << " {\n";
     indentLevel++;
     
     // Fields
     for (const auto& member : decl->members) {
-        ss << indent() << typeToCppType(member.type) << " " << member.name;
+        std::string type = typeToCppType(member.type);
+        if (!decl->soa && !member.cppType.empty() && (member.type == Type::ANY || member.type == Type::ARRAY)) {
+            useModulesOf(member.cppType);
+            type = objectTypes(member.cppType);
+        }
+        out << indent() << type << " " << member.name;
         if (member.initializer) {
-            ss << " = " << generateExpression(member.initializer.get());
+            out << " = " << generateExpression(member.initializer.get());
+        }
+        out << ";\n";
+    }
+    if (decl->soa) {
+        // Rebuilds an element from its columns (see SoAArray).
+        if (!decl->constructor) out << "\n" << indent() << decl->name << "() = default;\n";
+        out << indent() << decl->name << "(SoAFields";
+        for (const auto& member : decl->members) {
+            out << ", " << typeToCppType(member.type) << " " << member.name;
+        }
+        out << ")";
+        for (size_t i = 0; i < decl->members.size(); i++) {
+            const std::string& field = decl->members[i].name;
+            out << (i == 0 ? " : " : ", ") << field << "(std::move(" << field << "))";
         }
-        ss << ";\n";
+        out << " {}\n";
+    }
+
+    if (decl->superclass.empty() && hierarchy.isExtended(decl->name)) {
+        // Released through a Ref to the base class.
+        out << "\n" << indent() << "virtual ~" << decl->name << "() = default;\n";
     }
 
     // Constructor
+    if (decl->constructor && !decl->constructor->parameters.empty() && hierarchy.isExtended(decl->name)) {
+        // Subclass constructors build the base part with its default constructor.
+        out << "\n" << indent() << decl->name << "() = default;\n";
+    }
     if (decl->constructor) {
-        ss << "\n" << indent() << decl->name << "(";
+        out << "\n" << positionMarker(decl->constructor->line, decl->constructor->column)
+            << indent() << decl->name << "(";
         for (size_t i = 0; i < decl->constructor->parameters.size(); i++) {
-            if (i > 0) ss << ", ";
-            ss << typeToCppType(decl->constructor->parameters[i].type) << " " << decl->constructor->parameters[i].name;
+            if (i > 0) out << ", ";
+            out << generateParameter(decl->constructor->parameters[i]);
         }
-        ss << ") {\n";
+        out << ") {\n";
+        boxedVariables.clear();
+        plainLocals.clear();
+        declareParameters(decl->constructor->parameters);
         indentLevel++;
+        emitProfileProbe(decl->name + ".constructor");
         for (const auto& stmt : decl->constructor->body) {
-            ss << generateStatement(stmt.get());
+            generateStatement(stmt.get());
         }
         indentLevel--;
-        ss << indent() << "}\n";
+        out << indent() << "}\n";
     }
 
-    // Methods
-    for (const auto& method : decl->methods) {
-        ss << "\n" << indent() << typeToCppType(method.returnType) << " " << method.name << "(";
-        for (size_t i = 0; i < method.parameters.size(); i++) {
-            if (i > 0) ss << ", ";
-            ss << typeToCppType(method.parameters[i].type) << " " << method.parameters[i].name;
-        }
-        ss << ") {\n";
-        indentLevel++;
-        for (const auto& stmt : method.body) {
-            ss << generateStatement(stmt.get());
+    // Methods (kept as text: a @soa element proxy gets a copy of them)
+    std::string methods = captureOutput([&] {
+        for (const auto& method : decl->methods) {
+            Dispatch dispatch = methodDispatch(decl, method);
+            bool result = !exceptions && throws.methodThrows(method.name);
+            std::string returnType = result ? resultType(decl->name + "." + method.name, method.returnType,
+                                                         method.returnCppType, method.body)
+                                            : typeToCppType(method.returnType);
+            out << "\n" << positionMarker(method.line, method.column) << indent()
+                << (dispatch == Dispatch::Virtual ? "virtual " : "")
+                << returnType << " " << method.name << "(";
+            for (size_t i = 0; i < method.parameters.size(); i++) {
+                if (i > 0) out << ", ";
+                out << generateParameter(method.parameters[i]);
+            }
+            out << ")";
+            if (dispatch == Dispatch::Override || (dispatch == Dispatch::FinalOverride && isFinal)) {
+                out << " override";
+            } else if (dispatch == Dispatch::FinalOverride) {
+                out << " override final";
+            }
+            out << " {\n";
+            boxedVariables.clear();
+            plainLocals.clear();
+            declareParameters(method.parameters);
+            indentLevel++;
+            emitProfileProbe(decl->name + "." + method.name);
+            if (result) errorTargets.push_back({ErrorTarget::Return});
+            returnsVoidResult = returnType == "Result<void>";
+            for (const auto& stmt : method.body) {
+                generateStatement(stmt.get());
+            }
+            if (returnsVoidResult) out << indent() << "return {};\n";
+            returnsVoidResult = false;
+            if (result) errorTargets.pop_back();
+            indentLevel--;
+            out << indent() << "}\n";
         }
-        indentLevel--;
-        ss << indent() << "}\n";
-    }
+    });
+    out << methods;
 
     indentLevel--;
-    ss << indent() << "};\n\n";
-    return ss.str();
+    out << indent() << "};\n\n";
+    currentClass = nullptr;
+    if (decl->soa) generateSoALayout(decl, methods);
+}
+
+void CodeGenerator::generateSoALayout(const ClassDeclaration* decl, const std::string& methods) {
+    // The element proxy refers to one slot of each column. Its fields have
+    // the class's field names, so the class's methods compile unchanged
+    // against it and `xs[i].x = v` writes straight into the column.
+    const std::string& name = decl->name;
+    std::string ref = name + "_SoARef";
+    out << generatedMarker();
+    out << "template<bool Const>\n";
+    out << "struct " << ref << " {\n";
+    indentLevel++;
+    for (const auto& member : decl->members) {
+        out << indent() << "SoAField<" << typeToCppType(member.type) << ", Const> " << member.name << ";\n";
+    }
+    std::string fields, assignFrom, assignOther;
+    for (const auto& member : decl->members) {
+        fields += ", " + member.name;
+        assignFrom += member.name + " = value." + member.name + "; ";
+        assignOther += member.name + " = other." + member.name + "; ";
+    }
+    out << "\n" << indent() << "operator " << name << "() const { return " << name << "(SoAFields{}" << fields << "); }\n";
+    out << indent() << ref << "& operator=(const " << name << "& value) { " << assignFrom << "return *this; }\n";
+    out << indent() << ref << "& operator=(const " << ref << "& other) { " << assignOther << "return *this; }\n";
+    indentLevel--;
+    out << methods;
+    out << generatedMarker();
+    out << "};\n";
+    out << "namespace umbrella::runtime {\n";
+    out << "template<>\n";
+    out << "struct SoALayout<" << name << "> {\n";
+    out << "    static constexpr auto fields = std::make_tuple(";
+    for (size_t i = 0; i < decl->members.size(); i++) {
+        if (i > 0) out << ", ";
+        out << "&" << name << "::" << decl->members[i].name;
+    }
+    out << ");\n";
+    out << "    template<bool Const>\n";
+    out << "    using Ref = " << ref << "<Const>;\n";
+    out << "};\n";
+    out << "template<>\n";
+    out << "class Array<" << name << "> : public SoAArray<" << name << "> {\n";
+    out << "public:\n";
+    out << "    using SoAArray<" << name << ">::SoAArray;\n";
+    out << "};\n";
+    out << "}\n\n";
 }
 
-std::string CodeGenerator::generateReturnStatement(const ReturnStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "return";
+void CodeGenerator::generateReturnStatement(const ReturnStatement* stmt) {
+    out << indent() << "return";
     if (stmt->value) {
-        ss << " " << generateExpression(stmt->value.get());
+        out << " " << generateExpression(stmt->value.get());
+    } else if (returnsVoidResult) {
+        out << " {}";
     }
-    ss << ";\n";
-    return ss.str();
+    out << ";\n";
 }
-std::string CodeGenerator::generateIfStatement(const IfStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "if (" << generateExpression(stmt->condition.get()) << ") {\n";
+void CodeGenerator::generateIfStatement(const IfStatement* stmt) {
+    out << indent() << "if (" << generateExpression(stmt->condition.get()) << ") {\n";
     indentLevel++;
     for (const auto& s : stmt->thenBranch) {
-        ss << generateStatement(s.get());
+        generateStatement(s.get());
     }
     indentLevel--;
-    ss << indent() << "}";
+    out << indent() << "}";
     if (!stmt->elseBranch.empty()) {
-        ss << " else {\n";
+        out << " else {\n";
         indentLevel++;
         for (const auto& s : stmt->elseBranch) {
-            ss << generateStatement(s.get());
+            generateStatement(s.get());
         }
         indentLevel--;
-        ss << indent() << "}";
+        out << indent() << "}";
     }
-    ss << "\n";
-    return ss.str();
+    out << "\n";
 }
-std::string CodeGenerator::generateWhileStatement(const WhileStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "while (" << generateExpression(stmt->condition.get()) << ") {\n";
+void CodeGenerator::generateWhileStatement(const WhileStatement* stmt) {
+    out << indent() << "while (" << generateExpression(stmt->condition.get()) << ") {\n";
     indentLevel++;
     for (const auto& s : stmt->body) {
-        ss << generateStatement(s.get());
+        generateStatement(s.get());
     }
     indentLevel--;
-    ss << indent() << "}\n";
-    return ss.str();
+    out << indent() << "}\n";
 }
-std::string CodeGenerator::generateForStatement(const ForStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "for (";
+void CodeGenerator::generateForStatement(const ForStatement* stmt) {
+    // The parser only accepts `let i = from; i < to; i = i + 1` after
+    // `parallel`, so the loop maps onto an index range and the body becomes a
+    // per-index callback. Running it sequentially is always correct, so a loop
+    // the optimizer has reshaped falls through to a plain for.
+    auto init = dynamic_cast<const VariableDeclaration*>(stmt->initializer.get());
+    auto cond = dynamic_cast<const BinaryExpression*>(stmt->condition.get());
+    if (stmt->parallel && init && init->initializer && cond && cond->op == "<") {
+        std::string var = sanitize(init->name);
+        out << indent() << "parallelFor(" << generateExpression(init->initializer.get()) << ", "
+            << generateExpression(cond->right.get()) << ", [&](double " << var << ") {\n";
+        declaredVariables.insert(init->name);
+        variableTypes[init->name] = Type::NUMBER;
+        indentLevel++;
+        bool enclosingReturnsVoidResult = std::exchange(returnsVoidResult, false);
+        errorTargets.push_back({ErrorTarget::Fatal});
+        for (const auto& s : stmt->body) {
+            generateStatement(s.get());
+        }
+        errorTargets.pop_back();
+        returnsVoidResult = enclosingReturnsVoidResult;
+        indentLevel--;
+        out << indent() << "});\n";
+        return;
+    }
+    out << indent() << "for (";
     if (stmt->initializer) {
-        std::string init = generateStatement(stmt->initializer.get());
+        std::string init = captureOutput([&] { generateStatementCode(stmt->initializer.get()); });
         size_t start = init.find_first_not_of(" \t");
         size_t end = init.find_last_not_of(" \t\n;");
         if (start != std::string::npos && end != std::string::npos) {
-            ss << init.substr(start, end - start + 1);
+            out << init.substr(start, end - start + 1);
         }
     }
-    ss << "; ";
+    out << "; ";
     if (stmt->condition) {
-        ss << generateExpression(stmt->condition.get());
+        out << generateExpression(stmt->condition.get());
     }
-    ss << "; ";
+    out << "; ";
     if (stmt->increment) {
-        ss << generateExpression(stmt->increment.get());
+        out << generateExpression(stmt->increment.get());
+    }
+    out << ") {\n";
+    indentLevel++;
+    for (const auto& s : stmt->body) {
+        generateStatement(s.get());
     }
-    ss << ") {\n";
+    indentLevel--;
+    out << indent() << "}\n";
+}
+void CodeGenerator::generateForOfStatement(const ForOfStatement* stmt) {
+    std::string binding = sanitize(stmt->name);
+    if (!stmt->valueName.empty()) binding = "[" + binding + ", " + sanitize(stmt->valueName) + "]";
+    // A body that may resize the collection iterates over a snapshot, so no
+    // iterator or element reference is invalidated under it. Anything but a
+    // plain local (a global, a field, a parameter or other alias of the
+    // caller's data) can also be resized by any user code it calls.
+    std::string iterable = generateExpression(stmt->iterable.get());
+    auto root = dynamic_cast<const Identifier*>(stmt->iterable.get());
+    bool member = false;
+    for (auto access = dynamic_cast<const MemberExpression*>(stmt->iterable.get()); access;
+         access = dynamic_cast<const MemberExpression*>(access->object.get())) {
+        root = dynamic_cast<const Identifier*>(access->object.get());
+        member = true;
+    }
+    bool reachable = member || !root || !plainLocals.count(root->name) || captures.isGlobal(root->name);
+    if ((root && collectResizedNames(stmt->body).count(root->name)) ||
+        (reachable && captures.callsUserCode(stmt->body))) {
+        iterable = "snapshot(" + iterable + ")";
+    }
+    out << indent() << "for (" << (stmt->isConst ? "const auto& " : "auto ") << binding
+        << " : " << iterable << ") {\n";
     indentLevel++;
+    for (const auto& name : {stmt->name, stmt->valueName}) {
+        if (name.empty()) continue;
+        declaredVariables.insert(name);
+        variableTypes[name] = Type::ANY;
+    }
     for (const auto& s : stmt->body) {
-        ss << generateStatement(s.get());
+        generateStatement(s.get());
     }
     indentLevel--;
-    ss << indent() << "}\n";
-    return ss.str();
+    out << indent() << "}\n";
 }
-std::string CodeGenerator::generateBlockStatement(const BlockStatement* stmt) {
-    std::stringstream ss;
-    ss << indent() << "{\n";
+void CodeGenerator::generateBlockStatement(const BlockStatement* stmt) {
+    out << indent() << "{\n";
     indentLevel++;
     for (const auto& s : stmt->statements) {
-        ss << generateStatement(s.get());
+        generateStatement(s.get());
     }
     indentLevel--;
-    ss << indent() << "}\n";
-    return ss.str();
+    out << indent() << "}\n";
 }
-std::string CodeGenerator::generateExpressionStatement(const ExpressionStatement* stmt) {
-    return indent() + generateExpression(stmt->expression.get()) + ";\n";
+void CodeGenerator::generateExpressionStatement(const ExpressionStatement* stmt) {
+    out << indent() << generateExpression(stmt->expression.get()) << ";\n";
 }
 std::string CodeGenerator::generateNumberLiteral(const NumberLiteral* expr) {
-    return std::to_string(expr->value);
+    // Shortest spelling that round-trips, so folded constants keep full precision.
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), expr->value);
+    std::string text(buffer, result.ptr);
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
 }
 std::string CodeGenerator::generateStringLiteral(const StringLiteral* expr) {
-    return "std::string(\"" + escapeString(expr->value) + "\")";
+    return poolLiteral("std::string", "\"" + escapeString(expr->value) + "\"");
+}
+// Declares `static const type name = value;` once per distinct literal and
+// returns the name, so a literal inside a loop or a hot function is built at
+// startup instead of on every evaluation. Uses that need their own copy
+// (a variable, a push) still copy it; reads and const& arguments do not.
+std::string CodeGenerator::poolLiteral(const std::string& type, const std::string& value) {
+    auto [it, inserted] = literalNames.try_emplace(type + " " + value);
+    if (inserted) {
+        it->second = "_lit" + std::to_string(literalNames.size() - 1);
+        literalPool << "static const " << type << " " << it->second << " = " << value << ";\n";
+    }
+    return it->second;
 }
 std::string CodeGenerator::generateBooleanLiteral(const BooleanLiteral* expr) {
     return expr->value ? "true" : "false";
@@ -555,10 +1176,20 @@ std::string CodeGenerator::sanitize(const std::string& name) {
 }
 
 std::string CodeGenerator::generateIdentifier(const Identifier* expr) {
+    if (expr->name == "this" && currentClass && !currentClass->soa) {
+        // `this` used as a value: one more reference to the object.
+        return "Ref(this)";
+    }
+    if (boxedVariables.count(expr->name)) {
+        return "(*" + sanitize(expr->name) + ")";
+    }
+    if (captures.isLastUse(expr)) {
+        return "std::move(" + sanitize(expr->name) + ")";
+    }
     return sanitize(expr->name);
 }
 std::string CodeGenerator::generateBinaryExpression(const BinaryExpression* expr) {
-    std::stringstream ss;
+    CodeWriter ss;
     std::string left = generateExpression(expr->left.get());
     std::string right = generateExpression(expr->right.get());
     if (expr->op == "+") {
@@ -570,58 +1201,82 @@ std::string CodeGenerator::generateBinaryExpression(const BinaryExpression* expr
             left.find("std::string") != std::string::npos || 
             right.find("std::string") != std::string::npos) { // Added more checks for string concat
             ss << "(" << left << " + " << right << ")";
-            return ss.str();
+            return ss.take();
         }
     }
     
     // Bitwise operators require integer operands in C++
     if (expr->op == "&" || expr->op == "|" || expr->op == "^" || expr->op == "<<" || expr->op == ">>") {
          ss << "((long long)" << left << " " << expr->op << " (long long)" << right << ")";
-         return ss.str();
+         return ss.take();
     }
     
     ss << "(" << left << " " << expr->op << " " << right << ")";
-    return ss.str();
+    return ss.take();
 }
 std::string CodeGenerator::generateUnaryExpression(const UnaryExpression* expr) {
     return "(" + expr->op + generateExpression(expr->operand.get()) + ")";
 }
 std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
-    std::stringstream ss;
+    CodeWriter ss;
     if (auto id = dynamic_cast<const Identifier*>(expr->callee.get())) {
         if (id->name == "print" || id->name == "println") {
-            ss << "std::cout";
-            for (const auto& arg : expr->arguments) {
-                ss << " << " << generateExpression(arg.get());
-            }
-            if (id->name == "println") {
-                ss << " << std::endl";
+            // Buffered runtime output; std::endl would flush on every line.
+            ss << (id->name == "println" ? "Output::printLine(" : "Output::print(");
+            for (size_t i = 0; i < expr->arguments.size(); i++) {
+                if (i > 0) ss << ", ";
+                ss << generateExpression(expr->arguments[i].get());
             }
-            return ss.str();
+            ss << ")";
+            return ss.take();
         }
     }
 
-    // Handle string instance methods via static helpers in runtime::String
     if (auto member = dynamic_cast<const MemberExpression*>(expr->callee.get())) {
         const std::string& method = member->property;
-        std::string objectCode = generateExpression(member->object.get());
+        auto self = dynamic_cast<const Identifier*>(member->object.get());
+        if (self && self->name == "this" && currentClass) {
+            // A virtual method that no class below this one redefines has a
+            // single possible target here: call it directly.
+            if (const ClassDeclaration* target = hierarchy.definingClass(currentClass->name, method)) {
+                const MethodDeclaration* callee = findMethod(target, method);
+                if (methodDispatch(target, *callee) != Dispatch::Static &&
+                    !isOverriddenBelow(currentClass->name, method, methodSignature(*callee))) {
+                    ss << "this->" << target->name << "::" << method << "(";
+                    for (size_t i = 0; i < expr->arguments.size(); i++) {
+                        if (i > 0) ss << ", ";
+                        ss << generateExpression(expr->arguments[i].get());
+                    }
+                    ss << ")";
+                    return ss.take();
+                }
+            }
+        }
+
+        // Handle string instance methods via static helpers in runtime::String
+        std::string objectCode = generateObjectExpression(member->object.get());
+        static const std::set<std::string> stringMethods = {
+            "toUpperCase", "toLowerCase", "substring", "indexOf", "replace", "split",
+            "trim", "startsWith", "endsWith", "repeat", "padStart", "padEnd"
+        };
+        if (stringMethods.count(method)) useModule("string");
 
         auto joinArgs = [&](size_t startIndex = 0) {
-            std::stringstream argsSs;
+            CodeWriter argsSs;
             for (size_t i = startIndex; i < expr->arguments.size(); ++i) {
                 if (i > startIndex) argsSs << ", ";
                 argsSs << generateExpression(expr->arguments[i].get());
             }
-            return argsSs.str();
+            return argsSs.take();
         };
 
         if (method == "toUpperCase") {
             ss << "String::toUpperCase(" << objectCode << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "toLowerCase") {
             ss << "String::toLowerCase(" << objectCode << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "substring") {
             ss << "String::substring(" << objectCode;
@@ -629,7 +1284,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "indexOf") {
             ss << "String::indexOf(" << objectCode;
@@ -637,7 +1292,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "replace") {
             ss << "String::replace(" << objectCode;
@@ -645,7 +1300,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "split") {
             ss << "String::split(" << objectCode;
@@ -653,11 +1308,11 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "trim") {
             ss << "String::trim(" << objectCode << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "startsWith") {
             ss << "String::startsWith(" << objectCode;
@@ -665,7 +1320,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "endsWith") {
             ss << "String::endsWith(" << objectCode;
@@ -673,7 +1328,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "repeat") {
             ss << "String::repeat(" << objectCode;
@@ -681,7 +1336,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "padStart") {
             ss << "String::padStart(" << objectCode;
@@ -689,7 +1344,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
         if (method == "padEnd") {
             ss << "String::padEnd(" << objectCode;
@@ -697,7 +1352,7 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
                 ss << ", " << joinArgs(0);
             }
             ss << ")";
-            return ss.str();
+            return ss.take();
         }
     }
 
@@ -707,10 +1362,39 @@ std::string CodeGenerator::generateCallExpression(const CallExpression* expr) {
         ss << generateExpression(expr->arguments[i].get());
     }
     ss << ")";
-    return ss.str();
+    return ss.take();
 }
 std::string CodeGenerator::generateArrayExpression(const ArrayExpression* expr) {
-    std::stringstream ss;
+    // Arrays of literals are pooled like string literals.
+    bool constant = !expr->elements.empty() &&
+                    (expr->elementType == Type::NUMBER || expr->elementType == Type::STRING ||
+                     expr->elementType == Type::BOOLEAN);
+    for (const auto& element : expr->elements) {
+        constant = constant && (dynamic_cast<const NumberLiteral*>(element.get()) ||
+                                dynamic_cast<const StringLiteral*>(element.get()) ||
+                                dynamic_cast<const BooleanLiteral*>(element.get()));
+    }
+    if (!constant) {
+        return generateArrayElements(expr);
+    }
+    std::string cppType = typeToCppType(expr->elementType);
+    CodeWriter ss;
+    ss << "Array<" << cppType << ">{";
+    for (size_t i = 0; i < expr->elements.size(); i++) {
+        if (i > 0) ss << ", ";
+        if (auto strLit = dynamic_cast<const StringLiteral*>(expr->elements[i].get())) {
+            ss << "\"" << escapeString(strLit->value) << "\"";
+        } else {
+            ss << generateExpression(expr->elements[i].get());
+        }
+    }
+    ss << "}";
+    return poolLiteral("Array<" + cppType + ">", ss.take());
+}
+// A fresh array built in place: arrayOf moves or constructs each element
+// straight into the storage rather than copying it out of an initializer list.
+std::string CodeGenerator::generateArrayElements(const ArrayExpression* expr) {
+    CodeWriter ss;
     std::string cppType = typeToCppType(expr->elementType);
     if (expr->elements.empty()) {
         // Default to double if empty, or perhaps ANY/auto might be tricky in C++
@@ -719,14 +1403,24 @@ std::string CodeGenerator::generateArrayExpression(const ArrayExpression* expr)
         if (expr->elementType == Type::ANY) {
              cppType = "double";
         }
+        ss << "Array<" << cppType << ">()";
+        return ss.take();
     }
-    ss << "Array<" << cppType << ">(std::vector<" << cppType << ">{";
+    ss << "arrayOf<" << cppType << ">(";
     for (size_t i = 0; i < expr->elements.size(); i++) {
         if (i > 0) ss << ", ";
         ss << generateExpression(expr->elements[i].get());
     }
-    ss << "})";
-    return ss.str();
+    ss << ")";
+    return ss.take();
+}
+// The object of a member access or method call. Pooled array literals are
+// const, so an array literal that a method is called on is built fresh.
+std::string CodeGenerator::generateObjectExpression(const Expression* expr) {
+    if (auto arrExpr = dynamic_cast<const ArrayExpression*>(expr)) {
+        return generateArrayElements(arrExpr);
+    }
+    return generateExpression(expr);
 }
 std::string CodeGenerator::typeToCppType(Type type) {
     switch (type) {
@@ -740,7 +1434,7 @@ std::string CodeGenerator::typeToCppType(Type type) {
     }
 }
 std::string CodeGenerator::escapeString(const std::string& str) {
-    std::stringstream ss;
+    CodeWriter ss;
     for (char c : str) {
         switch (c) {
             case '\n': ss << "\\n"; break;
@@ -751,9 +1445,45 @@ std::string CodeGenerator::escapeString(const std::string& str) {
             default: ss << c;
         }
     }
-    return ss.str();
+    return ss.take();
+}
+// Return type of a function or method that can throw, under --no-exceptions.
+// It has to be spelled out, so one that returns a value needs a declared type.
+std::string CodeGenerator::resultType(const std::string& name, Type type, const std::string& cppType,
+                                      const std::vector<std::unique_ptr<Statement>>& body) {
+    std::string valueType = typeToCppType(type);
+    if (valueType == "auto" && type != Type::FUNCTION && !cppType.empty()) {
+        useModulesOf(cppType);
+        valueType = objectTypes(cppType);
+    } else if (valueType == "auto" && cppType.empty() && !returnsValue(body)) {
+        valueType = "void";
+    }
+    if (valueType == "auto") {
+        throw std::runtime_error("'" + name + "' can throw, so --no-exceptions needs its return type declared");
+    }
+    return "Result<" + valueType + ">";
+}
+// The statement that hands an error with the given message to the current ErrorTarget.
+std::string CodeGenerator::raiseError(const std::string& message) {
+    if (errorTargets.empty() || errorTargets.back().kind == ErrorTarget::Fatal) {
+        return "fatalError(" + message + ");";
+    }
+    ErrorTarget& target = errorTargets.back();
+    if (target.kind == ErrorTarget::Return) return "return Error{" + message + "};";
+    target.used = true;
+    return "{ " + target.variable + " = " + message + "; goto " + target.label + "; }";
+}
+// A call that can throw, as an expression with the value of the call. The
+// check is a GNU statement expression, which can leave the enclosing
+// function or jump to a catch block; where neither can take the error, a
+// failed call ends the program.
+std::string CodeGenerator::checkedCall(const std::string& call) {
+    if (errorTargets.empty() || errorTargets.back().kind == ErrorTarget::Fatal) return "orFail(" + call + ")";
+    std::string result = "_result" + std::to_string(checkedCalls++);
+    return "({ auto " + result + " = " + call + "; if (failed(" + result + ")) " +
+           raiseError("errorOf(" + result + ")") + " unwrap(std::move(" + result + ")); })";
 }
-std::string CodeGenerator::indent() {
-    return std::string(indentLevel * 4, ' ');
+CodeWriter::Indent CodeGenerator::indent() {
+    return CodeWriter::Indent{indentLevel};
 }
 }  
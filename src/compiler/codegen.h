@@ -1,5 +1,9 @@
 #pragma once
 #include "ast.h"
+#include "analysis.h"
+#include "writer.h"
+#include "modules.h"
+#include <functional>
 #include <string>
 #include <map>
 #include <set>
@@ -8,23 +12,53 @@ class CodeGenerator {
 public:
     CodeGenerator();
     std::string generate(const Program& program);
+    // Emit #line directives so that debug info and diagnostics point at the
+    // .umb source; code the compiler adds points back at the generated file.
+    void setLineDirectives(const std::string& sourcePath, const std::string& generatedPath);
+    struct SourceMapping {
+        int cppLine;
+        int umbLine;
+        int umbColumn; // 0 past the first line of a statement
+    };
+    // Set by generate() when line directives are on.
+    const std::vector<SourceMapping>& sourceMap() const;
+    // Open a ProfileScope at the start of every function and method (--profile).
+    void setProfiling(bool enabled);
+    // Lower `throw` and `try` to Result values instead of C++ exceptions,
+    // for programs built with -fno-exceptions (--no-exceptions).
+    void setExceptions(bool enabled);
+    // Set by generate(): the core, then the modules the program uses.
+    std::vector<const RuntimeModule*> runtimeModules() const;
 private:
-    std::string generateStatement(const Statement* stmt);
+    void generateStatement(const Statement* stmt);
+    void generateStatementCode(const Statement* stmt);
+    std::string positionMarker(int line, int column);
+    std::string generatedMarker();
+    std::string resolveLineMarkers(const std::string& code);
+    void emitProfileProbe(const std::string& name);
+    std::string captureOutput(const std::function<void()>& emit);
+    void useModule(const std::string& name);
+    void useModulesOf(std::string_view code);
+    bool isObjectClass(const std::string& name) const;
+    std::string objectTypes(std::string_view type) const;
     std::string generateExpression(const Expression* expr);
     std::string generateAssignmentExpression(const AssignmentExpression* expr);
     std::string generateArrayAccess(const ArrayAccess* expr);
-    std::string generateVariableDeclaration(const VariableDeclaration* decl);
-    std::string generateFunctionDeclaration(const FunctionDeclaration* decl);
+    void generateVariableDeclaration(const VariableDeclaration* decl);
+    void generateBoxedDeclaration(const VariableDeclaration* decl);
+    void generateFunctionDeclaration(const FunctionDeclaration* decl);
     std::string generateFunctionExpression(const FunctionExpression* expr);
-    std::string generateClassDeclaration(const ClassDeclaration* decl);
-    std::string generateReturnStatement(const ReturnStatement* stmt);
-    std::string generateIfStatement(const IfStatement* stmt);
-    std::string generateWhileStatement(const WhileStatement* stmt);
-    std::string generateForStatement(const ForStatement* stmt);
-    std::string generateTryStatement(const TryStatement* stmt);
-    std::string generateThrowStatement(const ThrowStatement* stmt); // Added
-    std::string generateBlockStatement(const BlockStatement* stmt);
-    std::string generateExpressionStatement(const ExpressionStatement* stmt);
+    void generateClassDeclaration(const ClassDeclaration* decl);
+    void generateSoALayout(const ClassDeclaration* decl, const std::string& methods);
+    void generateReturnStatement(const ReturnStatement* stmt);
+    void generateIfStatement(const IfStatement* stmt);
+    void generateWhileStatement(const WhileStatement* stmt);
+    void generateForStatement(const ForStatement* stmt);
+    void generateForOfStatement(const ForOfStatement* stmt);
+    void generateTryStatement(const TryStatement* stmt);
+    void generateThrowStatement(const ThrowStatement* stmt); // Added
+    void generateBlockStatement(const BlockStatement* stmt);
+    void generateExpressionStatement(const ExpressionStatement* stmt);
     std::string generateNumberLiteral(const NumberLiteral* expr);
     std::string generateStringLiteral(const StringLiteral* expr);
     std::string generateBooleanLiteral(const BooleanLiteral* expr);
@@ -33,16 +67,70 @@ private:
     std::string generateUnaryExpression(const UnaryExpression* expr);
     std::string generateCallExpression(const CallExpression* expr);
     std::string generateArrayExpression(const ArrayExpression* expr);
+    std::string generateArrayElements(const ArrayExpression* expr);
+    std::string generateObjectExpression(const Expression* expr);
+    std::string poolLiteral(const std::string& type, const std::string& value);
     std::string generateMapLiteral(const MapLiteral* expr);
     std::string generateMemberExpression(const MemberExpression* expr);
     std::string generateNewExpression(const NewExpression* expr);
     std::string generateConditionalExpression(const ConditionalExpression* expr); // Added
+    bool collectAppendPieces(const AssignmentExpression* expr, std::vector<const Expression*>& pieces);
+    std::string generateParameter(const FunctionParameter& param);
+    std::string parameterType(const FunctionParameter& param);
+    // How a method defined in a class is bound; see methodDispatch.
+    enum class Dispatch { Static, Virtual, Override, FinalOverride };
+    Dispatch methodDispatch(const ClassDeclaration* decl, const MethodDeclaration& method);
+    std::string methodSignature(const MethodDeclaration& method);
+    bool isOverriddenBelow(const std::string& className, const std::string& method, const std::string& signature);
+    void declareParameters(const std::vector<FunctionParameter>& params);
     std::string typeToCppType(Type type);
+    std::string resultType(const std::string& name, Type type, const std::string& cppType,
+                           const std::vector<std::unique_ptr<Statement>>& body);
+    std::string raiseError(const std::string& message);
+    std::string checkedCall(const std::string& call);
     std::string escapeString(const std::string& str);
     std::string sanitize(const std::string& name); // Added
     int indentLevel;
-    std::string indent();
+    CodeWriter::Indent indent();
     std::set<std::string> declaredVariables;
     std::map<std::string, Type> variableTypes;
+    CaptureAnalysis captures;
+    ClassHierarchy hierarchy;
+    // Class whose constructor or methods are being generated, or nullptr.
+    const ClassDeclaration* currentClass = nullptr;
+    // Fields and methods of classes held by Ref; accesses to them go through deref.
+    std::set<std::string> objectMembers;
+    // Locals of the current function that live in a shared heap box.
+    std::set<std::string> boxedVariables;
+    // Locals and by-value parameters of the current function that hold their
+    // own value, not a box or a reference to other data.
+    std::set<std::string> plainLocals;
+    std::string sourcePath;
+    std::string generatedPath;
+    std::vector<SourceMapping> mappings;
+    bool profiling = false;
+    bool exceptions = true;
+    ThrowAnalysis throws;
+    // Where an error raised in the code being generated goes without
+    // exceptions: out of the program (also when the stack is empty), out of
+    // the function as a failed Result, or to the catch block of a `try`.
+    struct ErrorTarget {
+        enum Kind { Fatal, Return, Handler } kind = Fatal;
+        std::string variable = {}; // Handler: the message
+        std::string label = {};    // Handler: the catch block
+        bool used = false;
+    };
+    std::vector<ErrorTarget> errorTargets;
+    int errorHandlers = 0;
+    int checkedCalls = 0;
+    // The function being generated returns Result<void>: `return;` becomes `return {};`.
+    bool returnsVoidResult = false;
+    // Statement generators append here; see CodeWriter.
+    CodeWriter out;
+    std::set<std::string> usedModules;
+    // Constant literals hoisted to namespace scope: "type value" -> name, and
+    // their declarations in first-use order.
+    std::map<std::string, std::string> literalNames;
+    CodeWriter literalPool;
 };
 }  
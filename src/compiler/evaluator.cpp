@@ -0,0 +1,662 @@
+#include "evaluator.h"
+#include "../runtime/runtime.h"
+#include "../runtime/strings.h"
+#include <cmath>
+#include <limits>
+#include <sstream>
+namespace umbrella {
+namespace {
+const long long maxSteps = 2000000;
+const int maxDepth = 400;
+const size_t maxResultSize = 4096;
+
+const std::set<std::string> pureMath = {
+    "sqrt", "pow", "abs", "floor", "ceil", "round", "max", "min"
+};
+const std::set<std::string> pureString = {
+    "length", "toUpperCase", "toLowerCase", "substring", "indexOf", "replace",
+    "trim", "startsWith", "endsWith", "repeat", "padStart", "padEnd"
+};
+
+// Checks that a function body only uses constructs the evaluator supports and
+// only touches its own parameters and locals.
+class PurityChecker : public ASTVisitor {
+public:
+    std::set<std::string> locals;
+    const std::set<std::string>& constants;
+    std::set<std::string> callees;
+    bool pure = true;
+    PurityChecker(const std::set<std::string>& c) : constants(c) {}
+
+    bool isLocal(const Expression* expr) const {
+        auto id = dynamic_cast<const Identifier*>(expr);
+        return id && locals.count(id->name);
+    }
+    bool visitStatement(const Statement* stmt) override {
+        if (!pure) return false;
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+            locals.insert(decl->name);
+            return true;
+        }
+        // Only arrays are modelled, so `[key, value]` bindings over maps are not.
+        if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+            if (!forOf->valueName.empty()) {
+                pure = false;
+                return false;
+            }
+            locals.insert(forOf->name);
+            return true;
+        }
+        if (dynamic_cast<const ReturnStatement*>(stmt) || dynamic_cast<const IfStatement*>(stmt) ||
+            dynamic_cast<const WhileStatement*>(stmt) || dynamic_cast<const ForStatement*>(stmt) ||
+            dynamic_cast<const BlockStatement*>(stmt) || dynamic_cast<const ExpressionStatement*>(stmt)) {
+            return true;
+        }
+        pure = false;
+        return false;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (!pure) return false;
+        if (dynamic_cast<const NumberLiteral*>(expr) || dynamic_cast<const StringLiteral*>(expr) ||
+            dynamic_cast<const BooleanLiteral*>(expr) || dynamic_cast<const BinaryExpression*>(expr) ||
+            dynamic_cast<const UnaryExpression*>(expr) || dynamic_cast<const ConditionalExpression*>(expr) ||
+            dynamic_cast<const ArrayExpression*>(expr) || dynamic_cast<const ArrayAccess*>(expr)) {
+            return true;
+        }
+        if (auto id = dynamic_cast<const Identifier*>(expr)) {
+            if (!locals.count(id->name) && !constants.count(id->name)) pure = false;
+            return false;
+        }
+        if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            const Expression* target = assign->left.get();
+            if (auto access = dynamic_cast<const ArrayAccess*>(target)) {
+                if (!isLocal(access->array.get())) pure = false;
+                walk(access->index.get(), *this);
+            } else if (!isLocal(target)) {
+                pure = false;
+            }
+            walk(assign->right.get(), *this);
+            return false;
+        }
+        if (auto member = dynamic_cast<const MemberExpression*>(expr)) {
+            if (member->property == "length") return true;
+            auto owner = dynamic_cast<const Identifier*>(member->object.get());
+            if (!owner || owner->name != "Math" || (member->property != "PI" && member->property != "E")) {
+                pure = false;
+            }
+            return false;
+        }
+        if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            for (const auto& arg : call->arguments) walk(arg.get(), *this);
+            if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) {
+                if (id->name != "toString") callees.insert(id->name);
+                return false;
+            }
+            auto member = dynamic_cast<const MemberExpression*>(call->callee.get());
+            if (!member) {
+                pure = false;
+                return false;
+            }
+            auto owner = dynamic_cast<const Identifier*>(member->object.get());
+            if (owner && owner->name == "Math" && !locals.count("Math")) {
+                if (!pureMath.count(member->property)) pure = false;
+            } else if (owner && owner->name == "String" && !locals.count("String")) {
+                if (!pureString.count(member->property)) pure = false;
+            } else if (member->property == "push") {
+                // Only locally owned arrays may be mutated.
+                if (!isLocal(member->object.get())) pure = false;
+            } else if (pureString.count(member->property)) {
+                walk(member->object.get(), *this);
+            } else {
+                pure = false;
+            }
+            return false;
+        }
+        pure = false;
+        return false;
+    }
+};
+}
+
+ConstEvaluator::ConstEvaluator() : steps(0), depth(0) {}
+
+void ConstEvaluator::analyze(Program& program, ConstantLookup lookup) {
+    constantLookup = lookup;
+    functions.clear();
+    topLevelConstants.clear();
+    pure.clear();
+    memo.clear();
+    for (const auto& stmt : program.statements) {
+        if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+            functions[func->name] = func;
+        } else if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt.get())) {
+            if (decl->isConst) topLevelConstants.insert(decl->name);
+        }
+    }
+    std::map<std::string, std::set<std::string>> callees;
+    for (const auto& entry : functions) {
+        const FunctionDeclaration* func = entry.second;
+        if (func->name == "main" || func->returnType == Type::VOID) continue;
+        PurityChecker checker(topLevelConstants);
+        for (const auto& param : func->parameters) {
+            if (param.type == Type::FUNCTION) checker.pure = false;
+            checker.locals.insert(param.name);
+        }
+        walk(func->body, checker);
+        if (checker.pure) {
+            pure.insert(func->name);
+            callees[func->name] = checker.callees;
+        }
+    }
+    // A function stays pure only if everything it calls is pure as well.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = pure.begin(); it != pure.end();) {
+            bool ok = true;
+            for (const auto& callee : callees[*it]) {
+                if (!pure.count(callee)) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (ok) {
+                ++it;
+            } else {
+                it = pure.erase(it);
+                changed = true;
+            }
+        }
+    }
+    for (auto& entry : functions) {
+        entry.second->isPure = pure.count(entry.first) > 0;
+    }
+}
+
+bool ConstEvaluator::isPure(const std::string& name) const {
+    return pure.count(name) > 0;
+}
+
+std::unique_ptr<Expression> ConstEvaluator::tryEvaluate(const std::string& name,
+                                                        const std::vector<std::unique_ptr<Expression>>& args) {
+    if (!pure.count(name)) return nullptr;
+    std::vector<Value> values;
+    for (const auto& arg : args) {
+        auto num = dynamic_cast<const NumberLiteral*>(arg.get());
+        auto str = dynamic_cast<const StringLiteral*>(arg.get());
+        auto boolean = dynamic_cast<const BooleanLiteral*>(arg.get());
+        if (!num && !str && !boolean) return nullptr;
+        values.push_back(fromLiteral(arg.get()));
+    }
+    const FunctionDeclaration* func = functions[name];
+    if (values.size() != func->parameters.size()) return nullptr;
+    steps = 0;
+    depth = 0;
+    try {
+        return toLiteral(call(func, values));
+    } catch (const EvalError&) {
+        return nullptr;
+    } catch (const std::exception&) {
+        // The runtime helpers may throw (e.g. bad substring bounds); leave the call to run time.
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Expression> ConstEvaluator::foldBuiltin(const std::string& owner, const std::string& method,
+                                                        const std::vector<const Expression*>& args) {
+    std::vector<Value> values;
+    for (const auto& arg : args) {
+        if (!dynamic_cast<const NumberLiteral*>(arg) && !dynamic_cast<const StringLiteral*>(arg) &&
+            !dynamic_cast<const BooleanLiteral*>(arg)) {
+            return nullptr;
+        }
+        values.push_back(fromLiteral(arg));
+    }
+    Value result;
+    try {
+        if (!callBuiltin(owner, method, values, result)) return nullptr;
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+    return toLiteral(result);
+}
+
+void ConstEvaluator::tick() {
+    if (++steps > maxSteps) throw EvalError();
+}
+
+ConstEvaluator::Value ConstEvaluator::call(const FunctionDeclaration* func, std::vector<Value> args) {
+    std::string key = memoKey(func->name, args);
+    auto cached = memo.find(key);
+    if (cached != memo.end()) return cached->second;
+    if (++depth > maxDepth) throw EvalError();
+    Frame frame;
+    frame.scopes.emplace_back();
+    for (size_t i = 0; i < func->parameters.size(); i++) {
+        frame.scopes.back()[func->parameters[i].name] = convert(args[i], func->parameters[i].type);
+    }
+    Value result;
+    try {
+        execBlock(func->body, frame);
+        // Falling off the end of a value-returning function has no defined result.
+        throw EvalError();
+    } catch (ReturnSignal& ret) {
+        result = convert(ret.value, func->returnType);
+    }
+    depth--;
+    memo[key] = result;
+    return result;
+}
+
+void ConstEvaluator::execBlock(const std::vector<std::unique_ptr<Statement>>& block, Frame& frame) {
+    frame.scopes.emplace_back();
+    for (const auto& stmt : block) {
+        exec(stmt.get(), frame);
+    }
+    frame.scopes.pop_back();
+}
+
+void ConstEvaluator::exec(const Statement* stmt, Frame& frame) {
+    tick();
+    if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+        if (!decl->initializer) throw EvalError();
+        frame.scopes.back()[decl->name] = convert(eval(decl->initializer.get(), frame), decl->varType);
+    } else if (auto ret = dynamic_cast<const ReturnStatement*>(stmt)) {
+        if (!ret->value) throw EvalError();
+        throw ReturnSignal{eval(ret->value.get(), frame)};
+    } else if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt)) {
+        if (truthy(eval(ifStmt->condition.get(), frame))) {
+            execBlock(ifStmt->thenBranch, frame);
+        } else {
+            execBlock(ifStmt->elseBranch, frame);
+        }
+    } else if (auto whileStmt = dynamic_cast<const WhileStatement*>(stmt)) {
+        while (truthy(eval(whileStmt->condition.get(), frame))) {
+            tick();
+            execBlock(whileStmt->body, frame);
+        }
+    } else if (auto forStmt = dynamic_cast<const ForStatement*>(stmt)) {
+        frame.scopes.emplace_back();
+        if (forStmt->initializer) exec(forStmt->initializer.get(), frame);
+        while (!forStmt->condition || truthy(eval(forStmt->condition.get(), frame))) {
+            tick();
+            execBlock(forStmt->body, frame);
+            if (forStmt->increment) eval(forStmt->increment.get(), frame);
+        }
+        frame.scopes.pop_back();
+    } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+        Value iterable = eval(forOf->iterable.get(), frame);
+        auto arr = std::get_if<Array>(&iterable.data);
+        if (!arr || !forOf->valueName.empty()) throw EvalError();
+        for (const Value& element : *arr) {
+            tick();
+            frame.scopes.emplace_back();
+            frame.scopes.back()[forOf->name] = element;
+            execBlock(forOf->body, frame);
+            frame.scopes.pop_back();
+        }
+    } else if (auto block = dynamic_cast<const BlockStatement*>(stmt)) {
+        execBlock(block->statements, frame);
+    } else if (auto exprStmt = dynamic_cast<const ExpressionStatement*>(stmt)) {
+        eval(exprStmt->expression.get(), frame);
+    } else {
+        throw EvalError();
+    }
+}
+
+ConstEvaluator::Value* ConstEvaluator::lookup(const std::string& name, Frame& frame) {
+    for (auto it = frame.scopes.rbegin(); it != frame.scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) return &found->second;
+    }
+    return nullptr;
+}
+
+ConstEvaluator::Value ConstEvaluator::eval(const Expression* expr, Frame& frame) {
+    tick();
+    if (dynamic_cast<const NumberLiteral*>(expr) || dynamic_cast<const StringLiteral*>(expr) ||
+        dynamic_cast<const BooleanLiteral*>(expr)) {
+        return fromLiteral(expr);
+    }
+    if (auto id = dynamic_cast<const Identifier*>(expr)) {
+        if (Value* local = lookup(id->name, frame)) return *local;
+        const Expression* constant = constantLookup ? constantLookup(id->name) : nullptr;
+        if (!constant) throw EvalError();
+        return fromLiteral(constant);
+    }
+    if (auto unary = dynamic_cast<const UnaryExpression*>(expr)) {
+        Value operand = eval(unary->operand.get(), frame);
+        if (unary->op == "!") return Value{!truthy(operand)};
+        auto num = std::get_if<double>(&operand.data);
+        if (!num) throw EvalError();
+        if (unary->op == "-") return Value{-*num};
+        if (unary->op == "~") return Value{static_cast<double>(~static_cast<long long>(*num))};
+        throw EvalError();
+    }
+    if (auto binary = dynamic_cast<const BinaryExpression*>(expr)) {
+        Value left = eval(binary->left.get(), frame);
+        if (binary->op == "&&") {
+            return truthy(left) ? Value{truthy(eval(binary->right.get(), frame))} : Value{false};
+        }
+        if (binary->op == "||") {
+            return truthy(left) ? Value{true} : Value{truthy(eval(binary->right.get(), frame))};
+        }
+        return evalBinary(binary->op, left, eval(binary->right.get(), frame));
+    }
+    if (auto cond = dynamic_cast<const ConditionalExpression*>(expr)) {
+        return truthy(eval(cond->condition.get(), frame)) ? eval(cond->thenExpr.get(), frame)
+                                                          : eval(cond->elseExpr.get(), frame);
+    }
+    if (auto assignment = dynamic_cast<const AssignmentExpression*>(expr)) {
+        Value value = eval(assignment->right.get(), frame);
+        if (assignment->op != "=") {
+            const std::string op = assignment->op.substr(0, assignment->op.size() - 1);
+            value = evalBinary(op, eval(assignment->left.get(), frame), value);
+        }
+        assign(assignment->left.get(), value, frame);
+        return value;
+    }
+    if (auto arrayExpr = dynamic_cast<const ArrayExpression*>(expr)) {
+        Array elements;
+        for (const auto& element : arrayExpr->elements) {
+            elements.push_back(eval(element.get(), frame));
+        }
+        return Value{elements};
+    }
+    if (auto access = dynamic_cast<const ArrayAccess*>(expr)) {
+        Value container = eval(access->array.get(), frame);
+        Value index = eval(access->index.get(), frame);
+        auto arr = std::get_if<Array>(&container.data);
+        auto idx = std::get_if<double>(&index.data);
+        if (!arr || !idx || *idx < 0 || *idx >= static_cast<double>(arr->size())) throw EvalError();
+        return (*arr)[static_cast<size_t>(*idx)];
+    }
+    if (auto member = dynamic_cast<const MemberExpression*>(expr)) {
+        if (auto owner = dynamic_cast<const Identifier*>(member->object.get())) {
+            if (owner->name == "Math" && !lookup("Math", frame)) {
+                if (member->property == "PI") return Value{umbrella::runtime::Math::PI};
+                if (member->property == "E") return Value{umbrella::runtime::Math::E};
+            }
+        }
+        Value object = eval(member->object.get(), frame);
+        if (member->property == "length") {
+            if (auto str = std::get_if<std::string>(&object.data)) return Value{static_cast<double>(str->size())};
+            if (auto arr = std::get_if<Array>(&object.data)) return Value{static_cast<double>(arr->size())};
+        }
+        throw EvalError();
+    }
+    if (auto callExpr = dynamic_cast<const CallExpression*>(expr)) {
+        return evalCall(callExpr, frame);
+    }
+    throw EvalError();
+}
+
+ConstEvaluator::Value ConstEvaluator::evalCall(const CallExpression* expr, Frame& frame) {
+    std::vector<Value> args;
+    for (const auto& arg : expr->arguments) {
+        args.push_back(eval(arg.get(), frame));
+    }
+    if (auto id = dynamic_cast<const Identifier*>(expr->callee.get())) {
+        if (id->name == "toString" && args.size() == 1) {
+            Value result;
+            if (callBuiltin("", "toString", args, result)) return result;
+            throw EvalError();
+        }
+        auto func = functions.find(id->name);
+        if (func == functions.end() || !pure.count(id->name) ||
+            args.size() != func->second->parameters.size()) {
+            throw EvalError();
+        }
+        return call(func->second, args);
+    }
+    auto member = dynamic_cast<const MemberExpression*>(expr->callee.get());
+    if (!member) throw EvalError();
+    auto owner = dynamic_cast<const Identifier*>(member->object.get());
+    if (owner && (owner->name == "Math" || owner->name == "String") && !lookup(owner->name, frame)) {
+        Value result;
+        if (callBuiltin(owner->name, member->property, args, result)) return result;
+        throw EvalError();
+    }
+    if (member->property == "push") {
+        Value* target = owner ? lookup(owner->name, frame) : nullptr;
+        auto arr = target ? std::get_if<Array>(&target->data) : nullptr;
+        if (!arr) throw EvalError();
+        for (const auto& arg : args) arr->push_back(arg);
+        if (arr->size() > maxResultSize) throw EvalError();
+        return Value{static_cast<double>(arr->size())};
+    }
+    // Instance string methods are the static helpers with the receiver first.
+    args.insert(args.begin(), eval(member->object.get(), frame));
+    Value result;
+    if (callBuiltin("String", member->property, args, result)) return result;
+    throw EvalError();
+}
+
+bool ConstEvaluator::callBuiltin(const std::string& owner, const std::string& method,
+                                 const std::vector<Value>& args, Value& result) {
+    namespace rt = umbrella::runtime;
+    auto num = [&](size_t i) { return i < args.size() ? std::get_if<double>(&args[i].data) : nullptr; };
+    auto str = [&](size_t i) { return i < args.size() ? std::get_if<std::string>(&args[i].data) : nullptr; };
+    auto asInt = [&](size_t i, int& out) {
+        auto n = num(i);
+        if (!n || !std::isfinite(*n) || *n < std::numeric_limits<int>::min() ||
+            *n > std::numeric_limits<int>::max()) {
+            return false;
+        }
+        out = static_cast<int>(*n);
+        return true;
+    };
+    size_t argc = args.size();
+    if (owner.empty() && method == "toString" && argc == 1) {
+        if (auto n = num(0)) result = Value{rt::toString(*n)};
+        else if (auto b = std::get_if<bool>(&args[0].data)) result = Value{rt::toString(*b)};
+        else if (auto s = str(0)) result = Value{*s};
+        else return false;
+        return true;
+    }
+    if (owner == "Math") {
+        if (argc == 1 && num(0)) {
+            double x = *num(0);
+            if (method == "sqrt" && x >= 0) result = Value{rt::Math::sqrt(x)};
+            else if (method == "abs") result = Value{rt::Math::abs(x)};
+            else if (method == "floor") result = Value{rt::Math::floor(x)};
+            else if (method == "ceil") result = Value{rt::Math::ceil(x)};
+            else if (method == "round") result = Value{rt::Math::round(x)};
+            else return false;
+            return true;
+        }
+        if (argc == 2 && num(0) && num(1)) {
+            double a = *num(0), b = *num(1);
+            if (method == "pow") result = Value{rt::Math::pow(a, b)};
+            else if (method == "max") result = Value{rt::Math::max(a, b)};
+            else if (method == "min") result = Value{rt::Math::min(a, b)};
+            else return false;
+            return std::isfinite(std::get<double>(result.data));
+        }
+        return false;
+    }
+    if (owner != "String" || argc == 0 || !str(0)) return false;
+    const std::string& text = *str(0);
+    int a = 0, b = 0;
+    if (argc == 1) {
+        if (method == "length") result = Value{static_cast<double>(rt::String::length(text))};
+        else if (method == "toUpperCase") result = Value{rt::String::toUpperCase(text)};
+        else if (method == "toLowerCase") result = Value{rt::String::toLowerCase(text)};
+        else if (method == "trim") result = Value{rt::String::trim(text)};
+        else return false;
+    } else if (argc == 2 && str(1)) {
+        const std::string& other = *str(1);
+        if (method == "indexOf") result = Value{static_cast<double>(rt::String::indexOf(text, other))};
+        else if (method == "startsWith") result = Value{rt::String::startsWith(text, other)};
+        else if (method == "endsWith") result = Value{rt::String::endsWith(text, other)};
+        else return false;
+    } else if (argc == 2 && asInt(1, a)) {
+        if (method == "repeat") {
+            if (a > 0 && text.size() * static_cast<size_t>(a) > maxResultSize) return false;
+            result = Value{rt::String::repeat(text, a)};
+        } else if ((method == "padStart" || method == "padEnd") && a <= static_cast<int>(maxResultSize)) {
+            result = Value{method == "padStart" ? rt::String::padStart(text, a) : rt::String::padEnd(text, a)};
+        } else {
+            return false;
+        }
+    } else if (argc == 3 && str(1) && str(2) && method == "replace") {
+        result = Value{rt::String::replace(text, *str(1), *str(2))};
+    } else if (argc == 3 && method == "substring" && asInt(1, a) && asInt(2, b)) {
+        result = Value{rt::String::substring(text, a, b)};
+    } else if (argc == 3 && (method == "padStart" || method == "padEnd") && asInt(1, a) && str(2) &&
+               !str(2)->empty() && a <= static_cast<int>(maxResultSize)) {
+        result = Value{method == "padStart" ? rt::String::padStart(text, a, *str(2))
+                                            : rt::String::padEnd(text, a, *str(2))};
+    } else {
+        return false;
+    }
+    auto resultText = std::get_if<std::string>(&result.data);
+    return !resultText || resultText->size() <= maxResultSize;
+}
+
+ConstEvaluator::Value ConstEvaluator::evalBinary(const std::string& op, const Value& left, const Value& right) {
+    auto ln = std::get_if<double>(&left.data);
+    auto rn = std::get_if<double>(&right.data);
+    if (ln && rn) {
+        double a = *ln, b = *rn;
+        if (op == "+") return Value{a + b};
+        if (op == "-") return Value{a - b};
+        if (op == "*") return Value{a * b};
+        if (op == "/") return Value{a / b};
+        if (op == "%") return Value{std::fmod(a, b)};
+        if (op == "<") return Value{a < b};
+        if (op == "<=") return Value{a <= b};
+        if (op == ">") return Value{a > b};
+        if (op == ">=") return Value{a >= b};
+        if (op == "==") return Value{a == b};
+        if (op == "!=") return Value{a != b};
+        if (std::fabs(a) < 9.2e18 && std::fabs(b) < 9.2e18) {
+            long long x = static_cast<long long>(a), y = static_cast<long long>(b);
+            if (op == "&") return Value{static_cast<double>(x & y)};
+            if (op == "|") return Value{static_cast<double>(x | y)};
+            if (op == "^") return Value{static_cast<double>(x ^ y)};
+            if ((op == "<<" || op == ">>") && x >= 0 && y >= 0 && y < 63) {
+                return Value{static_cast<double>(op == "<<" ? x << y : x >> y)};
+            }
+        }
+        throw EvalError();
+    }
+    auto ls = std::get_if<std::string>(&left.data);
+    auto rs = std::get_if<std::string>(&right.data);
+    if (ls && rs) {
+        if (op == "+") {
+            if (ls->size() + rs->size() > maxResultSize) throw EvalError();
+            return Value{*ls + *rs};
+        }
+        if (op == "==") return Value{*ls == *rs};
+        if (op == "!=") return Value{*ls != *rs};
+        if (op == "<") return Value{*ls < *rs};
+        if (op == "<=") return Value{*ls <= *rs};
+        if (op == ">") return Value{*ls > *rs};
+        if (op == ">=") return Value{*ls >= *rs};
+        throw EvalError();
+    }
+    auto lb = std::get_if<bool>(&left.data);
+    auto rb = std::get_if<bool>(&right.data);
+    if (lb && rb) {
+        if (op == "==") return Value{*lb == *rb};
+        if (op == "!=") return Value{*lb != *rb};
+    }
+    throw EvalError();
+}
+
+void ConstEvaluator::assign(const Expression* target, const Value& value, Frame& frame) {
+    if (auto id = dynamic_cast<const Identifier*>(target)) {
+        Value* slot = lookup(id->name, frame);
+        if (!slot) throw EvalError();
+        // Assignment keeps the C++ type of the variable.
+        if (slot->data.index() != value.data.index()) throw EvalError();
+        *slot = value;
+        return;
+    }
+    if (auto access = dynamic_cast<const ArrayAccess*>(target)) {
+        auto id = dynamic_cast<const Identifier*>(access->array.get());
+        Value* slot = id ? lookup(id->name, frame) : nullptr;
+        auto arr = slot ? std::get_if<Array>(&slot->data) : nullptr;
+        Value index = eval(access->index.get(), frame);
+        auto idx = std::get_if<double>(&index.data);
+        if (!arr || !idx || *idx < 0 || *idx >= static_cast<double>(arr->size())) throw EvalError();
+        (*arr)[static_cast<size_t>(*idx)] = value;
+        return;
+    }
+    throw EvalError();
+}
+
+ConstEvaluator::Value ConstEvaluator::convert(const Value& value, Type type) {
+    switch (type) {
+        case Type::NUMBER:
+            if (auto b = std::get_if<bool>(&value.data)) return Value{*b ? 1.0 : 0.0};
+            if (!std::holds_alternative<double>(value.data)) throw EvalError();
+            return value;
+        case Type::BOOLEAN:
+            if (auto n = std::get_if<double>(&value.data)) return Value{*n != 0};
+            if (!std::holds_alternative<bool>(value.data)) throw EvalError();
+            return value;
+        case Type::STRING:
+            if (!std::holds_alternative<std::string>(value.data)) throw EvalError();
+            return value;
+        case Type::ARRAY:
+            if (!std::holds_alternative<Array>(value.data)) throw EvalError();
+            return value;
+        default:
+            return value;
+    }
+}
+
+bool ConstEvaluator::truthy(const Value& value) {
+    if (auto b = std::get_if<bool>(&value.data)) return *b;
+    if (auto n = std::get_if<double>(&value.data)) return *n != 0;
+    throw EvalError();
+}
+
+std::string ConstEvaluator::memoKey(const std::string& name, const std::vector<Value>& args) {
+    std::ostringstream key;
+    key.precision(17);
+    key << name;
+    std::function<void(const Value&)> append = [&](const Value& value) {
+        key << '\x1f' << value.data.index() << ':';
+        if (auto n = std::get_if<double>(&value.data)) key << *n;
+        else if (auto s = std::get_if<std::string>(&value.data)) key << s->size() << ':' << *s;
+        else if (auto b = std::get_if<bool>(&value.data)) key << *b;
+        else if (auto arr = std::get_if<Array>(&value.data)) {
+            key << arr->size();
+            for (const auto& element : *arr) append(element);
+        }
+    };
+    for (const auto& arg : args) append(arg);
+    return key.str();
+}
+
+std::unique_ptr<Expression> ConstEvaluator::toLiteral(const Value& value) {
+    if (auto n = std::get_if<double>(&value.data)) {
+        if (!std::isfinite(*n)) return nullptr;
+        return std::make_unique<NumberLiteral>(*n);
+    }
+    if (auto s = std::get_if<std::string>(&value.data)) return std::make_unique<StringLiteral>(*s);
+    if (auto b = std::get_if<bool>(&value.data)) return std::make_unique<BooleanLiteral>(*b);
+    auto arr = std::get_if<Array>(&value.data);
+    if (!arr || arr->size() > maxResultSize) return nullptr;
+    auto result = std::make_unique<ArrayExpression>();
+    for (const auto& element : *arr) {
+        // Only flat arrays of one scalar type have a literal spelling.
+        if (!result->elements.empty() && element.data.index() != (*arr)[0].data.index()) return nullptr;
+        auto literal = toLiteral(element);
+        if (!literal || std::holds_alternative<Array>(element.data)) return nullptr;
+        result->elements.push_back(std::move(literal));
+    }
+    if (!result->elements.empty()) result->elementType = result->elements[0]->type;
+    return result;
+}
+
+ConstEvaluator::Value ConstEvaluator::fromLiteral(const Expression* expr) {
+    if (auto num = dynamic_cast<const NumberLiteral*>(expr)) return Value{num->value};
+    if (auto str = dynamic_cast<const StringLiteral*>(expr)) return Value{str->value};
+    if (auto boolean = dynamic_cast<const BooleanLiteral*>(expr)) return Value{boolean->value};
+    throw EvalError();
+}
+}
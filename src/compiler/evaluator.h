@@ -0,0 +1,71 @@
+#pragma once
+#include "ast.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <variant>
+#include <functional>
+namespace umbrella {
+// Compile-time interpreter for pure user functions. A function is pure when
+// it only reads its parameters, its own locals and top-level constants,
+// performs no I/O and calls nothing but other pure functions and pure
+// Math/String helpers. Calls to such functions with literal arguments are
+// evaluated in the front end and replaced by their result.
+class ConstEvaluator {
+public:
+    struct Value;
+    using Array = std::vector<Value>;
+    struct Value {
+        std::variant<double, std::string, bool, Array> data;
+    };
+
+    // Resolves a top-level constant to its literal value, or nullptr.
+    using ConstantLookup = std::function<const Expression*(const std::string&)>;
+
+    ConstEvaluator();
+    void analyze(Program& program, ConstantLookup lookup);
+    bool isPure(const std::string& name) const;
+    // Returns a literal (or array literal) for name(args), or nullptr when the
+    // call cannot be evaluated within the step and size budgets.
+    std::unique_ptr<Expression> tryEvaluate(const std::string& name,
+                                            const std::vector<std::unique_ptr<Expression>>& args);
+    // Folds a pure runtime helper (toString, Math.*, String.*) on literal
+    // arguments; owner is empty for free functions.
+    static std::unique_ptr<Expression> foldBuiltin(const std::string& owner, const std::string& method,
+                                                   const std::vector<const Expression*>& args);
+private:
+    struct Frame {
+        std::vector<std::map<std::string, Value>> scopes;
+    };
+    struct EvalError {};
+    struct ReturnSignal { Value value; };
+
+    std::map<std::string, FunctionDeclaration*> functions;
+    std::set<std::string> topLevelConstants;
+    std::set<std::string> pure;
+    std::map<std::string, Value> memo;
+    ConstantLookup constantLookup;
+    long long steps;
+    int depth;
+
+    Value call(const FunctionDeclaration* func, std::vector<Value> args);
+    void execBlock(const std::vector<std::unique_ptr<Statement>>& block, Frame& frame);
+    void exec(const Statement* stmt, Frame& frame);
+    Value eval(const Expression* expr, Frame& frame);
+    Value evalCall(const CallExpression* expr, Frame& frame);
+    Value evalBinary(const std::string& op, const Value& left, const Value& right);
+    void assign(const Expression* target, const Value& value, Frame& frame);
+    Value* lookup(const std::string& name, Frame& frame);
+    void tick();
+
+    static bool callBuiltin(const std::string& owner, const std::string& method,
+                            const std::vector<Value>& args, Value& result);
+    static Value convert(const Value& value, Type type);
+    static bool truthy(const Value& value);
+    static std::string memoKey(const std::string& name, const std::vector<Value>& args);
+    static std::unique_ptr<Expression> toLiteral(const Value& value);
+    static Value fromLiteral(const Expression* expr);
+};
+}
@@ -34,7 +34,7 @@ std::map<std::string, TokenType> Lexer::keywords = {
     {"Array", TokenType::TYPE_ARRAY}
 };
 Lexer::Lexer(const std::string& src)
-    : source(src), position(0), line(1), column(1) {}
+    : source(src), position(0), line(1), column(1), tokenLine(1), tokenColumn(1) {}
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
     while (!isAtEnd()) {
@@ -50,6 +50,8 @@ std::vector<Token> Lexer::tokenize() {
 }
 Token Lexer::nextToken() {
     skipWhitespace();
+    tokenLine = line;
+    tokenColumn = column;
     if (isAtEnd()) {
         return makeToken(TokenType::END_OF_FILE, "");
     }
@@ -205,6 +207,7 @@ Token Lexer::nextToken() {
         case ',': return makeToken(TokenType::COMMA, ",");
         case '.': return makeToken(TokenType::DOT, ".");
         case ':': return makeToken(TokenType::COLON, ":");
+        case '@': return makeToken(TokenType::AT, "@");
         default:
             return makeToken(TokenType::INVALID, std::string(1, c));
     }
@@ -239,7 +242,7 @@ void Lexer::skipComment() {
     }
 }
 Token Lexer::makeToken(TokenType type, const std::string& value) {
-    return Token(type, value, line, column);
+    return Token(type, value, tokenLine, tokenColumn);
 }
 Token Lexer::readNumber() {
     std::string num;
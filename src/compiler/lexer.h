@@ -81,6 +81,7 @@ enum class TokenType {
     COMMA,
     DOT,
     COLON,
+    AT,
     ARROW,
     END_OF_FILE,
     INVALID
@@ -103,6 +104,9 @@ private:
     size_t position;
     int line;
     int column;
+    // Position of the first character of the token being read.
+    int tokenLine;
+    int tokenColumn;
     char current();
     char peek(int offset = 1);
     void advance();
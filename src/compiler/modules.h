@@ -0,0 +1,41 @@
+#pragma once
+#include <string_view>
+namespace umbrella {
+// One part of the runtime (src/runtime). The core is included and linked
+// into every program; the others only when the generated code uses one of
+// the classes they provide.
+struct RuntimeModule {
+    const char* name;
+    const char* header;    // relative to src/
+    const char* source;    // relative to src/, nullptr for header-only modules
+    const char* libraries; // extra linker flags
+    const char* classes;   // space-separated runtime names that need the module
+};
+// In include order.
+inline constexpr RuntimeModule RUNTIME_MODULES[] = {
+    {"core", "runtime/runtime.h", "runtime/runtime.cpp", "", "Math Console"},
+    {"string", "runtime/strings.h", "runtime/strings.cpp", "", "String StringBuilder"},
+    {"collections", "runtime/collections.h", nullptr, "", "Map MemoTable SharedMemoTable"},
+    {"objects", "runtime/objects.h", "runtime/objects.cpp", "", "RefCounted"},
+    {"regex", "runtime/regex.h", "runtime/regex.cpp", "", "Regex"},
+    {"json", "runtime/json.h", "runtime/json.cpp", "", "JSON"},
+    {"file", "runtime/file.h", "runtime/file.cpp", "", "File"},
+    {"http", "runtime/http.h", "runtime/http.cpp", "", "HTTP HTTPResponse"},
+    {"db", "runtime/database.h", "runtime/database.cpp", "-lsqlite3", "Database Row"},
+    {"threading", "runtime/threading.h", "runtime/threading.cpp", "", "Thread Mutex"},
+    {"process", "runtime/process.h", "runtime/process.cpp", "", "Process Env"},
+    {"timer", "runtime/timer.h", "runtime/timer.cpp", "", "Timer Date"},
+};
+// The module providing a runtime class, or nullptr if no module does.
+inline const RuntimeModule* moduleForClass(std::string_view name) {
+    for (const auto& module : RUNTIME_MODULES) {
+        std::string_view classes = module.classes;
+        while (!classes.empty()) {
+            size_t space = classes.find(' ');
+            if (classes.substr(0, space) == name) return &module;
+            classes = space == std::string_view::npos ? std::string_view() : classes.substr(space + 1);
+        }
+    }
+    return nullptr;
+}
+}
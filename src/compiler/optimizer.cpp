@@ -0,0 +1,1269 @@
+#include "optimizer.h"
+#include "analysis.h"
+#include "../runtime/runtime.h"
+#include <cmath>
+namespace umbrella {
+namespace {
+class IdentifierCollector : public ASTVisitor {
+public:
+    std::multiset<std::string>& names;
+    IdentifierCollector(std::multiset<std::string>& n) : names(n) {}
+    bool visitExpression(const Expression* expr) override {
+        if (auto id = dynamic_cast<const Identifier*>(expr)) {
+            names.insert(id->name);
+        }
+        return true;
+    }
+};
+bool fitsLongLong(double value) {
+    return std::isfinite(value) && std::fabs(value) < 9.2e18;
+}
+const NumberLiteral* asNumber(const Expression* expr) {
+    return dynamic_cast<const NumberLiteral*>(expr);
+}
+const StringLiteral* asString(const Expression* expr) {
+    return dynamic_cast<const StringLiteral*>(expr);
+}
+const BooleanLiteral* asBoolean(const Expression* expr) {
+    return dynamic_cast<const BooleanLiteral*>(expr);
+}
+std::unique_ptr<Expression> number(double value) {
+    // Never fold into NaN/Inf: they have no literal spelling in the output.
+    if (!std::isfinite(value)) return nullptr;
+    return std::make_unique<NumberLiteral>(value);
+}
+// Finds writes to or redeclarations of the loop variable and the container,
+// including inside lambdas (a callback run by forEach can write the index),
+// and collects a[i] accesses outside of nested lambdas.
+class LoopBodyScanner : public ASTVisitor {
+public:
+    const std::string& index;
+    const std::string& container;
+    bool safe = true;
+    size_t lambdaDepth = 0;
+    std::vector<ArrayAccess*> accesses;
+    LoopBodyScanner(const std::string& i, const std::string& a) : index(i), container(a) {}
+    bool visitStatement(const Statement* stmt) override {
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+            if (decl->name == index || decl->name == container) safe = false;
+        } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+            for (const auto& name : {forOf->name, forOf->valueName}) {
+                if (name == index || name == container) safe = false;
+            }
+        }
+        return safe;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (auto lambda = dynamic_cast<const FunctionExpression*>(expr)) {
+            for (const auto& param : lambda->parameters) {
+                if (param.name == index || param.name == container) safe = false;
+            }
+            lambdaDepth++;
+        } else if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            auto id = dynamic_cast<const Identifier*>(assign->left.get());
+            if (id && id->name == index) safe = false;
+        } else if (auto access = dynamic_cast<const ArrayAccess*>(expr)) {
+            auto arr = dynamic_cast<const Identifier*>(access->array.get());
+            auto idx = dynamic_cast<const Identifier*>(access->index.get());
+            if (lambdaDepth == 0 && arr && idx && arr->name == container && idx->name == index) {
+                accesses.push_back(const_cast<ArrayAccess*>(access));
+            }
+        }
+        return safe;
+    }
+    void leaveExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) lambdaDepth--;
+    }
+};
+// Free functions and static classes whose calls never run user code.
+const std::set<std::string> builtinFunctions = {"print", "println", "toString"};
+const std::set<std::string> staticClasses = {
+    "Math", "String", "Date", "JSON", "File", "Console", "HTTP", "Regex", "Env", "Process", "Database"
+};
+// Static helpers without side effects that cannot throw, safe to evaluate
+// once before a loop even where the loop evaluates them conditionally.
+const std::set<std::string> invariantMath = {"sqrt", "abs", "floor", "ceil", "round", "pow", "max", "min"};
+const std::set<std::string> invariantString = {
+    "length", "toUpperCase", "toLowerCase", "substring", "indexOf", "replace", "split", "trim",
+    "startsWith", "endsWith"
+};
+// Names declared anywhere in a loop, and whether it calls code (user
+// functions, methods, constructors, callbacks) that could modify anything.
+class LoopEffects : public ASTVisitor {
+public:
+    std::set<std::string>& declared;
+    bool& callsOut;
+    const std::set<std::string>& userMethods;
+    const ConstEvaluator& evaluator;
+    LoopEffects(std::set<std::string>& d, bool& c, const std::set<std::string>& methods, const ConstEvaluator& e)
+        : declared(d), callsOut(c), userMethods(methods), evaluator(e) {}
+    bool visitStatement(const Statement* stmt) override {
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+            declared.insert(decl->name);
+        } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+            declared.insert(forOf->name);
+            declared.insert(forOf->valueName);
+        } else if (auto tryStmt = dynamic_cast<const TryStatement*>(stmt)) {
+            declared.insert(tryStmt->catchVar);
+        }
+        return true;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (auto lambda = dynamic_cast<const FunctionExpression*>(expr)) {
+            for (const auto& param : lambda->parameters) declared.insert(param.name);
+        } else if (dynamic_cast<const NewExpression*>(expr)) {
+            callsOut = true;
+        } else if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) {
+                if (!builtinFunctions.count(id->name) && !evaluator.isPure(id->name)) callsOut = true;
+            } else if (auto member = dynamic_cast<const MemberExpression*>(call->callee.get())) {
+                auto owner = dynamic_cast<const Identifier*>(member->object.get());
+                if (owner && staticClasses.count(owner->name)) return true;
+                if (userMethods.count(member->property) ||
+                    (owner && (owner->name == "Thread" || owner->name == "Timer"))) {
+                    callsOut = true;
+                } else if (isSynchronousHelper(member->property)) {
+                    // Inline callbacks are scanned with the loop; others are unknown code.
+                    for (const auto& arg : call->arguments) {
+                        if (!dynamic_cast<const FunctionExpression*>(arg.get())) callsOut = true;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+// Parameters, locals used inside lambdas and element references: names
+// through which code outside the current function may see or change data.
+class SharedNameCollector : public ASTVisitor {
+public:
+    std::set<std::string>& shared;
+    size_t lambdaDepth = 0;
+    SharedNameCollector(std::set<std::string>& s) : shared(s) {}
+    bool visitStatement(const Statement* stmt) override {
+        auto decl = dynamic_cast<const VariableDeclaration*>(stmt);
+        if (decl && dynamic_cast<const ArrayAccess*>(decl->initializer.get())) shared.insert(decl->name);
+        return true;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) {
+            lambdaDepth++;
+        } else if (auto id = dynamic_cast<const Identifier*>(expr)) {
+            if (lambdaDepth > 0) shared.insert(id->name);
+        }
+        return true;
+    }
+    void leaveExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) lambdaDepth--;
+    }
+};
+// Whether a callback has no effect besides its result, so that its calls
+// may be interleaved with those of other pipeline stages.
+class EffectFreeChecker : public ASTVisitor {
+public:
+    const std::set<std::string>& userMethods;
+    const ConstEvaluator& evaluator;
+    std::set<std::string> locals;
+    bool effectFree = true;
+    EffectFreeChecker(const std::set<std::string>& methods, const ConstEvaluator& e)
+        : userMethods(methods), evaluator(e) {}
+    bool visitStatement(const Statement* stmt) override {
+        if (auto decl = dynamic_cast<const VariableDeclaration*>(stmt)) {
+            locals.insert(decl->name);
+        } else if (auto forOf = dynamic_cast<const ForOfStatement*>(stmt)) {
+            locals.insert(forOf->name);
+            locals.insert(forOf->valueName);
+        } else if (dynamic_cast<const ThrowStatement*>(stmt) || dynamic_cast<const TryStatement*>(stmt)) {
+            effectFree = false;
+        }
+        return effectFree;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (auto lambda = dynamic_cast<const FunctionExpression*>(expr)) {
+            for (const auto& param : lambda->parameters) locals.insert(param.name);
+        } else if (dynamic_cast<const NewExpression*>(expr)) {
+            effectFree = false;
+        } else if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            auto target = dynamic_cast<const Identifier*>(assign->left.get());
+            if (!target || !locals.count(target->name)) effectFree = false;
+        } else if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            if (auto id = dynamic_cast<const Identifier*>(call->callee.get())) {
+                if (id->name != "toString" && !evaluator.isPure(id->name)) effectFree = false;
+            } else if (auto member = dynamic_cast<const MemberExpression*>(call->callee.get())) {
+                auto owner = dynamic_cast<const Identifier*>(member->object.get());
+                bool helper = owner && ((owner->name == "Math" && member->property != "random") ||
+                                        owner->name == "String");
+                bool readOnly = isReadOnlyMethod(member->property) && !userMethods.count(member->property);
+                if (!helper && !readOnly) effectFree = false;
+                if (isSynchronousHelper(member->property)) {
+                    for (const auto& arg : call->arguments) {
+                        if (!dynamic_cast<const FunctionExpression*>(arg.get())) effectFree = false;
+                    }
+                }
+            }
+        }
+        return effectFree;
+    }
+};
+const CallExpression* methodCall(const Expression* expr, const std::string& method) {
+    auto call = dynamic_cast<const CallExpression*>(expr);
+    auto member = call ? dynamic_cast<const MemberExpression*>(call->callee.get()) : nullptr;
+    return member && member->property == method ? call : nullptr;
+}
+std::unique_ptr<Expression> makeMethodCall(std::unique_ptr<Expression> object, const std::string& method) {
+    return std::make_unique<CallExpression>(std::make_unique<MemberExpression>(std::move(object), method));
+}
+// `xs.lazy()` optionally followed by map/filter stages.
+bool isLazyChain(const Expression* expr) {
+    while (auto call = dynamic_cast<const CallExpression*>(expr)) {
+        auto member = dynamic_cast<const MemberExpression*>(call->callee.get());
+        if (!member) return false;
+        if (member->property == "lazy") return true;
+        if (member->property != "map" && member->property != "filter") return false;
+        expr = member->object.get();
+    }
+    return false;
+}
+bool isIdentifier(const Expression* expr, const std::string& name) {
+    auto id = dynamic_cast<const Identifier*>(expr);
+    return id && id->name == name;
+}
+bool isNumber(const Expression* expr, double value) {
+    auto num = dynamic_cast<const NumberLiteral*>(expr);
+    return num && num->value == value;
+}
+bool declaresNames(const std::vector<std::unique_ptr<Statement>>& block) {
+    for (const auto& stmt : block) {
+        if (dynamic_cast<const VariableDeclaration*>(stmt.get()) ||
+            dynamic_cast<const FunctionDeclaration*>(stmt.get()) ||
+            dynamic_cast<const ClassDeclaration*>(stmt.get())) {
+            return true;
+        }
+    }
+    return false;
+}
+// Counts calls of a function and its `return` statements outside nested
+// lambdas, and notes whether a lambda refers to one of its parameters.
+class RecursionScanner : public ASTVisitor {
+public:
+    const FunctionDeclaration& func;
+    int calls = 0;
+    int returns = 0;
+    bool valueReturns = false;
+    bool capturesParameter = false;
+    explicit RecursionScanner(const FunctionDeclaration& f) : func(f) {}
+    bool visitStatement(const Statement* stmt) override {
+        if (auto ret = dynamic_cast<const ReturnStatement*>(stmt); ret && lambdaDepth == 0) {
+            returns++;
+            if (ret->value) valueReturns = true;
+        }
+        return true;
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) lambdaDepth++;
+        if (auto call = dynamic_cast<const CallExpression*>(expr)) {
+            if (isIdentifier(call->callee.get(), func.name)) calls++;
+        }
+        if (auto id = dynamic_cast<const Identifier*>(expr); id && lambdaDepth > 0) {
+            for (const auto& param : func.parameters) {
+                if (param.name == id->name) capturesParameter = true;
+            }
+        }
+        return true;
+    }
+    void leaveExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) lambdaDepth--;
+    }
+private:
+    int lambdaDepth = 0;
+};
+int countCalls(const Expression* expr, const FunctionDeclaration& func) {
+    if (!expr) return 0;
+    RecursionScanner scan(func);
+    walk(expr, scan);
+    return scan.calls;
+}
+// `f(...)` with one argument per parameter of f.
+CallExpression* asSelfCall(Expression* expr, const FunctionDeclaration& func) {
+    auto call = dynamic_cast<CallExpression*>(expr);
+    if (!call || !isIdentifier(call->callee.get(), func.name)) return nullptr;
+    return call->arguments.size() == func.parameters.size() ? call : nullptr;
+}
+// Collects the returns in tail position: reached only through if/else
+// branches and blocks, not loops, try blocks or lambdas. A recursive
+// `return c ? a : b` is split into an if/else first, and in a function
+// without a result a self call that ends it becomes `return f(...)`.
+void collectTailReturns(std::vector<std::unique_ptr<Statement>>& block, const FunctionDeclaration& func,
+                        bool endsFunction, std::vector<std::unique_ptr<Statement>*>& returns) {
+    for (auto& stmt : block) {
+        bool last = endsFunction && &stmt == &block.back();
+        auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt.get());
+        if (last && exprStmt && func.returnType == Type::VOID && asSelfCall(exprStmt->expression.get(), func)) {
+            stmt = std::make_unique<ReturnStatement>(std::move(exprStmt->expression));
+        }
+        if (auto ret = dynamic_cast<ReturnStatement*>(stmt.get())) {
+            auto cond = dynamic_cast<ConditionalExpression*>(ret->value.get());
+            if (!cond || countCalls(cond->condition.get(), func) > 0 ||
+                (countCalls(cond->thenExpr.get(), func) == 0 && countCalls(cond->elseExpr.get(), func) == 0)) {
+                returns.push_back(&stmt);
+                continue;
+            }
+            auto split = std::make_unique<IfStatement>(std::move(cond->condition));
+            split->thenBranch.push_back(std::make_unique<ReturnStatement>(std::move(cond->thenExpr)));
+            split->elseBranch.push_back(std::make_unique<ReturnStatement>(std::move(cond->elseExpr)));
+            stmt = std::move(split);
+        }
+        if (auto ifStmt = dynamic_cast<IfStatement*>(stmt.get())) {
+            collectTailReturns(ifStmt->thenBranch, func, last, returns);
+            collectTailReturns(ifStmt->elseBranch, func, last, returns);
+        } else if (auto blockStmt = dynamic_cast<BlockStatement*>(stmt.get())) {
+            collectTailReturns(blockStmt->statements, func, last, returns);
+        }
+    }
+}
+// Whether control can reach the end of the block.
+bool fallsThrough(const std::vector<std::unique_ptr<Statement>>& block) {
+    if (block.empty()) return true;
+    const Statement* last = block.back().get();
+    if (dynamic_cast<const ReturnStatement*>(last) || dynamic_cast<const ThrowStatement*>(last)) return false;
+    if (auto ifStmt = dynamic_cast<const IfStatement*>(last)) {
+        return ifStmt->elseBranch.empty() || fallsThrough(ifStmt->thenBranch) || fallsThrough(ifStmt->elseBranch);
+    }
+    if (auto blockStmt = dynamic_cast<const BlockStatement*>(last)) return fallsThrough(blockStmt->statements);
+    return true;
+}
+}
+
+bool isLiteral(const Expression* expr) {
+    return asNumber(expr) || asString(expr) || asBoolean(expr);
+}
+std::unique_ptr<Expression> cloneLiteral(const Expression* expr) {
+    if (auto num = asNumber(expr)) return std::make_unique<NumberLiteral>(num->value);
+    if (auto str = asString(expr)) return std::make_unique<StringLiteral>(str->value);
+    if (auto boolean = asBoolean(expr)) return std::make_unique<BooleanLiteral>(boolean->value);
+    return nullptr;
+}
+void collectIdentifiers(const Statement* stmt, std::multiset<std::string>& names) {
+    IdentifierCollector collector(names);
+    walk(stmt, collector);
+}
+void collectIdentifiers(const Expression* expr, std::multiset<std::string>& names) {
+    IdentifierCollector collector(names);
+    walk(expr, collector);
+}
+
+Optimizer::Optimizer() {}
+
+void Optimizer::optimize(Program& program) {
+    scopes.clear();
+    userMethods.clear();
+    userFields.clear();
+    hoistedCount = 0;
+    tailCount = 0;
+    reportLines.clear();
+    for (const auto& stmt : program.statements) {
+        if (auto classDecl = dynamic_cast<const ClassDeclaration*>(stmt.get())) {
+            for (const auto& method : classDecl->methods) userMethods.insert(method.name);
+            for (const auto& member : classDecl->members) userFields.insert(member.name);
+        }
+    }
+    pushScope();
+    evaluator.analyze(program, [this](const std::string& name) {
+        // Only literal top-level constants are visible to pure functions.
+        auto found = scopes.front().find(name);
+        return found != scopes.front().end() ? found->second.get() : nullptr;
+    });
+    // Top-level constants are visible to every function regardless of order.
+    for (auto& stmt : program.statements) {
+        auto decl = dynamic_cast<VariableDeclaration*>(stmt.get());
+        if (decl && decl->isConst && decl->initializer) {
+            optimizeExpression(decl->initializer);
+            declare(decl->name, isLiteral(decl->initializer.get()) ? decl->initializer.get() : nullptr);
+        }
+    }
+    optimizeBlock(program.statements, false);
+    popScope();
+    removeUnusedFunctions(program);
+    // Last, so constant evaluation above still sees the recursive form.
+    for (auto& stmt : program.statements) {
+        if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) eliminateTailCalls(*func);
+    }
+}
+
+void Optimizer::pushScope() {
+    scopes.emplace_back();
+}
+void Optimizer::popScope() {
+    scopes.pop_back();
+}
+void Optimizer::declare(const std::string& name, const Expression* literal) {
+    scopes.back()[name] = literal ? cloneLiteral(literal) : nullptr;
+}
+const Expression* Optimizer::lookupConstant(const std::string& name) const {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) return found->second.get();
+    }
+    return nullptr;
+}
+
+void Optimizer::optimizeBlock(std::vector<std::unique_ptr<Statement>>& block, bool newScope) {
+    if (newScope) pushScope();
+    std::vector<std::unique_ptr<Statement>> result;
+    for (auto& stmt : block) {
+        if (!stmt) continue;
+        if (!optimizeStatement(stmt)) continue;
+        // A constant `if` is replaced by the statements of the taken branch.
+        if (auto ifStmt = dynamic_cast<IfStatement*>(stmt.get())) {
+            if (auto cond = asBoolean(ifStmt->condition.get())) {
+                auto& taken = cond->value ? ifStmt->thenBranch : ifStmt->elseBranch;
+                if (declaresNames(taken)) {
+                    auto blockStmt = std::make_unique<BlockStatement>();
+                    blockStmt->statements = std::move(taken);
+                    result.push_back(std::move(blockStmt));
+                    continue;
+                }
+                if (taken.empty()) continue;
+                for (auto& s : taken) result.push_back(std::move(s));
+                stmt = nullptr;
+                if (dynamic_cast<const ReturnStatement*>(result.back().get()) ||
+                    dynamic_cast<const ThrowStatement*>(result.back().get())) {
+                    break;
+                }
+                continue;
+            }
+        }
+        bool terminates = dynamic_cast<const ReturnStatement*>(stmt.get()) ||
+                          dynamic_cast<const ThrowStatement*>(stmt.get());
+        result.push_back(std::move(stmt));
+        // Anything after return/throw in the same block is unreachable.
+        if (terminates) break;
+    }
+    block = std::move(result);
+    removeUnusedConstants(block);
+    if (newScope) popScope();
+}
+
+void Optimizer::optimizeFunctionBody(const std::vector<FunctionParameter>& params,
+                                     std::vector<std::unique_ptr<Statement>>& body) {
+    // Lambdas share the context of the named function around them, whose
+    // scan already covers their bodies.
+    bool outermost = functions.empty();
+    if (outermost) {
+        FunctionContext context{scopes.size(), collectResizedNames(body), {}};
+        for (const auto& param : params) context.shared.insert(param.name);
+        SharedNameCollector collector(context.shared);
+        walk(body, collector);
+        functions.push_back(std::move(context));
+    }
+    pushScope();
+    for (const auto& param : params) {
+        declare(param.name);
+    }
+    optimizeBlock(body, false);
+    popScope();
+    if (outermost) functions.pop_back();
+}
+
+bool Optimizer::optimizeStatement(std::unique_ptr<Statement>& stmt) {
+    if (auto varDecl = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+        if (varDecl->initializer) optimizeExpression(varDecl->initializer);
+        bool propagate = varDecl->isConst && varDecl->initializer && isLiteral(varDecl->initializer.get());
+        declare(varDecl->name, propagate ? varDecl->initializer.get() : nullptr);
+        return true;
+    }
+    if (auto funcDecl = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+        optimizeFunctionBody(funcDecl->parameters, funcDecl->body);
+        return true;
+    }
+    if (auto classDecl = dynamic_cast<ClassDeclaration*>(stmt.get())) {
+        for (auto& member : classDecl->members) {
+            if (member.initializer) optimizeExpression(member.initializer);
+        }
+        if (classDecl->constructor) {
+            optimizeFunctionBody(classDecl->constructor->parameters, classDecl->constructor->body);
+        }
+        for (auto& method : classDecl->methods) {
+            optimizeFunctionBody(method.parameters, method.body);
+        }
+        return true;
+    }
+    if (auto retStmt = dynamic_cast<ReturnStatement*>(stmt.get())) {
+        if (retStmt->value) optimizeExpression(retStmt->value);
+        return true;
+    }
+    if (auto throwStmt = dynamic_cast<ThrowStatement*>(stmt.get())) {
+        optimizeExpression(throwStmt->expression);
+        return true;
+    }
+    if (auto ifStmt = dynamic_cast<IfStatement*>(stmt.get())) {
+        optimizeExpression(ifStmt->condition);
+        if (auto num = asNumber(ifStmt->condition.get())) {
+            ifStmt->condition = std::make_unique<BooleanLiteral>(num->value != 0);
+        }
+        optimizeBlock(ifStmt->thenBranch);
+        optimizeBlock(ifStmt->elseBranch);
+        return true;
+    }
+    if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt.get())) {
+        optimizeExpression(whileStmt->condition);
+        if (auto cond = asBoolean(whileStmt->condition.get())) {
+            if (!cond->value) return false;
+        }
+        optimizeBlock(whileStmt->body);
+        hoistLoopInvariants(stmt);
+        return true;
+    }
+    if (auto forStmt = dynamic_cast<ForStatement*>(stmt.get())) {
+        pushScope();
+        if (forStmt->initializer) optimizeStatement(forStmt->initializer);
+        if (forStmt->condition) optimizeExpression(forStmt->condition);
+        if (forStmt->increment) optimizeExpression(forStmt->increment);
+        optimizeBlock(forStmt->body);
+        popScope();
+        eliminateBoundsChecks(forStmt);
+        auto cond = forStmt->condition ? asBoolean(forStmt->condition.get()) : nullptr;
+        if (cond && !cond->value) {
+            // The loop never runs; only an expression initializer could have effects.
+            return forStmt->initializer &&
+                   dynamic_cast<const ExpressionStatement*>(forStmt->initializer.get());
+        }
+        hoistLoopInvariants(stmt);
+        return true;
+    }
+    if (auto forOf = dynamic_cast<ForOfStatement*>(stmt.get())) {
+        optimizeExpression(forOf->iterable);
+        pushScope();
+        declare(forOf->name);
+        if (!forOf->valueName.empty()) declare(forOf->valueName);
+        optimizeBlock(forOf->body, false);
+        popScope();
+        hoistLoopInvariants(stmt);
+        return true;
+    }
+    if (auto blockStmt = dynamic_cast<BlockStatement*>(stmt.get())) {
+        optimizeBlock(blockStmt->statements);
+        return !blockStmt->statements.empty();
+    }
+    if (auto tryStmt = dynamic_cast<TryStatement*>(stmt.get())) {
+        optimizeBlock(tryStmt->tryBlock);
+        pushScope();
+        if (!tryStmt->catchVar.empty()) declare(tryStmt->catchVar);
+        optimizeBlock(tryStmt->catchBlock, false);
+        popScope();
+        optimizeBlock(tryStmt->finallyBlock);
+        return true;
+    }
+    if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt.get())) {
+        optimizeExpression(exprStmt->expression);
+        // A bare literal statement has no effect.
+        return !isLiteral(exprStmt->expression.get());
+    }
+    return true;
+}
+
+void Optimizer::optimizeExpression(std::unique_ptr<Expression>& expr) {
+    if (!expr) return;
+    std::unique_ptr<Expression> folded;
+    if (auto id = dynamic_cast<Identifier*>(expr.get())) {
+        if (auto constant = lookupConstant(id->name)) {
+            folded = cloneLiteral(constant);
+        }
+    } else if (auto unExpr = dynamic_cast<UnaryExpression*>(expr.get())) {
+        optimizeExpression(unExpr->operand);
+        folded = foldUnary(unExpr);
+    } else if (auto binExpr = dynamic_cast<BinaryExpression*>(expr.get())) {
+        optimizeExpression(binExpr->left);
+        optimizeExpression(binExpr->right);
+        folded = foldBinary(binExpr);
+    } else if (auto assignExpr = dynamic_cast<AssignmentExpression*>(expr.get())) {
+        // The target is never replaced by a constant, only its sub-expressions.
+        if (auto access = dynamic_cast<ArrayAccess*>(assignExpr->left.get())) {
+            optimizeExpression(access->index);
+        }
+        optimizeExpression(assignExpr->right);
+    } else if (auto callExpr = dynamic_cast<CallExpression*>(expr.get())) {
+        if (auto member = dynamic_cast<MemberExpression*>(callExpr->callee.get())) {
+            optimizeExpression(member->object);
+        }
+        for (auto& arg : callExpr->arguments) optimizeExpression(arg);
+        folded = foldCall(callExpr);
+    } else if (auto arrExpr = dynamic_cast<ArrayExpression*>(expr.get())) {
+        for (auto& element : arrExpr->elements) optimizeExpression(element);
+    } else if (auto mapLit = dynamic_cast<MapLiteral*>(expr.get())) {
+        for (auto& value : mapLit->values) optimizeExpression(value);
+    } else if (auto accessExpr = dynamic_cast<ArrayAccess*>(expr.get())) {
+        optimizeExpression(accessExpr->array);
+        optimizeExpression(accessExpr->index);
+    } else if (auto memExpr = dynamic_cast<MemberExpression*>(expr.get())) {
+        optimizeExpression(memExpr->object);
+        folded = foldMember(memExpr);
+    } else if (auto newExpr = dynamic_cast<NewExpression*>(expr.get())) {
+        for (auto& arg : newExpr->arguments) optimizeExpression(arg);
+    } else if (auto condExpr = dynamic_cast<ConditionalExpression*>(expr.get())) {
+        optimizeExpression(condExpr->condition);
+        optimizeExpression(condExpr->thenExpr);
+        optimizeExpression(condExpr->elseExpr);
+        if (auto cond = asBoolean(condExpr->condition.get())) {
+            folded = std::move(cond->value ? condExpr->thenExpr : condExpr->elseExpr);
+        }
+    } else if (auto funcExpr = dynamic_cast<FunctionExpression*>(expr.get())) {
+        optimizeFunctionBody(funcExpr->parameters, funcExpr->body);
+    }
+    if (folded) {
+        expr = std::move(folded);
+    }
+    if (dynamic_cast<CallExpression*>(expr.get())) fusePipeline(expr);
+}
+
+bool Optimizer::isPipelineStage(const Expression* expr) const {
+    auto call = dynamic_cast<const CallExpression*>(expr);
+    auto member = call ? dynamic_cast<const MemberExpression*>(call->callee.get()) : nullptr;
+    if (!member || (member->property != "map" && member->property != "filter")) return false;
+    if (userMethods.count(member->property) || call->arguments.size() != 1) return false;
+    auto callback = dynamic_cast<const FunctionExpression*>(call->arguments[0].get());
+    if (!callback) return false;
+    EffectFreeChecker checker(userMethods, evaluator);
+    walk(callback, checker);
+    return checker.effectFree;
+}
+
+void Optimizer::fusePipeline(std::unique_ptr<Expression>& expr) {
+    auto call = static_cast<CallExpression*>(expr.get());
+    auto member = dynamic_cast<MemberExpression*>(call->callee.get());
+    if (!member || userMethods.count(member->property)) return;
+    bool stage = member->property == "map" || member->property == "filter";
+    bool terminal = member->property == "reduce" || member->property == "forEach" ||
+                    member->property == "some" || member->property == "every";
+    if ((!stage && !terminal) || (stage && !isPipelineStage(call))) return;
+    if (isLazyChain(member->object.get())) return;
+
+    if (auto toArray = methodCall(member->object.get(), "toArray")) {
+        // Continue a pipeline fused further in: drop its materialization.
+        auto inner = static_cast<MemberExpression*>(toArray->callee.get());
+        if (!toArray->arguments.empty() || !isLazyChain(inner->object.get())) return;
+        member->object = std::move(inner->object);
+    } else {
+        // Start the pipeline below the eager map/filter stages this call sits on.
+        std::unique_ptr<Expression>* base = &member->object;
+        int stages = 0;
+        while (isPipelineStage(base->get())) {
+            stages++;
+            base = &static_cast<MemberExpression*>(static_cast<CallExpression*>(base->get())->callee.get())->object;
+        }
+        if (stages == 0 || isLazyChain(base->get())) return;
+        *base = makeMethodCall(std::move(*base), "lazy");
+    }
+    if (stage) expr = makeMethodCall(std::move(expr), "toArray");
+}
+
+std::unique_ptr<Expression> Optimizer::foldUnary(const UnaryExpression* expr) {
+    const Expression* operand = expr->operand.get();
+    if (auto num = asNumber(operand)) {
+        if (expr->op == "-") return number(-num->value);
+        if (expr->op == "!") return std::make_unique<BooleanLiteral>(num->value == 0);
+        if (expr->op == "~" && fitsLongLong(num->value)) {
+            return number(static_cast<double>(~static_cast<long long>(num->value)));
+        }
+    }
+    if (auto boolean = asBoolean(operand)) {
+        if (expr->op == "!") return std::make_unique<BooleanLiteral>(!boolean->value);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<Expression> Optimizer::foldBinary(const BinaryExpression* expr) {
+    const std::string& op = expr->op;
+    const Expression* left = expr->left.get();
+    const Expression* right = expr->right.get();
+    // Short-circuit on a constant left operand; the right side is never evaluated.
+    if (auto lhs = asBoolean(left)) {
+        if (op == "&&" && !lhs->value) return std::make_unique<BooleanLiteral>(false);
+        if (op == "||" && lhs->value) return std::make_unique<BooleanLiteral>(true);
+    }
+    auto ln = asNumber(left);
+    auto rn = asNumber(right);
+    if (ln && rn) {
+        double a = ln->value, b = rn->value;
+        if (op == "+") return number(a + b);
+        if (op == "-") return number(a - b);
+        if (op == "*") return number(a * b);
+        if (op == "/") return b != 0 ? number(a / b) : nullptr;
+        if (op == "%") return b != 0 ? number(std::fmod(a, b)) : nullptr;
+        if (op == "<") return std::make_unique<BooleanLiteral>(a < b);
+        if (op == "<=") return std::make_unique<BooleanLiteral>(a <= b);
+        if (op == ">") return std::make_unique<BooleanLiteral>(a > b);
+        if (op == ">=") return std::make_unique<BooleanLiteral>(a >= b);
+        if (op == "==") return std::make_unique<BooleanLiteral>(a == b);
+        if (op == "!=") return std::make_unique<BooleanLiteral>(a != b);
+        if (op == "&&") return std::make_unique<BooleanLiteral>(a != 0 && b != 0);
+        if (op == "||") return std::make_unique<BooleanLiteral>(a != 0 || b != 0);
+        if (fitsLongLong(a) && fitsLongLong(b)) {
+            long long x = static_cast<long long>(a), y = static_cast<long long>(b);
+            if (op == "&") return number(static_cast<double>(x & y));
+            if (op == "|") return number(static_cast<double>(x | y));
+            if (op == "^") return number(static_cast<double>(x ^ y));
+            if ((op == "<<" || op == ">>") && x >= 0 && y >= 0 && y < 63) {
+                return number(static_cast<double>(op == "<<" ? x << y : x >> y));
+            }
+        }
+        return nullptr;
+    }
+    auto ls = asString(left);
+    auto rs = asString(right);
+    if (ls && rs) {
+        if (op == "+") return std::make_unique<StringLiteral>(ls->value + rs->value);
+        if (op == "==") return std::make_unique<BooleanLiteral>(ls->value == rs->value);
+        if (op == "!=") return std::make_unique<BooleanLiteral>(ls->value != rs->value);
+        if (op == "<") return std::make_unique<BooleanLiteral>(ls->value < rs->value);
+        if (op == "<=") return std::make_unique<BooleanLiteral>(ls->value <= rs->value);
+        if (op == ">") return std::make_unique<BooleanLiteral>(ls->value > rs->value);
+        if (op == ">=") return std::make_unique<BooleanLiteral>(ls->value >= rs->value);
+        return nullptr;
+    }
+    auto lb = asBoolean(left);
+    auto rb = asBoolean(right);
+    if (lb && rb) {
+        if (op == "&&") return std::make_unique<BooleanLiteral>(lb->value && rb->value);
+        if (op == "||") return std::make_unique<BooleanLiteral>(lb->value || rb->value);
+        if (op == "==") return std::make_unique<BooleanLiteral>(lb->value == rb->value);
+        if (op == "!=") return std::make_unique<BooleanLiteral>(lb->value != rb->value);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<Expression> Optimizer::foldCall(const CallExpression* expr) {
+    const auto& args = expr->arguments;
+    for (const auto& arg : args) {
+        if (!isLiteral(arg.get())) return nullptr;
+    }
+    std::vector<const Expression*> callArgs;
+    if (auto id = dynamic_cast<const Identifier*>(expr->callee.get())) {
+        if (id->name == "toString" && args.size() == 1) {
+            return ConstEvaluator::foldBuiltin("", "toString", {args[0].get()});
+        }
+        // Calls to pure user functions are run by the compile-time evaluator.
+        for (size_t i = 1; i < scopes.size(); i++) {
+            if (scopes[i].count(id->name)) return nullptr;
+        }
+        return evaluator.tryEvaluate(id->name, args);
+    }
+    auto member = dynamic_cast<const MemberExpression*>(expr->callee.get());
+    if (!member) return nullptr;
+
+    // Instance form on a literal receiver, e.g. "ab".repeat(3), is rewritten to
+    // the static String helper with the receiver as the first argument.
+    std::string owner;
+    if (auto objId = dynamic_cast<const Identifier*>(member->object.get())) {
+        owner = objId->name;
+    } else if (asString(member->object.get())) {
+        owner = "String";
+        callArgs.push_back(member->object.get());
+    } else {
+        return nullptr;
+    }
+    if (owner != "Math" && owner != "String") return nullptr;
+    for (const auto& arg : args) callArgs.push_back(arg.get());
+    return ConstEvaluator::foldBuiltin(owner, member->property, callArgs);
+}
+
+std::unique_ptr<Expression> Optimizer::foldMember(const MemberExpression* expr) {
+    if (auto id = dynamic_cast<const Identifier*>(expr->object.get())) {
+        if (id->name == "Math") {
+            if (expr->property == "PI") return number(umbrella::runtime::Math::PI);
+            if (expr->property == "E") return number(umbrella::runtime::Math::E);
+        }
+    }
+    if (auto str = asString(expr->object.get())) {
+        if (expr->property == "length") return number(static_cast<double>(str->value.size()));
+    }
+    return nullptr;
+}
+
+void Optimizer::eliminateBoundsChecks(ForStatement* loop) {
+    if (functions.empty()) return;
+    // for (let i = <non-negative integer>; i < a.length; i = i + 1 | i += 1)
+    auto init = dynamic_cast<const VariableDeclaration*>(loop->initializer.get());
+    auto start = init ? asNumber(init->initializer.get()) : nullptr;
+    if (!start || start->value < 0 || start->value != std::floor(start->value)) return;
+    const std::string& index = init->name;
+    auto cond = dynamic_cast<const BinaryExpression*>(loop->condition.get());
+    if (!cond || cond->op != "<" || !isIdentifier(cond->left.get(), index)) return;
+    auto length = dynamic_cast<const MemberExpression*>(cond->right.get());
+    auto container = length ? dynamic_cast<const Identifier*>(length->object.get()) : nullptr;
+    if (!container || length->property != "length") return;
+    auto step = dynamic_cast<const AssignmentExpression*>(loop->increment.get());
+    if (!step || !isIdentifier(step->left.get(), index)) return;
+    auto sum = dynamic_cast<const BinaryExpression*>(step->right.get());
+    bool unitStep = (step->op == "+=" && isNumber(step->right.get(), 1)) ||
+                    (step->op == "=" && sum && sum->op == "+" &&
+                     ((isIdentifier(sum->left.get(), index) && isNumber(sum->right.get(), 1)) ||
+                      (isNumber(sum->left.get(), 1) && isIdentifier(sum->right.get(), index))));
+    if (!unitStep) return;
+
+    // The container must be a local of this function (no other function can
+    // resize it) and must never be resized anywhere in the function.
+    const FunctionContext& context = functions.back();
+    if (context.resized.count(container->name)) return;
+    bool local = false;
+    for (size_t i = scopes.size(); i-- > context.scopeBase;) {
+        if (scopes[i].count(container->name)) {
+            local = true;
+            break;
+        }
+    }
+    if (!local) return;
+    // Parameters and other shared names may alias data that code the loop
+    // calls can shrink.
+    if (context.shared.count(container->name)) {
+        std::set<std::string> declared;
+        bool callsOut = false;
+        LoopEffects effects(declared, callsOut, userMethods, evaluator);
+        walk(loop, effects);
+        if (callsOut) return;
+    }
+
+    LoopBodyScanner scanner(index, container->name);
+    walk(loop->body, scanner);
+    if (!scanner.safe) return;
+    for (ArrayAccess* access : scanner.accesses) {
+        access->unchecked = true;
+    }
+}
+
+void Optimizer::hoistLoopInvariants(std::unique_ptr<Statement>& stmt) {
+    LoopInvariants loop;
+    loop.resized = collectResizedNames(stmt.get());
+    LoopEffects effects(loop.declared, loop.callsOut, userMethods, evaluator);
+    walk(stmt.get(), effects);
+    if (auto forStmt = dynamic_cast<ForStatement*>(stmt.get())) {
+        if (forStmt->condition) hoistFrom(forStmt->condition, loop);
+        loop.guarded = true;
+        hoistFrom(forStmt->body, loop);
+        if (forStmt->increment) hoistFrom(forStmt->increment, loop);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt.get())) {
+        hoistFrom(whileStmt->condition, loop);
+        loop.guarded = true;
+        hoistFrom(whileStmt->body, loop);
+    } else if (auto forOf = dynamic_cast<ForOfStatement*>(stmt.get())) {
+        loop.guarded = true;
+        hoistFrom(forOf->body, loop);
+    }
+    if (loop.hoisted.empty()) return;
+    auto block = std::make_unique<BlockStatement>();
+    block->statements = std::move(loop.hoisted);
+    block->statements.push_back(std::move(stmt));
+    stmt = std::move(block);
+}
+
+bool Optimizer::isInvariant(const Expression* expr, const LoopInvariants& loop) const {
+    if (isLiteral(expr)) return true;
+    if (auto id = dynamic_cast<const Identifier*>(expr)) {
+        if (loop.declared.count(id->name) || loop.resized.count(id->name)) return false;
+        if (!loop.callsOut) return true;
+        // Opaque calls can only miss locals of this function that nothing else can reach.
+        if (functions.empty() || functions.back().shared.count(id->name)) return false;
+        for (size_t i = scopes.size(); i-- > 0;) {
+            if (scopes[i].count(id->name)) return i >= functions.back().scopeBase;
+        }
+        return false;
+    }
+    if (auto member = dynamic_cast<const MemberExpression*>(expr)) {
+        auto owner = dynamic_cast<const Identifier*>(member->object.get());
+        if (owner && staticClasses.count(owner->name)) return false;
+        if (!owner && !dynamic_cast<const MemberExpression*>(member->object.get())) return false;
+        // Anything but `this.x` or an array/string length may load through a
+        // null handle; hoisted from under a guard it would run anyway.
+        bool load = member->property != "length" || userFields.count("length");
+        if (loop.guarded && load && !(owner && owner->name == "this")) return false;
+        return isInvariant(member->object.get(), loop);
+    }
+    return dynamic_cast<const CallExpression*>(expr) && isHoistable(expr, loop);
+}
+
+bool Optimizer::isHoistable(const Expression* expr, const LoopInvariants& loop) const {
+    if (auto member = dynamic_cast<const MemberExpression*>(expr)) {
+        // `xs.length`, or a chain of at least two member loads.
+        if (member->property != "length" && !dynamic_cast<const MemberExpression*>(member->object.get())) {
+            return false;
+        }
+        return isInvariant(member, loop);
+    }
+    auto call = dynamic_cast<const CallExpression*>(expr);
+    auto callee = call ? dynamic_cast<const MemberExpression*>(call->callee.get()) : nullptr;
+    auto owner = callee ? dynamic_cast<const Identifier*>(callee->object.get()) : nullptr;
+    if (!owner || loop.declared.count(owner->name)) return false;
+    for (const auto& scope : scopes) {
+        if (scope.count(owner->name)) return false;
+    }
+    bool known = (owner->name == "Math" && invariantMath.count(callee->property) &&
+                  ((callee->property != "max" && callee->property != "min") || call->arguments.size() == 2)) ||
+                 (owner->name == "String" && invariantString.count(callee->property));
+    if (!known || call->arguments.empty()) return false;
+    for (const auto& arg : call->arguments) {
+        if (!isInvariant(arg.get(), loop)) return false;
+    }
+    return true;
+}
+
+void Optimizer::hoistFrom(std::unique_ptr<Expression>& expr, LoopInvariants& loop) {
+    if (!expr) return;
+    if (isHoistable(expr.get(), loop)) {
+        std::string key = expr->toString();
+        auto found = loop.names.find(key);
+        if (found == loop.names.end()) {
+            std::string name = "_inv" + std::to_string(hoistedCount++);
+            auto member = dynamic_cast<const MemberExpression*>(expr.get());
+            auto call = dynamic_cast<const CallExpression*>(expr.get());
+            auto callee = call ? dynamic_cast<const MemberExpression*>(call->callee.get()) : nullptr;
+            bool chain = member && member->property != "length";
+            bool number = (member && !chain) || (callee && callee->object->toString() == "Math");
+            auto decl = std::make_unique<VariableDeclaration>(name, number ? Type::NUMBER : Type::ANY,
+                                                              std::move(expr), true);
+            // Member chains are aliased rather than copied.
+            decl->isReference = chain;
+            loop.hoisted.push_back(std::move(decl));
+            found = loop.names.emplace(key, name).first;
+        }
+        expr = std::make_unique<Identifier>(found->second);
+        return;
+    }
+    if (auto binExpr = dynamic_cast<BinaryExpression*>(expr.get())) {
+        hoistFrom(binExpr->left, loop);
+        bool guarded = loop.guarded;
+        if (binExpr->op == "&&" || binExpr->op == "||") loop.guarded = true;
+        hoistFrom(binExpr->right, loop);
+        loop.guarded = guarded;
+    } else if (auto unExpr = dynamic_cast<UnaryExpression*>(expr.get())) {
+        hoistFrom(unExpr->operand, loop);
+    } else if (auto assign = dynamic_cast<AssignmentExpression*>(expr.get())) {
+        hoistFromIndices(assign->left, loop);
+        hoistFrom(assign->right, loop);
+    } else if (auto call = dynamic_cast<CallExpression*>(expr.get())) {
+        // Receivers stay as written: the method may need a mutable object.
+        if (auto member = dynamic_cast<MemberExpression*>(call->callee.get())) {
+            hoistFromIndices(member->object, loop);
+        }
+        for (auto& arg : call->arguments) hoistFrom(arg, loop);
+    } else if (auto arrExpr = dynamic_cast<ArrayExpression*>(expr.get())) {
+        for (auto& element : arrExpr->elements) hoistFrom(element, loop);
+    } else if (auto mapLit = dynamic_cast<MapLiteral*>(expr.get())) {
+        for (auto& value : mapLit->values) hoistFrom(value, loop);
+    } else if (auto access = dynamic_cast<ArrayAccess*>(expr.get())) {
+        hoistFrom(access->array, loop);
+        hoistFrom(access->index, loop);
+    } else if (auto member = dynamic_cast<MemberExpression*>(expr.get())) {
+        hoistFrom(member->object, loop);
+    } else if (auto newExpr = dynamic_cast<NewExpression*>(expr.get())) {
+        for (auto& arg : newExpr->arguments) hoistFrom(arg, loop);
+    } else if (auto condExpr = dynamic_cast<ConditionalExpression*>(expr.get())) {
+        hoistFrom(condExpr->condition, loop);
+        bool guarded = loop.guarded;
+        loop.guarded = true;
+        hoistFrom(condExpr->thenExpr, loop);
+        hoistFrom(condExpr->elseExpr, loop);
+        loop.guarded = guarded;
+    }
+    // Lambda bodies may run after the loop, when the values have changed.
+}
+
+void Optimizer::hoistFromIndices(std::unique_ptr<Expression>& target, LoopInvariants& loop) {
+    Expression* expr = target.get();
+    while (true) {
+        if (auto access = dynamic_cast<ArrayAccess*>(expr)) {
+            hoistFrom(access->index, loop);
+            expr = access->array.get();
+        } else if (auto member = dynamic_cast<MemberExpression*>(expr)) {
+            expr = member->object.get();
+        } else {
+            return;
+        }
+    }
+}
+
+void Optimizer::hoistFrom(std::vector<std::unique_ptr<Statement>>& block, LoopInvariants& loop) {
+    for (auto& stmt : block) hoistFrom(stmt, loop);
+}
+
+void Optimizer::hoistFrom(std::unique_ptr<Statement>& stmt, LoopInvariants& loop) {
+    if (auto decl = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+        if (decl->initializer) hoistFrom(decl->initializer, loop);
+    } else if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt.get())) {
+        hoistFrom(exprStmt->expression, loop);
+    } else if (auto retStmt = dynamic_cast<ReturnStatement*>(stmt.get())) {
+        hoistFrom(retStmt->value, loop);
+    } else if (auto throwStmt = dynamic_cast<ThrowStatement*>(stmt.get())) {
+        hoistFrom(throwStmt->expression, loop);
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt.get())) {
+        hoistFrom(ifStmt->condition, loop);
+        hoistFrom(ifStmt->thenBranch, loop);
+        hoistFrom(ifStmt->elseBranch, loop);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt.get())) {
+        hoistFrom(whileStmt->condition, loop);
+        hoistFrom(whileStmt->body, loop);
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt.get())) {
+        if (forStmt->initializer) hoistFrom(forStmt->initializer, loop);
+        hoistFrom(forStmt->condition, loop);
+        hoistFrom(forStmt->increment, loop);
+        hoistFrom(forStmt->body, loop);
+    } else if (auto forOf = dynamic_cast<ForOfStatement*>(stmt.get())) {
+        hoistFrom(forOf->iterable, loop);
+        hoistFrom(forOf->body, loop);
+    } else if (auto blockStmt = dynamic_cast<BlockStatement*>(stmt.get())) {
+        hoistFrom(blockStmt->statements, loop);
+    } else if (auto tryStmt = dynamic_cast<TryStatement*>(stmt.get())) {
+        hoistFrom(tryStmt->tryBlock, loop);
+        hoistFrom(tryStmt->catchBlock, loop);
+        hoistFrom(tryStmt->finallyBlock, loop);
+    }
+}
+
+void Optimizer::eliminateTailCalls(FunctionDeclaration& func) {
+    // Recursive calls of a @memo function must go through its cache.
+    if (func.name == "main" || func.memo) return;
+    // Only rewrites recursive returns, so it is harmless if nothing else happens.
+    std::vector<std::unique_ptr<Statement>*> tails;
+    collectTailReturns(func.body, func, true, tails);
+    RecursionScanner scan(func);
+    walk(func.body, scan);
+    if (scan.calls == 0) return;
+    if (scan.capturesParameter) {
+        reportLines.push_back(func.name + ": recursion kept (a lambda captures a parameter)");
+        return;
+    }
+    // Each tail return is a self call, `e op self(...)` or has no recursion.
+    int direct = 0, accumulated = 0;
+    bool uniform = true, callOnLeft = false, callOnRight = false, plainValues = true;
+    std::string op;
+    for (auto slot : tails) {
+        auto value = static_cast<ReturnStatement*>(slot->get())->value.get();
+        if (asSelfCall(value, func)) {
+            direct++;
+        } else if (countCalls(value, func) == 0) {
+            if (!value) plainValues = false;
+        } else if (auto bin = dynamic_cast<BinaryExpression*>(value);
+                   bin && (bin->op == "+" || bin->op == "*") && (op.empty() || op == bin->op)) {
+            bool left = asSelfCall(bin->left.get(), func) && countCalls(bin->right.get(), func) == 0;
+            bool right = asSelfCall(bin->right.get(), func) && countCalls(bin->left.get(), func) == 0;
+            if (!left && !right) uniform = false;
+            op = bin->op;
+            callOnLeft |= left;
+            callOnRight |= right;
+            accumulated++;
+        } else {
+            uniform = false;
+        }
+    }
+    // The accumulator applies the pending operations to every result, so all
+    // recursion and all returns must go through the tail returns. String
+    // concatenation keeps its order as long as the recursive call is always
+    // on the same side. Floating-point + and * are not associative, so number
+    // operands are kept on a stack and folded innermost first at the base case.
+    bool typed = func.returnType == Type::NUMBER ||
+                 (func.returnType == Type::STRING && op == "+" && !(callOnLeft && callOnRight));
+    bool accumulate = accumulated > 0 && uniform && typed && plainValues &&
+                      scan.calls == direct + accumulated && scan.returns == static_cast<int>(tails.size());
+    if (direct == 0 && !accumulate) {
+        reportLines.push_back(func.name + ": recursion kept (" + std::to_string(scan.calls) +
+                              " call(s) not in tail position)");
+        return;
+    }
+    bool appendReturn = fallsThrough(func.body);
+    if (appendReturn && (func.returnType != Type::VOID && (func.returnType != Type::ANY || scan.valueReturns))) {
+        reportLines.push_back(func.name + ": recursion kept (the body can end without returning)");
+        return;
+    }
+    std::string acc;
+    bool suffix = func.returnType == Type::STRING && callOnLeft;
+    bool stacked = func.returnType == Type::NUMBER;
+    auto combine = [&](std::unique_ptr<Expression> value) -> std::unique_ptr<Expression> {
+        auto current = std::make_unique<Identifier>(acc);
+        if (suffix) return std::make_unique<BinaryExpression>(op, std::move(value), std::move(current));
+        return std::make_unique<BinaryExpression>(op, std::move(current), std::move(value));
+    };
+    if (accumulate) acc = "_acc" + std::to_string(tailCount++);
+    for (auto slot : tails) {
+        auto ret = static_cast<ReturnStatement*>(slot->get());
+        CallExpression* call = asSelfCall(ret->value.get(), func);
+        std::unique_ptr<Expression> pending;
+        if (!call && accumulate && countCalls(ret->value.get(), func) > 0) {
+            auto bin = static_cast<BinaryExpression*>(ret->value.get());
+            call = asSelfCall(bin->left.get(), func);
+            pending = std::move(call ? bin->right : bin->left);
+            if (!call) call = asSelfCall(bin->right.get(), func);
+        }
+        if (!call) {
+            if (accumulate && stacked) {
+                *slot = foldPending(acc, op, std::move(ret->value));
+            } else if (accumulate) {
+                ret->value = combine(std::move(ret->value));
+            }
+            continue;
+        }
+        auto jump = std::make_unique<BlockStatement>();
+        if (pending && stacked) {
+            auto push = std::make_unique<CallExpression>(
+                std::make_unique<MemberExpression>(std::make_unique<Identifier>(acc), "push"));
+            push->arguments.push_back(std::move(pending));
+            jump->statements.push_back(std::make_unique<ExpressionStatement>(std::move(push)));
+        } else if (pending) {
+            jump->statements.push_back(std::make_unique<ExpressionStatement>(std::make_unique<AssignmentExpression>(
+                std::make_unique<Identifier>(acc), "=", combine(std::move(pending)))));
+        }
+        // Arguments read the old parameter values, so parameters that other
+        // arguments refer to are assigned through temporaries.
+        std::set<size_t> changed;
+        std::multiset<std::string> referenced;
+        for (size_t i = 0; i < call->arguments.size(); i++) {
+            if (isIdentifier(call->arguments[i].get(), func.parameters[i].name)) continue;
+            changed.insert(i);
+        }
+        for (size_t i : changed) {
+            std::multiset<std::string> names;
+            collectIdentifiers(call->arguments[i].get(), names);
+            for (size_t j : changed) {
+                if (j != i && names.count(func.parameters[j].name)) referenced.insert(func.parameters[j].name);
+            }
+        }
+        std::vector<std::pair<std::string, std::string>> writeBack;
+        std::vector<std::unique_ptr<Statement>> direct;
+        for (size_t i : changed) {
+            const FunctionParameter& param = func.parameters[i];
+            auto assign = [&](std::unique_ptr<Expression> value) {
+                return std::make_unique<ExpressionStatement>(std::make_unique<AssignmentExpression>(
+                    std::make_unique<Identifier>(param.name), "=", std::move(value)));
+            };
+            if (referenced.count(param.name)) {
+                std::string temp = "_tc" + std::to_string(tailCount++);
+                jump->statements.push_back(
+                    std::make_unique<VariableDeclaration>(temp, param.type, std::move(call->arguments[i])));
+                writeBack.emplace_back(param.name, temp);
+            } else {
+                direct.push_back(assign(std::move(call->arguments[i])));
+            }
+        }
+        for (auto& stmt : direct) jump->statements.push_back(std::move(stmt));
+        for (const auto& [name, temp] : writeBack) {
+            jump->statements.push_back(std::make_unique<ExpressionStatement>(std::make_unique<AssignmentExpression>(
+                std::make_unique<Identifier>(name), "=", std::make_unique<Identifier>(temp))));
+        }
+        jump->statements.push_back(std::make_unique<ContinueStatement>());
+        *slot = std::move(jump);
+    }
+    auto loop = std::make_unique<WhileStatement>(std::make_unique<BooleanLiteral>(true));
+    loop->body = std::move(func.body);
+    if (appendReturn) loop->body.push_back(std::make_unique<ReturnStatement>());
+    func.body.clear();
+    if (accumulate && stacked) {
+        auto empty = std::make_unique<ArrayExpression>();
+        empty->elementType = Type::NUMBER;
+        func.body.push_back(std::make_unique<VariableDeclaration>(acc, Type::ARRAY, std::move(empty), false,
+                                                                  "Array<double>"));
+        reportLines.push_back(func.name + ": recursion through '" + op + "' turned into a loop with a stack of operands");
+    } else if (accumulate) {
+        std::unique_ptr<Expression> identity;
+        if (func.returnType == Type::STRING) {
+            identity = std::make_unique<StringLiteral>("");
+        } else {
+            identity = std::make_unique<NumberLiteral>(op == "*" ? 1 : 0);
+        }
+        func.body.push_back(std::make_unique<VariableDeclaration>(acc, func.returnType, std::move(identity)));
+        reportLines.push_back(func.name + ": recursion through '" + op + "' turned into a loop with an accumulator");
+    } else {
+        reportLines.push_back(func.name + ": " + std::to_string(direct) + " self tail call(s) turned into a loop" +
+                              (scan.calls > direct ? " (" + std::to_string(scan.calls - direct) + " other call(s) kept)" : ""));
+    }
+    func.body.push_back(std::move(loop));
+}
+
+// `return value` of a stacked accumulation: applies the pending operands,
+// the most recently pushed (innermost call) first.
+std::unique_ptr<Statement> Optimizer::foldPending(const std::string& stack, const std::string& op,
+                                                  std::unique_ptr<Expression> value) {
+    std::string result = "_fold" + std::to_string(tailCount++);
+    auto block = std::make_unique<BlockStatement>();
+    block->statements.push_back(std::make_unique<VariableDeclaration>(result, Type::NUMBER, std::move(value)));
+    auto length = std::make_unique<MemberExpression>(std::make_unique<Identifier>(stack), "length");
+    auto loop = std::make_unique<WhileStatement>(
+        std::make_unique<BinaryExpression>(">", std::move(length), std::make_unique<NumberLiteral>(0)));
+    auto pop = std::make_unique<CallExpression>(
+        std::make_unique<MemberExpression>(std::make_unique<Identifier>(stack), "pop"));
+    loop->body.push_back(std::make_unique<ExpressionStatement>(std::make_unique<AssignmentExpression>(
+        std::make_unique<Identifier>(result), "=",
+        std::make_unique<BinaryExpression>(op, std::move(pop), std::make_unique<Identifier>(result)))));
+    block->statements.push_back(std::move(loop));
+    block->statements.push_back(std::make_unique<ReturnStatement>(std::make_unique<Identifier>(result)));
+    return block;
+}
+
+void Optimizer::removeUnusedConstants(std::vector<std::unique_ptr<Statement>>& block) {
+    std::multiset<std::string> used;
+    bool collected = false;
+    for (auto it = block.begin(); it != block.end();) {
+        auto decl = dynamic_cast<const VariableDeclaration*>(it->get());
+        if (decl && decl->isConst && decl->initializer && isLiteral(decl->initializer.get())) {
+            if (!collected) {
+                for (const auto& stmt : block) collectIdentifiers(stmt.get(), used);
+                collected = true;
+            }
+            if (used.count(decl->name) == 0) {
+                it = block.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+}
+
+void Optimizer::removeUnusedFunctions(Program& program) {
+    std::map<std::string, const FunctionDeclaration*> functions;
+    std::set<std::string> reachable;
+    std::vector<std::string> worklist;
+    auto markAll = [&](const std::multiset<std::string>& names) {
+        for (const auto& name : names) {
+            if (functions.count(name) && reachable.insert(name).second) {
+                worklist.push_back(name);
+            }
+        }
+    };
+    bool hasRoot = false;
+    for (const auto& stmt : program.statements) {
+        if (auto func = dynamic_cast<const FunctionDeclaration*>(stmt.get())) {
+            functions[func->name] = func;
+            if (func->name == "main") hasRoot = true;
+        } else if (!dynamic_cast<const ClassDeclaration*>(stmt.get()) &&
+                   !dynamic_cast<const VariableDeclaration*>(stmt.get())) {
+            hasRoot = true;
+        }
+    }
+    // Without an entry point there is nothing to measure reachability from.
+    if (!hasRoot) return;
+    std::multiset<std::string> rootNames;
+    for (const auto& stmt : program.statements) {
+        if (!dynamic_cast<const FunctionDeclaration*>(stmt.get())) {
+            collectIdentifiers(stmt.get(), rootNames);
+        }
+    }
+    if (functions.count("main")) {
+        reachable.insert("main");
+        worklist.push_back("main");
+    }
+    markAll(rootNames);
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+        std::multiset<std::string> names;
+        collectIdentifiers(functions[name], names);
+        markAll(names);
+    }
+    auto& stmts = program.statements;
+    for (auto it = stmts.begin(); it != stmts.end();) {
+        auto func = dynamic_cast<const FunctionDeclaration*>(it->get());
+        if (func && !reachable.count(func->name)) {
+            it = stmts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "ast.h"
+#include "evaluator.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+namespace umbrella {
+// AST-to-AST optimization pass run between Parser::parse and
+// CodeGenerator::generate. It folds constant expressions (including calls to
+// pure runtime helpers such as Math.pow and String.repeat on literals),
+// propagates `const` bindings whose value is a literal, evaluates calls to
+// pure user functions with literal arguments (see ConstEvaluator), and removes
+// unreachable statements, dead branches and unused top-level functions.
+// Inside loops it drops provably redundant bounds checks and hoists
+// loop-invariant lengths, pure Math/String calls and member chains. Finally,
+// self tail calls and accumulator-style recursion are turned into loops.
+class Optimizer {
+public:
+    Optimizer();
+    void optimize(Program& program);
+    // One line per function whose recursion was (or could not be) turned
+    // into a loop, for --opt-report.
+    const std::vector<std::string>& report() const { return reportLines; }
+private:
+    // A name bound in some scope: either a propagatable literal or a shadowing
+    // declaration (literal == nullptr) that hides outer constants.
+    using Scope = std::map<std::string, std::unique_ptr<Expression>>;
+    std::vector<Scope> scopes;
+    ConstEvaluator evaluator;
+    // Innermost named function being optimized: the first scope index that
+    // belongs to it, the names whose length may change anywhere in it, and
+    // the names other code may reach (parameters, which may alias the
+    // caller's data, locals captured by lambdas, element references).
+    struct FunctionContext {
+        size_t scopeBase;
+        std::set<std::string> resized;
+        std::set<std::string> shared;
+    };
+    std::vector<FunctionContext> functions;
+    std::set<std::string> userMethods;
+    std::set<std::string> userFields;
+    // What a loop may change, and the expressions hoisted out of it so far.
+    struct LoopInvariants {
+        std::set<std::string> resized;
+        std::set<std::string> declared;
+        // Calls code that could modify anything reachable from outside.
+        bool callsOut = false;
+        // Set while walking code that may not run on the loop's first test
+        // (the body, the increment, the right of && / ||, ?: branches).
+        bool guarded = false;
+        std::map<std::string, std::string> names; // expression text -> temporary
+        std::vector<std::unique_ptr<Statement>> hoisted;
+    };
+    int hoistedCount = 0;
+    int tailCount = 0;
+    std::vector<std::string> reportLines;
+
+    void optimizeBlock(std::vector<std::unique_ptr<Statement>>& block, bool newScope = true);
+    // Returns false if the statement should be removed from its block.
+    bool optimizeStatement(std::unique_ptr<Statement>& stmt);
+    void optimizeFunctionBody(const std::vector<FunctionParameter>& params,
+                              std::vector<std::unique_ptr<Statement>>& body);
+    void optimizeExpression(std::unique_ptr<Expression>& expr);
+
+    std::unique_ptr<Expression> foldUnary(const UnaryExpression* expr);
+    std::unique_ptr<Expression> foldBinary(const BinaryExpression* expr);
+    std::unique_ptr<Expression> foldCall(const CallExpression* expr);
+    std::unique_ptr<Expression> foldMember(const MemberExpression* expr);
+
+    void pushScope();
+    void popScope();
+    void declare(const std::string& name, const Expression* literal = nullptr);
+    const Expression* lookupConstant(const std::string& name) const;
+
+    // Marks a[i] in canonical `for (let i = 0; i < a.length; i = i + 1)`
+    // loops as unchecked when neither i nor the length of a can change.
+    void eliminateBoundsChecks(ForStatement* loop);
+
+    // Moves invariant `xs.length`, pure Math.* / String.* calls and member
+    // chains such as `this.config.limit` out of a loop into constants
+    // declared just before it; the loop is wrapped in a block with them.
+    // Loads through an object handle abort on null, so those are only hoisted
+    // from the part of the condition that runs before the first iteration.
+    void hoistLoopInvariants(std::unique_ptr<Statement>& loop);
+    bool isInvariant(const Expression* expr, const LoopInvariants& loop) const;
+    bool isHoistable(const Expression* expr, const LoopInvariants& loop) const;
+    void hoistFrom(std::unique_ptr<Expression>& expr, LoopInvariants& loop);
+    void hoistFromIndices(std::unique_ptr<Expression>& target, LoopInvariants& loop);
+    void hoistFrom(std::vector<std::unique_ptr<Statement>>& block, LoopInvariants& loop);
+    void hoistFrom(std::unique_ptr<Statement>& stmt, LoopInvariants& loop);
+
+    // Rewrites xs.filter(f).map(g).reduce(h, 0) as
+    // xs.lazy().filter(f).map(g).reduce(h, 0) when f and g have no side
+    // effects, so the chain runs in one pass without intermediate arrays.
+    // A fused chain that ends in map or filter is closed with .toArray().
+    void fusePipeline(std::unique_ptr<Expression>& expr);
+    bool isPipelineStage(const Expression* expr) const;
+
+    // Wraps the body of a recursive function in `while (true)` and turns
+    // `return f(args)` into parameter assignments and `continue`. If every
+    // other recursive return is `return e + f(args)` (or `*`), the pending
+    // operands are folded into an accumulator instead (numbers: pushed on a
+    // stack and folded in the original order), so the recursion becomes a
+    // loop entirely.
+    void eliminateTailCalls(FunctionDeclaration& func);
+    std::unique_ptr<Statement> foldPending(const std::string& stack, const std::string& op,
+                                           std::unique_ptr<Expression> value);
+
+    void removeUnusedConstants(std::vector<std::unique_ptr<Statement>>& block);
+    void removeUnusedFunctions(Program& program);
+};
+
+bool isLiteral(const Expression* expr);
+std::unique_ptr<Expression> cloneLiteral(const Expression* expr);
+// Collects the names of all identifiers referenced anywhere below the node.
+void collectIdentifiers(const Statement* stmt, std::multiset<std::string>& names);
+void collectIdentifiers(const Expression* expr, std::multiset<std::string>& names);
+}
@@ -1,7 +1,20 @@
 #include "parser.h"
 #include <stdexcept>
 #include <iostream>
+#include <cmath>
 namespace umbrella {
+namespace {
+// Gives a node the source position of its first token, unless a nested parse
+// already did (e.g. a parenthesized expression).
+template <typename Node>
+std::unique_ptr<Node> positioned(std::unique_ptr<Node> node, const Token& start) {
+    if (node && node->line == 0) {
+        node->line = start.line;
+        node->column = start.column;
+    }
+    return node;
+}
+}
 Parser::Parser(const std::vector<Token>& toks)
     : tokens(toks), current(0) {}
 std::unique_ptr<Program> Parser::parse() {
@@ -69,27 +82,7 @@ std::unique_ptr<Statement> Parser::parseVariableDeclaration() {
     if (match(TokenType::COLON)) {
         size_t startToken = current;
         varType = parseType();
-        size_t endToken = current;
-        // Reconstruct type string from tokens with mapping
-        for (size_t i = startToken; i < endToken; i++) {
-             std::string val = tokens[i].value;
-             if (tokens[i].type == TokenType::TYPE_STRING) val = "std::string";
-             else if (tokens[i].type == TokenType::TYPE_NUMBER) val = "double";
-             else if (tokens[i].type == TokenType::TYPE_BOOLEAN) val = "bool";
-             else if (tokens[i].type == TokenType::TYPE_VOID) val = "void";
-             // else if (tokens[i].type == TokenType::TYPE_ANY) val = "auto";
-             else if (tokens[i].type == TokenType::FUNCTION) val = "auto";
-             else if (tokens[i].value == "function") val = "auto"; // Just in case lexer difference
-             
-             cppType += val;
-        }
-        // Hack: parseType() consumes tokens but tokens[i].value for < and > etc are correct.
-        // Wait, parseType consumes tokens, so 'current' advances.
-        // tokens[startToken] is the first token of type.
-        // BUT tokens are objects.
-        // I need to ensure spacing or just concat?
-        // Array<Thread> -> Array < Thread >
-        // C++ parser will handle spaces fine usually.
+        cppType = typeText(startToken);
     }
     std::unique_ptr<Expression> initializer = nullptr;
     if (match(TokenType::EQUAL)) {
@@ -105,17 +98,14 @@ std::unique_ptr<Statement> Parser::parseFunctionDeclaration() {
     auto func = std::make_unique<FunctionDeclaration>(name.value, Type::ANY);
     if (!check(TokenType::RPAREN)) {
         do {
-            Token paramName = consume(TokenType::IDENTIFIER, "Expected parameter name");
-            Type paramType = Type::ANY;
-            if (match(TokenType::COLON)) {
-                paramType = parseType();
-            }
-            func->parameters.push_back(FunctionParameter(paramName.value, paramType));
+            func->parameters.push_back(parseParameter());
         } while (match(TokenType::COMMA));
     }
     consume(TokenType::RPAREN, "Expected ')' after parameters");
     if (match(TokenType::COLON)) {
+        size_t startToken = current;
         func->returnType = parseType();
+        func->returnCppType = typeText(startToken);
     }
     consume(TokenType::LBRACE, "Expected '{' before function body");
     while (!check(TokenType::RBRACE) && !isAtEnd()) {
@@ -125,6 +115,66 @@ std::unique_ptr<Statement> Parser::parseFunctionDeclaration() {
     return func;
 }
 
+// @memo, @memo(1000), @memo(sync) or @memo(1000, sync) before a function;
+// @soa before a class.
+std::unique_ptr<Statement> Parser::parseAnnotatedDeclaration() {
+    Token annotation = consume(TokenType::IDENTIFIER, "Expected annotation name after '@'");
+    if (annotation.value == "soa") {
+        consume(TokenType::CLASS, "Expected a class declaration after @soa");
+        auto stmt = parseClassDeclaration();
+        auto classDecl = static_cast<ClassDeclaration*>(stmt.get());
+        // Each field becomes a column of plain values.
+        if (!classDecl->superclass.empty()) error("@soa class '" + classDecl->name + "' cannot extend a class");
+        if (classDecl->members.empty()) error("@soa class '" + classDecl->name + "' needs at least one field");
+        for (const auto& member : classDecl->members) {
+            if (member.type != Type::NUMBER && member.type != Type::STRING && member.type != Type::BOOLEAN) {
+                error("@soa field '" + member.name + "' must be a number, string or boolean");
+            }
+        }
+        classDecl->soa = true;
+        return stmt;
+    }
+    if (annotation.value != "memo") error("Unknown annotation '@" + annotation.value + "'");
+    size_t capacity = 0;
+    bool sync = false;
+    if (match(TokenType::LPAREN)) {
+        do {
+            if (check(TokenType::NUMBER)) {
+                double value = std::stod(advance().value);
+                if (value < 1 || value != std::floor(value)) error("@memo capacity must be a positive integer");
+                capacity = static_cast<size_t>(value);
+            } else if (check(TokenType::IDENTIFIER) && peek().value == "sync") {
+                advance();
+                sync = true;
+            } else {
+                error("Expected a capacity or 'sync' in @memo(...)");
+            }
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RPAREN, "Expected ')' after @memo arguments");
+    }
+    consume(TokenType::FUNCTION, "Expected a function declaration after @memo");
+    auto stmt = parseFunctionDeclaration();
+    auto func = static_cast<FunctionDeclaration*>(stmt.get());
+    // Arguments become the cache key, so they must be hashable values.
+    for (const auto& param : func->parameters) {
+        if (param.type != Type::NUMBER && param.type != Type::STRING &&
+            param.type != Type::BOOLEAN && param.type != Type::ANY) {
+            error("@memo parameter '" + param.name + "' must be a number, string or boolean");
+        }
+    }
+    if (func->returnType == Type::VOID) error("@memo function '" + func->name + "' must return a value");
+    // The cache stores the result type, which C++ cannot deduce for a
+    // function that calls itself through the cache.
+    if (func->returnType == Type::ANY || func->returnType == Type::FUNCTION) {
+        error("@memo function '" + func->name + "' needs a declared return type");
+    }
+    if (func->name == "main") error("main cannot be @memo");
+    func->memo = true;
+    func->memoCapacity = capacity;
+    func->memoSync = sync;
+    return stmt;
+}
+
 std::unique_ptr<Statement> Parser::parseClassDeclaration() {
     Token name = consume(TokenType::IDENTIFIER, "Expected class name");
     auto classDecl = std::make_unique<ClassDeclaration>(name.value);
@@ -136,15 +186,15 @@ std::unique_ptr<Statement> Parser::parseClassDeclaration() {
     
     consume(TokenType::LBRACE, "Expected '{' before class body");
     while (!check(TokenType::RBRACE) && !isAtEnd()) {
+        Token start = peek();
         if (match(TokenType::CONSTRUCTOR)) {
             consume(TokenType::LPAREN, "Expected '(' after constructor");
             auto ctor = std::make_unique<ConstructorDeclaration>();
+            ctor->line = start.line;
+            ctor->column = start.column;
             if (!check(TokenType::RPAREN)) {
                 do {
-                    Token paramName = consume(TokenType::IDENTIFIER, "Expected parameter name");
-                    Type paramType = Type::ANY;
-                    if (match(TokenType::COLON)) paramType = parseType();
-                    ctor->parameters.emplace_back(paramName.value, paramType);
+                    ctor->parameters.push_back(parseParameter());
                 } while (match(TokenType::COMMA));
             }
             consume(TokenType::RPAREN, "Expected ')' after parameters");
@@ -158,21 +208,24 @@ std::unique_ptr<Statement> Parser::parseClassDeclaration() {
             Token memberName = consume(TokenType::IDENTIFIER, "Expected member name");
             if (match(TokenType::LPAREN)) { // Method
                 Type retType = Type::VOID;
+                std::string retCppType;
                 std::vector<FunctionParameter> params;
                 if (!check(TokenType::RPAREN)) {
                     do {
-                        Token paramName = consume(TokenType::IDENTIFIER, "Expected parameter name");
-                        Type paramType = Type::ANY;
-                        if (match(TokenType::COLON)) paramType = parseType();
-                        params.emplace_back(paramName.value, paramType);
+                        params.push_back(parseParameter());
                     } while (match(TokenType::COMMA));
                 }
                 consume(TokenType::RPAREN, "Expected ')' after parameters");
                 if (match(TokenType::COLON)) {
+                    size_t startToken = current;
                     retType = parseType();
+                    retCppType = typeText(startToken);
                 }
                 auto method = MethodDeclaration(memberName.value, retType);
                 method.parameters = params;
+                method.returnCppType = retCppType;
+                method.line = start.line;
+                method.column = start.column;
                 consume(TokenType::LBRACE, "Expected '{' before method body");
                 while (!check(TokenType::RBRACE) && !isAtEnd()) {
                     method.body.push_back(parseStatement());
@@ -181,8 +234,11 @@ std::unique_ptr<Statement> Parser::parseClassDeclaration() {
                 classDecl->methods.push_back(std::move(method));
             } else { // Field
                 Type fieldType = Type::ANY;
+                std::string fieldCppType;
                 if (match(TokenType::COLON)) {
+                    size_t startToken = current;
                     fieldType = parseType();
+                    fieldCppType = typeText(startToken);
                 }
                 std::unique_ptr<Expression> init = nullptr;
                 if (match(TokenType::EQUAL)) {
@@ -190,6 +246,7 @@ std::unique_ptr<Statement> Parser::parseClassDeclaration() {
                 }
                 consume(TokenType::SEMICOLON, "Expected ';' after field declaration");
                 classDecl->members.emplace_back(memberName.value, fieldType, std::move(init));
+                classDecl->members.back().cppType = fieldCppType;
             }
         }
     }
@@ -236,6 +293,12 @@ std::unique_ptr<Statement> Parser::parseWhileStatement() {
 }
 std::unique_ptr<Statement> Parser::parseForStatement() {
     consume(TokenType::LPAREN, "Expected '(' after 'for'");
+    // `of` is contextual: `let`/`const` followed by `x of` or `[`.
+    if ((check(TokenType::LET) || check(TokenType::CONST)) &&
+        (peek(1).type == TokenType::LBRACKET ||
+         (peek(1).type == TokenType::IDENTIFIER && peek(2).type == TokenType::IDENTIFIER && peek(2).value == "of"))) {
+        return parseForOfStatement();
+    }
     auto forStmt = std::make_unique<ForStatement>();
     if (match(TokenType::SEMICOLON)) {
         forStmt->initializer = nullptr;
@@ -259,6 +322,95 @@ std::unique_ptr<Statement> Parser::parseForStatement() {
     consume(TokenType::RBRACE, "Expected '}' after for body");
     return forStmt;
 }
+std::unique_ptr<Statement> Parser::parseForOfStatement() {
+    bool isConst = advance().type == TokenType::CONST;
+    std::string name, valueName;
+    if (match(TokenType::LBRACKET)) {
+        name = consume(TokenType::IDENTIFIER, "Expected key name in for-of binding").value;
+        consume(TokenType::COMMA, "Expected ',' in for-of binding");
+        valueName = consume(TokenType::IDENTIFIER, "Expected value name in for-of binding").value;
+        consume(TokenType::RBRACKET, "Expected ']' after for-of binding");
+    } else {
+        name = consume(TokenType::IDENTIFIER, "Expected variable name in for-of").value;
+    }
+    Token of = consume(TokenType::IDENTIFIER, "Expected 'of' in for-of");
+    if (of.value != "of") error("Expected 'of' in for-of");
+    auto iterable = parseExpression();
+    consume(TokenType::RPAREN, "Expected ')' after for-of clause");
+    auto forOf = std::make_unique<ForOfStatement>(name, valueName, isConst, std::move(iterable));
+    consume(TokenType::LBRACE, "Expected '{' before for body");
+    while (!check(TokenType::RBRACE) && !isAtEnd()) {
+        forOf->body.push_back(parseStatement());
+    }
+    consume(TokenType::RBRACE, "Expected '}' after for body");
+    return forOf;
+}
+namespace {
+// Rejects what a parallel loop body cannot do: assign the loop variable or
+// return from the enclosing function. Lambdas in the body are their own scope.
+class ParallelBodyChecker : public ASTVisitor {
+public:
+    explicit ParallelBodyChecker(const std::string& v) : var(v) {}
+    std::string problem;
+    bool visitStatement(const Statement* stmt) override {
+        if (dynamic_cast<const ReturnStatement*>(stmt)) problem = "'return' is not allowed in a parallel for";
+        return problem.empty();
+    }
+    bool visitExpression(const Expression* expr) override {
+        if (dynamic_cast<const FunctionExpression*>(expr)) return false;
+        if (auto assign = dynamic_cast<const AssignmentExpression*>(expr)) {
+            auto target = dynamic_cast<const Identifier*>(assign->left.get());
+            if (target && target->name == var) problem = "a parallel for must not assign its loop variable";
+        }
+        return problem.empty();
+    }
+private:
+    std::string var;
+};
+bool isStepOfOne(const Expression* expr, const std::string& var) {
+    auto assign = dynamic_cast<const AssignmentExpression*>(expr);
+    if (!assign) return false;
+    auto target = dynamic_cast<const Identifier*>(assign->left.get());
+    if (!target || target->name != var) return false;
+    const Expression* step = assign->right.get();
+    if (assign->op == "=") {
+        auto sum = dynamic_cast<const BinaryExpression*>(step);
+        if (!sum || sum->op != "+") return false;
+        auto left = dynamic_cast<const Identifier*>(sum->left.get());
+        if (!left || left->name != var) return false;
+        step = sum->right.get();
+    } else if (assign->op != "+=") {
+        return false;
+    }
+    auto one = dynamic_cast<const NumberLiteral*>(step);
+    return one && one->value == 1;
+}
+}
+
+// parallel for (let i = from; i < to; i = i + 1) { ... }
+std::unique_ptr<Statement> Parser::parseParallelForStatement() {
+    auto stmt = parseForStatement();
+    auto forStmt = dynamic_cast<ForStatement*>(stmt.get());
+    if (!forStmt) error("Expected a counting loop after 'parallel'");
+    auto init = dynamic_cast<const VariableDeclaration*>(forStmt->initializer.get());
+    if (!init || init->isConst || !init->initializer) {
+        error("A parallel for must start with 'let <name> = <start>'");
+    }
+    auto cond = dynamic_cast<const BinaryExpression*>(forStmt->condition.get());
+    auto condVar = cond ? dynamic_cast<const Identifier*>(cond->left.get()) : nullptr;
+    if (!cond || cond->op != "<" || !condVar || condVar->name != init->name) {
+        error("A parallel for must test '" + init->name + " < <end>'");
+    }
+    if (!forStmt->increment || !isStepOfOne(forStmt->increment.get(), init->name)) {
+        error("A parallel for must step by '" + init->name + " = " + init->name + " + 1'");
+    }
+    ParallelBodyChecker checker(init->name);
+    walk(forStmt->body, checker);
+    walk(cond->right.get(), checker);
+    if (!checker.problem.empty()) error(checker.problem);
+    forStmt->parallel = true;
+    return stmt;
+}
 std::unique_ptr<Statement> Parser::parseReturnStatement() {
     std::unique_ptr<Expression> value = nullptr;
     if (!check(TokenType::SEMICOLON)) {
@@ -318,7 +470,13 @@ std::unique_ptr<Statement> Parser::parseThrowStatement() {
 }
 
 std::unique_ptr<Statement> Parser::parseStatement() {
+    Token start = peek();
+    return positioned(parseBareStatement(), start);
+}
+
+std::unique_ptr<Statement> Parser::parseBareStatement() {
     if (match(TokenType::FUNCTION)) return parseFunctionDeclaration();
+    if (match(TokenType::AT)) return parseAnnotatedDeclaration();
     if (match(TokenType::CLASS)) return parseClassDeclaration();
     if (match(TokenType::LET) || match(TokenType::CONST)) return parseVariableDeclaration();
     if (match(TokenType::RETURN)) return parseReturnStatement();
@@ -326,6 +484,12 @@ std::unique_ptr<Statement> Parser::parseStatement() {
     if (match(TokenType::IF)) return parseIfStatement();
     if (match(TokenType::WHILE)) return parseWhileStatement();
     if (match(TokenType::FOR)) return parseForStatement();
+    // `parallel` is contextual, like `of`.
+    if (check(TokenType::IDENTIFIER) && peek().value == "parallel" && peek(1).type == TokenType::FOR) {
+        advance();
+        advance();
+        return parseParallelForStatement();
+    }
     if (match(TokenType::TRY)) return parseTryStatement();
     if (match(TokenType::LBRACE)) return parseBlockStatement();
     
@@ -333,24 +497,26 @@ std::unique_ptr<Statement> Parser::parseStatement() {
 }
 
 std::unique_ptr<Expression> Parser::parseAssignment() {
+    Token start = peek();
     auto expr = parseTernary(); // Was parseLogicalOr
     if (match({TokenType::EQUAL, TokenType::PLUS_EQUAL, TokenType::MINUS_EQUAL, 
                TokenType::STAR_EQUAL, TokenType::SLASH_EQUAL, TokenType::PERCENT_EQUAL,
                TokenType::AND_EQUAL, TokenType::OR_EQUAL, TokenType::XOR_EQUAL})) {
         std::string op = tokens[current - 1].value;
         auto value = parseAssignment();
-        return std::make_unique<AssignmentExpression>(std::move(expr), op, std::move(value));
+        return positioned(std::make_unique<AssignmentExpression>(std::move(expr), op, std::move(value)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseTernary() {
+    Token start = peek();
     auto expr = parseLogicalOr();
     if (match(TokenType::QUESTION)) {
         auto thenBranch = parseExpression(); // Allow assignment in branches? usually yes, or parseTernary
         consume(TokenType::COLON, "Expected ':' in ternary operator");
         auto elseBranch = parseTernary(); // Right associative
-        return std::make_unique<ConditionalExpression>(std::move(expr), std::move(thenBranch), std::move(elseBranch));
+        return positioned(std::make_unique<ConditionalExpression>(std::move(expr), std::move(thenBranch), std::move(elseBranch)), start);
     }
     return expr;
 }
@@ -360,111 +526,122 @@ std::unique_ptr<Expression> Parser::parseExpression() {
 }
 
 std::unique_ptr<Expression> Parser::parseLogicalOr() {
+    Token start = peek();
     auto expr = parseLogicalAnd();
     while (match(TokenType::OR_OR)) {
         std::string op = tokens[current - 1].value;
         auto right = parseLogicalAnd();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseLogicalAnd() {
+    Token start = peek();
     auto expr = parseBitwiseOr(); // Was parseEquality
     while (match(TokenType::AND_AND)) {
         std::string op = tokens[current - 1].value;
         auto right = parseBitwiseOr();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseBitwiseOr() {
+    Token start = peek();
     auto expr = parseBitwiseXor();
     while (match(TokenType::PIPE)) {
         std::string op = tokens[current - 1].value;
         auto right = parseBitwiseXor();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseBitwiseXor() {
+    Token start = peek();
     auto expr = parseBitwiseAnd();
     while (match(TokenType::CARET)) {
         std::string op = tokens[current - 1].value;
         auto right = parseBitwiseAnd();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseBitwiseAnd() {
+    Token start = peek();
     auto expr = parseEquality();
     while (match(TokenType::AMPERSAND)) {
         std::string op = tokens[current - 1].value;
         auto right = parseEquality();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseEquality() {
+    Token start = peek();
     auto expr = parseComparison();
     while (match({TokenType::EQUAL_EQUAL, TokenType::BANG_EQUAL})) {
         std::string op = tokens[current - 1].value;
         auto right = parseComparison();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseComparison() {
+    Token start = peek();
     auto expr = parseShift(); // Was parseAddition
     while (match({TokenType::LESS, TokenType::LESS_EQUAL, 
                   TokenType::GREATER, TokenType::GREATER_EQUAL})) {
         std::string op = tokens[current - 1].value;
         auto right = parseShift();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseShift() {
+    Token start = peek();
     auto expr = parseAddition();
     while (match({TokenType::LEFT_SHIFT, TokenType::RIGHT_SHIFT})) {
         std::string op = tokens[current - 1].value;
         auto right = parseAddition();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseAddition() {
+    Token start = peek();
     auto expr = parseMultiplication();
     while (match({TokenType::PLUS, TokenType::MINUS})) {
         std::string op = tokens[current - 1].value;
         auto right = parseMultiplication();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseMultiplication() {
+    Token start = peek();
     auto expr = parseUnary();
     while (match({TokenType::STAR, TokenType::SLASH, TokenType::PERCENT})) {
         std::string op = tokens[current - 1].value;
         auto right = parseUnary();
-        expr = std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right));
+        expr = positioned(std::make_unique<BinaryExpression>(op, std::move(expr), std::move(right)), start);
     }
     return expr;
 }
 
 std::unique_ptr<Expression> Parser::parseUnary() {
+    Token start = peek();
     if (match({TokenType::BANG, TokenType::MINUS, TokenType::TILDE})) { // Added TILDE
         std::string op = tokens[current - 1].value;
         auto right = parseUnary();
-        return std::make_unique<UnaryExpression>(op, std::move(right));
+        return positioned(std::make_unique<UnaryExpression>(op, std::move(right)), start);
     }
     return parsePostfix();
 }
@@ -474,7 +651,8 @@ std::unique_ptr<Expression> Parser::parsePostfix() {
 }
 
 std::unique_ptr<Expression> Parser::parseCall() {
-    auto expr = parsePrimary();
+    Token start = peek();
+    auto expr = positioned(parsePrimary(), start);
     while (true) {
         if (match(TokenType::LPAREN)) {
             auto call = std::make_unique<CallExpression>(std::move(expr));
@@ -484,14 +662,14 @@ std::unique_ptr<Expression> Parser::parseCall() {
                 } while (match(TokenType::COMMA));
             }
             consume(TokenType::RPAREN, "Expected ')' after arguments");
-            expr = std::move(call);
+            expr = positioned(std::move(call), start);
         } else if (match(TokenType::DOT)) {
             Token name = consume(TokenType::IDENTIFIER, "Expected property name after '.'");
-            expr = std::make_unique<MemberExpression>(std::move(expr), name.value);
+            expr = positioned(std::make_unique<MemberExpression>(std::move(expr), name.value), start);
         } else if (match(TokenType::LBRACKET)) {
             auto index = parseExpression();
             consume(TokenType::RBRACKET, "Expected ']' after index");
-            expr = std::make_unique<ArrayAccess>(std::move(expr), std::move(index));
+            expr = positioned(std::make_unique<ArrayAccess>(std::move(expr), std::move(index)), start);
         } else {
             break;
         }
@@ -527,8 +705,10 @@ std::unique_ptr<Expression> Parser::parsePrimary() {
                     if (!check(TokenType::IDENTIFIER)) throw false;
                     Token name = advance();
                     Type type = Type::ANY;
+                    size_t typeStart = current;
                     if (match(TokenType::COLON)) type = parseType();
                     params.emplace_back(name.value, type);
+                    if (typeStart != current) params.back().cppType = typeText(typeStart + 1);
                 } while (match(TokenType::COMMA));
                 
                 if (match(TokenType::RPAREN)) {
@@ -549,8 +729,9 @@ std::unique_ptr<Expression> Parser::parsePrimary() {
                 }
                 consume(TokenType::RBRACE, "Expected '}'");
             } else {
+                Token start = peek();
                 auto expr = parseExpression();
-                func->body.push_back(std::make_unique<ReturnStatement>(std::move(expr)));
+                func->body.push_back(positioned(std::make_unique<ReturnStatement>(std::move(expr)), start));
             }
             return func;
         }
@@ -577,8 +758,9 @@ std::unique_ptr<Expression> Parser::parsePrimary() {
                 }
                 consume(TokenType::RBRACE, "Expected '}'");
             } else {
+                Token start = peek();
                 auto expr = parseExpression();
-                func->body.push_back(std::make_unique<ReturnStatement>(std::move(expr)));
+                func->body.push_back(positioned(std::make_unique<ReturnStatement>(std::move(expr)), start));
             }
             return func;
         }
@@ -595,10 +777,7 @@ std::unique_ptr<Expression> Parser::parsePrimary() {
         consume(TokenType::LPAREN, "Expected '(' after function");
         if (!check(TokenType::RPAREN)) {
             do {
-                Token paramName = consume(TokenType::IDENTIFIER, "Expected parameter name");
-                Type paramType = Type::ANY;
-                if (match(TokenType::COLON)) paramType = parseType();
-                func->parameters.emplace_back(paramName.value, paramType);
+                func->parameters.push_back(parseParameter());
             } while (match(TokenType::COMMA));
         }
         consume(TokenType::RPAREN, "Expected ')' after parameters");
@@ -659,6 +838,33 @@ std::unique_ptr<Expression> Parser::parseArrayLiteral() {
     consume(TokenType::RBRACKET, "Expected ']' after array elements");
     return array;
 }
+FunctionParameter Parser::parseParameter() {
+    Token name = consume(TokenType::IDENTIFIER, "Expected parameter name");
+    FunctionParameter param(name.value, Type::ANY);
+    if (match(TokenType::COLON)) {
+        size_t startToken = current;
+        param.type = parseType();
+        param.cppType = typeText(startToken);
+    }
+    return param;
+}
+// The type parsed from startToken up to the current token, as C++: the
+// primitive type names are mapped, the rest (class names, generics) kept.
+std::string Parser::typeText(size_t startToken) {
+    std::string text;
+    for (size_t i = startToken; i < current; i++) {
+        std::string val = tokens[i].value;
+        if (tokens[i].type == TokenType::TYPE_STRING) val = "std::string";
+        else if (tokens[i].type == TokenType::TYPE_NUMBER) val = "double";
+        else if (tokens[i].type == TokenType::TYPE_BOOLEAN) val = "bool";
+        else if (tokens[i].type == TokenType::TYPE_VOID) val = "void";
+        // else if (tokens[i].type == TokenType::TYPE_ANY) val = "auto";
+        else if (tokens[i].type == TokenType::FUNCTION) val = "auto";
+        else if (tokens[i].value == "function") val = "auto"; // Just in case lexer difference
+        text += val;
+    }
+    return text;
+}
 Type Parser::parseType() {
     if (match(TokenType::TYPE_NUMBER)) return Type::NUMBER;
     if (match(TokenType::TYPE_STRING)) return Type::STRING;
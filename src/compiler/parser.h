@@ -19,12 +19,17 @@ private:
     Token consume(TokenType type, const std::string& message);
     bool isAtEnd();
     std::unique_ptr<Statement> parseStatement();
+    // parseStatement without recording the statement's source position.
+    std::unique_ptr<Statement> parseBareStatement();
     std::unique_ptr<Statement> parseVariableDeclaration();
     std::unique_ptr<Statement> parseFunctionDeclaration();
+    std::unique_ptr<Statement> parseAnnotatedDeclaration();
     std::unique_ptr<Statement> parseClassDeclaration();
     std::unique_ptr<Statement> parseIfStatement();
     std::unique_ptr<Statement> parseWhileStatement();
     std::unique_ptr<Statement> parseForStatement();
+    std::unique_ptr<Statement> parseForOfStatement();
+    std::unique_ptr<Statement> parseParallelForStatement();
     std::unique_ptr<Statement> parseTryStatement();
     std::unique_ptr<Statement> parseReturnStatement();
     std::unique_ptr<Statement> parseThrowStatement(); // Added
@@ -50,6 +55,8 @@ private:
     std::unique_ptr<Expression> parseArrayLiteral();
     std::unique_ptr<Expression> parseMapLiteral();
     Type parseType();
+    FunctionParameter parseParameter();
+    std::string typeText(size_t startToken);
     void error(const std::string& message);
 };
 }  
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+namespace umbrella {
+// Output buffer for generated C++. Statement generators append to the one
+// buffer of their CodeGenerator instead of returning strings that each
+// enclosing block copies again, so a nested block costs its own size rather
+// than its size times its depth.
+class CodeWriter {
+public:
+    // Indentation level, written as spaces without building a string.
+    struct Indent {
+        int level;
+    };
+    CodeWriter& operator<<(std::string_view text) {
+        buffer.append(text);
+        return *this;
+    }
+    CodeWriter& operator<<(const char* text) { return *this << std::string_view(text); }
+    CodeWriter& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    CodeWriter& operator<<(char c) {
+        buffer.push_back(c);
+        return *this;
+    }
+    CodeWriter& operator<<(Indent indent) {
+        buffer.append(static_cast<size_t>(indent.level) * 4, ' ');
+        return *this;
+    }
+    template<typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    CodeWriter& operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+    // Numbers in generated code go through generateNumberLiteral; without this
+    // a double would silently convert to char.
+    template<typename T, typename = std::enable_if_t<std::is_floating_point_v<T>>, typename = void>
+    CodeWriter& operator<<(T value) = delete;
+    bool empty() const { return buffer.empty(); }
+    void reserve(size_t size) { buffer.reserve(size); }
+    // Hands over the contents and leaves the writer empty.
+    std::string take() {
+        std::string text = std::move(buffer);
+        buffer.clear();
+        return text;
+    }
+private:
+    std::string buffer;
+};
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+template<typename K, typename V>
+class Map {
+public:
+    std::map<K, V> data;
+    Map() = default;
+    Map(const std::map<K, V>& d) : data(d) {}
+    void set(const K& key, const V& value) {
+        data[key] = value;
+    }
+    void set(const K& key, V&& value) {
+        data[key] = std::move(value);
+    }
+    V get(const K& key) const {
+        auto it = data.find(key);
+        if (it == data.end()) UMBRELLA_THROW(std::runtime_error("Key not found"));
+        return it->second;
+    }
+    // get without the exception for a missing key.
+    Optional<V> tryGet(const K& key) const {
+        auto it = data.find(key);
+        if (it == data.end()) return {};
+        return it->second;
+    }
+    V getOrDefault(const K& key, V fallback) const {
+        auto it = data.find(key);
+        return it != data.end() ? it->second : fallback;
+    }
+    bool has(const K& key) const {
+        return data.find(key) != data.end();
+    }
+    void remove(const K& key) {
+        data.erase(key);
+    }
+    size_t size() const {
+        return data.size();
+    }
+    void clear() {
+        data.clear();
+    }
+    // Range-for over (key, value) pairs, used by `for (const [k, v] of map)`.
+    auto begin() { return data.begin(); }
+    auto end() { return data.end(); }
+    auto begin() const { return data.begin(); }
+    auto end() const { return data.end(); }
+    Array<K> keys() const {
+        std::vector<K> result;
+        for (const auto& pair : data) {
+            result.push_back(pair.first);
+        }
+        return Array<K>(result);
+    }
+    Array<V> values() const {
+        std::vector<V> result;
+        for (const auto& pair : data) {
+            result.push_back(pair.second);
+        }
+        return Array<V>(result);
+    }
+};
+
+// Hash of a @memo key: the function's arguments as a tuple.
+template<typename... Args>
+size_t memoHash(const std::tuple<Args...>& key) {
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    std::apply([&h](const auto&... arg) {
+        ((h = (h ^ std::hash<std::decay_t<decltype(arg)>>{}(arg)) * 0xff51afd7ed558ccdull), ...);
+    }, key);
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+// Cache behind a @memo function. Entries live in a vector; a flat
+// open-addressing index (linear probing, at most half full) maps keys to
+// them. With a capacity, a full table evicts its least recently used entry
+// and reuses its storage, so a bounded cache never allocates after filling.
+template<typename Key, typename Value>
+class MemoTable {
+public:
+    explicit MemoTable(size_t capacity = 0) : capacity(capacity) { index.assign(16, EMPTY); }
+    std::optional<Value> find(const Key& key) {
+        size_t hash = memoHash(key);
+        for (size_t slot = hash & (index.size() - 1);; slot = (slot + 1) & (index.size() - 1)) {
+            uint32_t e = index[slot];
+            if (e == EMPTY) return std::nullopt;
+            if (entries[e].hash == hash && entries[e].key == key) {
+                if (capacity) touch(e);
+                return entries[e].value;
+            }
+        }
+    }
+    void insert(Key key, Value value) {
+        size_t hash = memoHash(key);
+        size_t slot = hash & (index.size() - 1);
+        for (; index[slot] != EMPTY; slot = (slot + 1) & (index.size() - 1)) {
+            Entry& entry = entries[index[slot]];
+            if (entry.hash == hash && entry.key == key) {
+                entry.value = std::move(value);
+                return;
+            }
+        }
+        uint32_t e;
+        if (capacity && entries.size() >= capacity) {
+            // Reuse the least recently used entry.
+            e = tail;
+            unlink(e);
+            erase(e);
+            entries[e] = Entry{std::move(key), std::move(value), hash, EMPTY, EMPTY};
+            slot = hash & (index.size() - 1);
+            while (index[slot] != EMPTY) slot = (slot + 1) & (index.size() - 1);
+        } else {
+            e = static_cast<uint32_t>(entries.size());
+            entries.push_back(Entry{std::move(key), std::move(value), hash, EMPTY, EMPTY});
+            if (entries.size() * 2 > index.size()) {
+                grow();
+                if (capacity) pushFront(e);
+                return;
+            }
+        }
+        index[slot] = e;
+        if (capacity) pushFront(e);
+    }
+    size_t size() const { return entries.size(); }
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    struct Entry {
+        Key key;
+        Value value;
+        size_t hash;
+        uint32_t prev, next; // recency list, most recent first (bounded tables only)
+    };
+    size_t capacity;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> index;
+    uint32_t head = EMPTY, tail = EMPTY;
+
+    void grow() {
+        index.assign(index.size() * 2, EMPTY);
+        for (uint32_t e = 0; e < entries.size(); e++) {
+            size_t slot = entries[e].hash & (index.size() - 1);
+            while (index[slot] != EMPTY) slot = (slot + 1) & (index.size() - 1);
+            index[slot] = e;
+        }
+    }
+    // Removes entry e from the index, shifting later entries of its probe
+    // run back so lookups never need tombstones.
+    void erase(uint32_t e) {
+        size_t mask = index.size() - 1;
+        size_t hole = entries[e].hash & mask;
+        while (index[hole] != e) hole = (hole + 1) & mask;
+        for (size_t slot = (hole + 1) & mask; index[slot] != EMPTY; slot = (slot + 1) & mask) {
+            size_t home = entries[index[slot]].hash & mask;
+            // Move back unless the entry's home lies cyclically in (hole, slot].
+            bool stays = hole <= slot ? (home > hole && home <= slot) : (home > hole || home <= slot);
+            if (!stays) {
+                index[hole] = index[slot];
+                hole = slot;
+            }
+        }
+        index[hole] = EMPTY;
+    }
+    void unlink(uint32_t e) {
+        Entry& entry = entries[e];
+        if (entry.prev != EMPTY) entries[entry.prev].next = entry.next; else head = entry.next;
+        if (entry.next != EMPTY) entries[entry.next].prev = entry.prev; else tail = entry.prev;
+    }
+    void pushFront(uint32_t e) {
+        entries[e].prev = EMPTY;
+        entries[e].next = head;
+        if (head != EMPTY) entries[head].prev = e;
+        head = e;
+        if (tail == EMPTY) tail = e;
+    }
+    void touch(uint32_t e) {
+        if (head == e) return;
+        unlink(e);
+        pushFront(e);
+    }
+};
+
+// MemoTable for @memo(sync) functions, which may be called from several
+// threads. The lock is not held while the function body runs, so two threads
+// may both compute a missing entry; the result is the same either way.
+template<typename Key, typename Value>
+class SharedMemoTable {
+public:
+    explicit SharedMemoTable(size_t capacity = 0) : table(capacity) {}
+    std::optional<Value> find(const Key& key) {
+        std::lock_guard<std::mutex> guard(lock);
+        return table.find(key);
+    }
+    void insert(Key key, Value value) {
+        std::lock_guard<std::mutex> guard(lock);
+        table.insert(std::move(key), std::move(value));
+    }
+private:
+    std::mutex lock;
+    MemoTable<Key, Value> table;
+};
+}  
+}  
@@ -1,19 +1,12 @@
-#include "advanced.h"
+#include "database.h"
 #include <iostream>
-#include <thread>
-#include <mutex>
-#include <chrono>
-#include <cstdlib>
-#include <unistd.h>
-#include <signal.h>
-#include <sys/wait.h>
-#include <sys/wait.h>
 #include <sqlite3.h>
 namespace umbrella {
 namespace runtime {
 Database::Database(const std::string& path) : dbPath(path) {
     sqlite3* rawDb = nullptr;
     if (sqlite3_open(path.c_str(), &rawDb) != SQLITE_OK) {
+        Output::flush();
         std::cerr << "Can't open database: " << sqlite3_errmsg(rawDb) << std::endl;
         // Even if open fails, we might need to close if handle was allocated
         if (rawDb) sqlite3_close(rawDb);
@@ -34,6 +27,7 @@ void Database::exec(const std::string& sql) {
     if (!db) return;
     char* errMsg = 0;
     if (sqlite3_exec((sqlite3*)db.get(), sql.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+        Output::flush();
         std::cerr << "SQL error: " << errMsg << std::endl;
         sqlite3_free(errMsg);
     }
@@ -70,6 +64,7 @@ void Database::prepare(const std::string& sql) {
 
     sqlite3_stmt* rawStmt = nullptr;
     if (sqlite3_prepare_v2((sqlite3*)db.get(), sql.c_str(), -1, &rawStmt, nullptr) != SQLITE_OK) {
+        Output::flush();
         std::cerr << "SQL prepare error: " << sqlite3_errmsg((sqlite3*)db.get()) << std::endl;
         if (rawStmt) {
             sqlite3_finalize(rawStmt);
@@ -111,6 +106,7 @@ bool Database::step() {
         return true; // row available
     }
     if (rc != SQLITE_DONE) {
+        Output::flush();
         std::cerr << "SQL step error: " << sqlite3_errmsg((sqlite3*)db.get()) << std::endl;
     }
     return false;
@@ -147,108 +143,5 @@ void Database::close() {
     // Resetting the shared_ptr will trigger the deleter if this is the last reference
     db.reset();
 }
-Thread Thread::spawn(std::function<void()> func) {
-    Thread t;
-    t.handle = new std::thread(func);
-    return t;
-}
-void Thread::join() {
-    if (handle) {
-        ((std::thread*)handle)->join();
-    }
-}
-void Thread::detach() {
-    if (handle) {
-        ((std::thread*)handle)->detach();
-    }
-}
-bool Thread::joinable() {
-    if (handle) {
-        return ((std::thread*)handle)->joinable();
-    }
-    return false;
-}
-Mutex::Mutex() {
-    handle = new std::mutex();
-}
-Mutex::~Mutex() {
-    if (handle) {
-        delete (std::mutex*)handle;
-    }
-}
-void Mutex::lock() {
-    if (handle) {
-        ((std::mutex*)handle)->lock();
-    }
-}
-void Mutex::unlock() {
-    if (handle) {
-        ((std::mutex*)handle)->unlock();
-    }
-}
-bool Mutex::tryLock() {
-    if (handle) {
-        return ((std::mutex*)handle)->try_lock();
-    }
-    return false;
-}
-Process Process::spawn(const std::string& cmd, const std::vector<std::string>& args) {
-    Process p;
-    pid_t pid = fork();
-    if (pid == 0) {
-        std::vector<char*> argv;
-        argv.push_back(const_cast<char*>(cmd.c_str()));
-        for (const auto& arg : args) {
-            argv.push_back(const_cast<char*>(arg.c_str()));
-        }
-        argv.push_back(nullptr);
-        execvp(cmd.c_str(), argv.data());
-        exit(1);
-    } else {
-        p.pid = pid;
-        p.command = cmd;
-    }
-    return p;
-}
-Process Process::spawn(const std::string& cmd, const Array<std::string>& args) {
-    return spawn(cmd, args.data);
-}
-
-std::string Process::stdout() {
-    return "";
-}
-std::string Process::stderr() {
-    return "";
-}
-int Process::wait() {
-    int status;
-    waitpid(pid, &status, 0);
-    return WEXITSTATUS(status);
-}
-void Process::kill() {
-    ::kill(pid, SIGTERM);
-}
-bool Process::isRunning() {
-    int status;
-    pid_t result = waitpid(pid, &status, WNOHANG);
-    return result == 0;
-}
-void Timer::sleep(int milliseconds) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
-}
-void Timer::setTimeout(std::function<void()> callback, int milliseconds) {
-    std::thread([callback, milliseconds]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
-        callback();
-    }).detach();
-}
-void Timer::setInterval(std::function<void()> callback, int milliseconds) {
-    std::thread([callback, milliseconds]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
-            callback();
-        }
-    }).detach();
-}
 }  
 }  
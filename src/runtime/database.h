@@ -1,12 +1,18 @@
 #pragma once
 #include <string>
-#include <vector>
-#include <map>
 #include <memory>
-#include <functional>
 #include "runtime.h"
+#include "collections.h"
 namespace umbrella {
 namespace runtime {
+// Simple row type used by Database::query
+struct Row {
+    Map<std::string, std::string> data;
+
+    std::string get(const std::string& column) const {
+        return data.get(column);
+    }
+};
 class Database {
 public:
     std::shared_ptr<void> db;   
@@ -32,40 +38,5 @@ public:
     int changes();
     void close();
 };
-class Thread {
-public:
-    void* handle;   
-    static Thread spawn(std::function<void()> func);
-    void join();
-    void detach();
-    bool joinable();
-};
-class Mutex {
-public:
-    void* handle;   
-    Mutex();
-    ~Mutex();
-    void lock();
-    void unlock();
-    bool tryLock();
-};
-class Process {
-public:
-    int pid;
-    std::string command;
-    static Process spawn(const std::string& cmd, const std::vector<std::string>& args);
-    static Process spawn(const std::string& cmd, const Array<std::string>& args); // Added overload
-    std::string stdout();
-    std::string stderr();
-    int wait();
-    void kill();
-    bool isRunning();
-};
-class Timer {
-public:
-    static void sleep(int milliseconds);
-    static void setTimeout(std::function<void()> callback, int milliseconds);
-    static void setInterval(std::function<void()> callback, int milliseconds);
-};
 }  
 }  
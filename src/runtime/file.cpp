@@ -0,0 +1,33 @@
+#include "file.h"
+#include "runtime.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+namespace umbrella {
+namespace runtime {
+std::string File::readFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        UMBRELLA_THROW(std::runtime_error("Could not open file: " + path));
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+void File::writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        UMBRELLA_THROW(std::runtime_error("Could not write to file: " + path));
+    }
+    file << content;
+}
+bool File::exists(const std::string& path) {
+    std::ifstream file(path);
+    return file.good();
+}
+void File::deleteFile(const std::string& path) {
+    std::remove(path.c_str());
+}
+}  
+}  
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+namespace umbrella {
+namespace runtime {
+class File {
+public:
+    static std::string readFile(const std::string& path);
+    static void writeFile(const std::string& path, const std::string& content);
+    static bool exists(const std::string& path);
+    static void deleteFile(const std::string& path);
+};
+}  
+}  
@@ -0,0 +1,56 @@
+#include "http.h"
+#include <cstdio>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+HTTPResponse HTTP::get(const std::string& url) {
+    return request("GET", url);
+}
+HTTPResponse HTTP::post(const std::string& url, const std::string& body) {
+    return request("POST", url, body);
+}
+HTTPResponse HTTP::put(const std::string& url, const std::string& body) {
+    return request("PUT", url, body);
+}
+HTTPResponse HTTP::del(const std::string& url) {
+    return request("DELETE", url);
+}
+HTTPResponse HTTP::request(const std::string& method, const std::string& url,
+                           const std::string& body,
+                           const std::map<std::string, std::string>& headers) {
+    HTTPResponse response;
+    std::string cmd = "curl -s -w '\\n%{http_code}' ";
+    cmd += "-X " + method + " ";
+    if (!body.empty()) {
+        cmd += "-d '" + body + "' ";
+    }
+    for (const auto& header : headers) {
+        cmd += "-H '" + header.first + ": " + header.second + "' ";
+    }
+    cmd += "'" + url + "'";
+    Output::flush();
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) {
+        response.statusCode = 0;
+        response.body = "Failed to execute request";
+        return response;
+    }
+    char buffer[128];
+    std::string result;
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+        result += buffer;
+    }
+    pclose(pipe);
+    size_t lastNewline = result.find_last_of('\n');
+    if (lastNewline != std::string::npos && lastNewline > 0) {
+        std::string statusStr = result.substr(lastNewline + 1);
+        response.statusCode = std::stoi(statusStr);
+        response.body = result.substr(0, lastNewline);
+    } else {
+        response.statusCode = 200;
+        response.body = result;
+    }
+    return response;
+}
+}  
+}  
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <map>
+namespace umbrella {
+namespace runtime {
+struct HTTPResponse {
+    int statusCode;
+    std::string body;
+    std::map<std::string, std::string> headers;
+};
+class HTTP {
+public:
+    static HTTPResponse get(const std::string& url);
+    static HTTPResponse post(const std::string& url, const std::string& body);
+    static HTTPResponse put(const std::string& url, const std::string& body);
+    static HTTPResponse del(const std::string& url);
+    static HTTPResponse request(const std::string& method, const std::string& url, 
+                               const std::string& body = "",
+                               const std::map<std::string, std::string>& headers = {});
+};
+}  
+}  
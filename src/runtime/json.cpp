@@ -0,0 +1,14 @@
+#include "json.h"
+namespace umbrella {
+namespace runtime {
+std::string JSON::stringify(const std::string& value) {
+    return "\"" + value + "\"";
+}
+std::string JSON::parse(const std::string& json) {
+    if (json.size() >= 2 && json.front() == '"' && json.back() == '"') {
+        return json.substr(1, json.size() - 2);
+    }
+    return json;
+}
+}  
+}  
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+namespace umbrella {
+namespace runtime {
+class JSON {
+public:
+    static std::string stringify(const std::string& value);
+    static std::string parse(const std::string& json);
+};
+}  
+}  
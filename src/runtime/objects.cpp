@@ -0,0 +1,67 @@
+#include "objects.h"
+#include <algorithm>
+#include <mutex>
+namespace umbrella {
+namespace runtime {
+namespace {
+// Blocks spilled by busy threads or returned by exited ones, per size class.
+std::mutex sharedMutex;
+PoolBlock* sharedFree[POOL_SIZE_CLASSES];
+}
+void* poolRefill(size_t sizeClass) {
+    size_t batch = poolBatch(sizeClass);
+    PoolBlock* list;
+    size_t count = 0;
+    {
+        // Takes at most one batch, so the other threads can still refill.
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        list = sharedFree[sizeClass];
+        PoolBlock* last = nullptr;
+        for (PoolBlock* block = list; block && count < batch; block = block->next) {
+            last = block;
+            count++;
+        }
+        if (last) {
+            sharedFree[sizeClass] = last->next;
+            last->next = nullptr;
+        }
+    }
+    if (!list) {
+        size_t blockSize = (sizeClass + 1) * POOL_GRANULE;
+        count = batch;
+        char* chunk = static_cast<char*>(::operator new(count * blockSize));
+        for (size_t i = 0; i < count; i++) {
+            auto block = reinterpret_cast<PoolBlock*>(chunk + i * blockSize);
+            block->next = i + 1 < count ? reinterpret_cast<PoolBlock*>(chunk + (i + 1) * blockSize) : nullptr;
+        }
+        list = reinterpret_cast<PoolBlock*>(chunk);
+    }
+    poolCache.free[sizeClass] = list->next;
+    poolCache.count[sizeClass] = count - 1;
+    return list;
+}
+void poolSpill(size_t sizeClass) {
+    size_t keep = poolBatch(sizeClass);
+    PoolBlock* last = poolCache.free[sizeClass];
+    for (size_t i = 1; i < keep; i++) last = last->next;
+    PoolBlock* excess = std::exchange(last->next, nullptr);
+    PoolBlock* tail = excess;
+    while (tail->next) tail = tail->next;
+    poolCache.count[sizeClass] = keep;
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    tail->next = sharedFree[sizeClass];
+    sharedFree[sizeClass] = excess;
+}
+PoolCache::~PoolCache() {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    for (size_t i = 0; i < POOL_SIZE_CLASSES; i++) {
+        if (!free[i]) continue;
+        PoolBlock* tail = free[i];
+        while (tail->next) tail = tail->next;
+        tail->next = sharedFree[i];
+        sharedFree[i] = std::exchange(free[i], nullptr);
+        count[i] = 0;
+    }
+}
+}  
+}  
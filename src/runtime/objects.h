@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+// Instances of user classes live on the heap behind Ref<T> handles, so
+// assigning, pushing or passing an object shares it instead of copying it.
+//
+// Their memory comes from size-segregated free lists (16-byte size classes
+// up to POOL_MAX_SIZE). Each thread allocates from and frees to its own
+// lists without locking; empty lists are refilled from a shared list or a
+// new chunk. A list holding more than two chunks' worth of blocks (objects
+// made on one thread and dropped on another) moves one chunk's worth to the
+// shared list, and a thread's lists go back to the shared list when it exits.
+// Pooled memory is reused but never returned to the system.
+inline constexpr size_t POOL_GRANULE = 16;
+inline constexpr size_t POOL_MAX_SIZE = 512;
+inline constexpr size_t POOL_SIZE_CLASSES = POOL_MAX_SIZE / POOL_GRANULE;
+inline constexpr size_t POOL_CHUNK_SIZE = 16 * 1024;
+// Blocks per chunk of a size class: the unit of refills and spills.
+inline constexpr size_t poolBatch(size_t sizeClass) {
+    return std::max<size_t>(POOL_CHUNK_SIZE / ((sizeClass + 1) * POOL_GRANULE), 8);
+}
+struct PoolBlock {
+    PoolBlock* next;
+};
+struct PoolCache {
+    PoolBlock* free[POOL_SIZE_CLASSES] = {};
+    size_t count[POOL_SIZE_CLASSES] = {};
+    ~PoolCache();
+};
+inline thread_local PoolCache poolCache;
+void* poolRefill(size_t sizeClass);
+void poolSpill(size_t sizeClass);
+inline void* poolAllocate(size_t size) {
+    if (size > POOL_MAX_SIZE) return ::operator new(size);
+    size_t sizeClass = (size - 1) / POOL_GRANULE;
+    PoolBlock* block = poolCache.free[sizeClass];
+    if (!block) return poolRefill(sizeClass);
+    poolCache.free[sizeClass] = block->next;
+    poolCache.count[sizeClass]--;
+    return block;
+}
+inline void poolFree(void* pointer, size_t size) {
+    if (size > POOL_MAX_SIZE) {
+        ::operator delete(pointer);
+        return;
+    }
+    size_t sizeClass = (size - 1) / POOL_GRANULE;
+    auto block = static_cast<PoolBlock*>(pointer);
+    PoolBlock*& head = poolCache.free[sizeClass];
+    block->next = head;
+    head = block;
+    if (++poolCache.count[sizeClass] > 2 * poolBatch(sizeClass)) poolSpill(sizeClass);
+}
+
+template<typename T>
+class Ref;
+
+// Base of every user class: the intrusive reference count and the pooled
+// allocation. The roots of class hierarchies get a virtual destructor, so
+// `delete` frees the size of the most derived class.
+class RefCounted {
+public:
+    static void* operator new(size_t size) { return poolAllocate(size); }
+    static void operator delete(void* pointer, size_t size) { poolFree(pointer, size); }
+protected:
+    // Starts at one: the reference makeRef is about to hand out. A Ref to
+    // `this` made in the constructor then cannot free the object early.
+    RefCounted() = default;
+    RefCounted(const RefCounted&) {}
+    RefCounted& operator=(const RefCounted&) { return *this; }
+private:
+    template<typename>
+    friend class Ref;
+    mutable std::atomic<uint32_t> refs{1};
+};
+
+template<typename T>
+class Ref {
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+    // Another reference to an object that is already owned, such as `this`.
+    explicit Ref(T* object) : ptr(object) { retain(); }
+    Ref(const Ref& other) : ptr(other.ptr) { retain(); }
+    Ref(Ref&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(const Ref<U>& other) : ptr(other.ptr) { retain(); }
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(Ref<U>&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+    ~Ref() { release(); }
+    Ref& operator=(Ref other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+    // Null-checked unless built with --unchecked (UMBRELLA_UNCHECKED).
+    T& operator*() const {
+#ifndef UMBRELLA_UNCHECKED
+        if (!ptr) UMBRELLA_THROW(std::runtime_error("Null object reference"));
+#endif
+        return *ptr;
+    }
+    T* operator->() const { return &**this; }
+    T* get() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+    template<typename U>
+    bool operator==(const Ref<U>& other) const { return ptr == other.ptr; }
+private:
+    template<typename>
+    friend class Ref;
+    template<typename U, typename... Args>
+    friend Ref<U> makeRef(Args&&... args);
+    struct Adopt {};
+    Ref(T* object, Adopt) : ptr(object) {}
+    void retain() const {
+        if (ptr) static_cast<const RefCounted*>(ptr)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release() {
+        if (ptr && static_cast<const RefCounted*>(ptr)->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete ptr;
+        }
+    }
+    T* ptr = nullptr;
+};
+
+// `new T(args)`: the object comes from the pool with one reference.
+template<typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...), typename Ref<T>::Adopt{});
+}
+
+template<typename T>
+struct IsRef : std::false_type {};
+template<typename T>
+struct IsRef<Ref<T>> : std::true_type {};
+
+// The object behind a member access: `p.name` is emitted as `deref(p).name`
+// when `name` belongs to a class, so the same code works whether p is a Ref
+// or a value (a @soa element, a runtime object).
+template<typename T>
+decltype(auto) deref(T&& value) {
+    if constexpr (IsRef<std::remove_cvref_t<T>>::value) {
+        return *value;
+    } else {
+        return std::forward<T>(value);
+    }
+}
+}  
+}  
@@ -0,0 +1,80 @@
+#include "process.h"
+#include <cstdlib>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+namespace umbrella {
+namespace runtime {
+Process Process::spawn(const std::string& cmd, const std::vector<std::string>& args) {
+    Process p;
+    // The child must not inherit (and later repeat) unwritten output.
+    Output::flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(cmd.c_str()));
+        for (const auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execvp(cmd.c_str(), argv.data());
+        _exit(1);
+    } else {
+        p.pid = pid;
+        p.command = cmd;
+    }
+    return p;
+}
+Process Process::spawn(const std::string& cmd, const Array<std::string>& args) {
+    return spawn(cmd, args.data);
+}
+
+std::string Process::stdout() {
+    return "";
+}
+std::string Process::stderr() {
+    return "";
+}
+int Process::wait() {
+    int status;
+    waitpid(pid, &status, 0);
+    return WEXITSTATUS(status);
+}
+void Process::kill() {
+    ::kill(pid, SIGTERM);
+}
+bool Process::isRunning() {
+    int status;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    return result == 0;
+}
+std::string Env::get(const std::string& name, const std::string& defaultValue) {
+    const char* value = std::getenv(name.c_str());
+    return value ? std::string(value) : defaultValue;
+}
+void Env::set(const std::string& name, const std::string& value) {
+    #ifdef _WIN32
+        _putenv_s(name.c_str(), value.c_str());
+    #else
+        setenv(name.c_str(), value.c_str(), 1);
+    #endif
+}
+bool Env::has(const std::string& name) {
+    return std::getenv(name.c_str()) != nullptr;
+}
+std::string Env::home() {
+    #ifdef _WIN32
+        return get("USERPROFILE", "");
+    #else
+        return get("HOME", "");
+    #endif
+}
+std::string Env::cwd() {
+    char buffer[1024];
+    if (getcwd(buffer, sizeof(buffer)) != nullptr) {
+        return std::string(buffer);
+    }
+    return "";
+}
+}  
+}  
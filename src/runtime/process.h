@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+class Process {
+public:
+    int pid;
+    std::string command;
+    static Process spawn(const std::string& cmd, const std::vector<std::string>& args);
+    static Process spawn(const std::string& cmd, const Array<std::string>& args); // Added overload
+    std::string stdout();
+    std::string stderr();
+    int wait();
+    void kill();
+    bool isRunning();
+};
+class Env {
+public:
+    static std::string get(const std::string& name, const std::string& defaultValue = "");
+    static void set(const std::string& name, const std::string& value);
+    static bool has(const std::string& name);
+    static std::string home();
+    static std::string cwd();
+};
+}  
+}  
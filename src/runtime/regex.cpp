@@ -0,0 +1,50 @@
+#include "regex.h"
+#include <regex>
+#include <mutex>
+#include <optional>
+namespace umbrella {
+namespace runtime {
+struct CompiledRegex {
+    std::once_flag once;
+    std::optional<std::regex> re;
+};
+namespace {
+// An invalid pattern throws on every use, as it did when each call compiled it.
+const std::regex& compiledPattern(CompiledRegex& compiled, const std::string& pattern) {
+    std::call_once(compiled.once, [&] { compiled.re.emplace(pattern); });
+    return *compiled.re;
+}
+}
+Regex::Regex(const std::string& pat) : pattern(pat), compiled(std::make_shared<CompiledRegex>()) {}
+bool Regex::test(const std::string& str) const {
+    const std::regex& re = compiledPattern(*compiled, pattern);
+    return std::regex_search(str, re);
+}
+Array<std::string> Regex::match(const std::string& str) const {
+    std::vector<std::string> result;
+    const std::regex& re = compiledPattern(*compiled, pattern);
+    std::smatch matches;
+    if (std::regex_search(str, matches, re)) {
+        for (const auto& match : matches) {
+            result.push_back(match.str());
+        }
+    }
+    return Array<std::string>(result);
+}
+Array<std::string> Regex::findAll(const std::string& str) const {
+    std::vector<std::string> result;
+    const std::regex& re = compiledPattern(*compiled, pattern);
+    std::sregex_iterator it(str.begin(), str.end(), re);
+    std::sregex_iterator end;
+    while (it != end) {
+        result.push_back(it->str());
+        ++it;
+    }
+    return Array<std::string>(result);
+}
+std::string Regex::replace(const std::string& str, const std::string& replacement) const {
+    const std::regex& re = compiledPattern(*compiled, pattern);
+    return std::regex_replace(str, re, replacement);
+}
+}  
+}  
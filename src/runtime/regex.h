@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <memory>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+struct CompiledRegex;
+class Regex {
+public:
+    std::string pattern;
+    Regex(const std::string& pat);
+    bool test(const std::string& str) const;
+    Array<std::string> match(const std::string& str) const;
+    Array<std::string> findAll(const std::string& str) const;
+    std::string replace(const std::string& str, const std::string& replacement) const;
+private:
+    // The pattern is compiled on first use and shared by copies of the Regex.
+    std::shared_ptr<CompiledRegex> compiled;
+};
+}  
+}  
@@ -1,20 +1,784 @@
 #include "runtime.h"
-#include <iostream>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
-#include <regex>
+#include <map>
+#include <cstring>
 #include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <iomanip>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef __linux__
+#include <execinfo.h>
+#include <link.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
 namespace umbrella {
 namespace runtime {
+namespace {
+const size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+std::mutex outputMutex;
+std::terminate_handler previousTerminate = nullptr;
+
+bool stdoutIsTerminal() {
+    static const bool terminal = isatty(STDOUT_FILENO) == 1;
+    return terminal;
+}
+// The runtime writes straight to the file descriptors rather than through
+// iostreams, whose static initialization every program would otherwise pay.
+void writeAll(int fd, const char* data, size_t size) {
+    // One lock per flush keeps chunks from different threads from interleaving.
+    std::lock_guard<std::mutex> lock(outputMutex);
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+struct OutputBuffer {
+    std::string data;
+    OutputBuffer() { data.reserve(OUTPUT_BUFFER_SIZE); }
+    ~OutputBuffer() { flush(); }
+    void flush() {
+        if (data.empty()) return;
+        writeAll(STDOUT_FILENO, data.data(), data.size());
+        data.clear();
+    }
+};
+OutputBuffer& outputBuffer() {
+    // Destroyed (and so flushed) when its thread exits; for the main thread
+    // that happens in exit() before static destructors run.
+    thread_local OutputBuffer buffer;
+    return buffer;
+}
+const bool outputInitialized = [] {
+    previousTerminate = std::set_terminate([] {
+        outputBuffer().flush();
+        if (previousTerminate) previousTerminate();
+        std::abort();
+    });
+    return true;
+}();
+}
+
+void Output::write(const char* data, size_t size) {
+    OutputBuffer& buffer = outputBuffer();
+    if (buffer.data.size() + size > OUTPUT_BUFFER_SIZE) {
+        buffer.flush();
+        if (size > OUTPUT_BUFFER_SIZE) {
+            writeAll(STDOUT_FILENO, data, size);
+            return;
+        }
+    }
+    buffer.data.append(data, size);
+}
+void Output::write(const char* text) {
+    write(text, std::strlen(text));
+}
+void Output::write(double value) {
+    char digits[32];
+    int length = std::snprintf(digits, sizeof(digits), "%g", value);
+    write(digits, static_cast<size_t>(length));
+}
+void Output::write(long long value) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%lld", value);
+    write(digits, static_cast<size_t>(length));
+}
+void Output::endLine() {
+    write("\n", 1);
+    if (stdoutIsTerminal()) flush();
+}
+void Output::flush() {
+    outputBuffer().flush();
+}
+
+namespace {
+// One parallel loop: the body, how many iterations are still outstanding,
+// and the first exception thrown by the body.
+struct PoolJob {
+    const std::function<void(size_t, size_t)>* body;
+    size_t grain;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed{false};
+    std::mutex errorLock;
+    std::exception_ptr error;
+};
+struct PoolRange {
+    PoolJob* job;
+    size_t begin;
+    size_t end;
+};
+// Owner pushes and pops at the back, thieves take from the front.
+struct PoolQueue {
+    std::mutex lock;
+    std::deque<PoolRange> ranges;
+    std::atomic<size_t> size{0};
+};
+
+// Work-stealing pool. Each worker owns a queue; threads outside the pool
+// (the main thread, Thread.spawn threads) share one more. A thread running a
+// range splits off its upper half whenever its own queue is empty, so ranges
+// are only divided as far as idle threads actually steal them.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads) : threadCount(threads) {
+        for (size_t i = 0; i < threads; i++) queues.push_back(std::make_unique<PoolQueue>());
+        for (size_t i = 0; i + 1 < threads; i++) {
+            std::thread([this, i] { work(i); }).detach();
+        }
+    }
+    size_t concurrency() const { return threadCount; }
+
+    void run(size_t count, const std::function<void(size_t, size_t)>& body) {
+        // About 16 ranges per thread at most before stealing divides them further.
+        size_t grain = std::clamp<size_t>(count / (threadCount * 16), 1, 4096);
+        if (threadCount == 1 || count <= grain) {
+            body(0, count);
+            return;
+        }
+        // Earlier output of this thread comes before anything the loop prints.
+        Output::flush();
+        PoolJob job;
+        job.body = &body;
+        job.grain = grain;
+        job.remaining = count;
+        execute({&job, 0, count});
+        // Help with any work (ours or stolen) until the last range finishes.
+        while (job.remaining.load(std::memory_order_acquire) > 0) {
+            PoolRange range;
+            if (take(range)) {
+                execute(range);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (job.error) std::rethrow_exception(job.error);
+    }
+private:
+    size_t threadCount;
+    std::vector<std::unique_ptr<PoolQueue>> queues;
+    std::atomic<size_t> queued{0};
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    static size_t& queueIndex() {
+        // Workers own queues 0..threads-2; every other thread uses the last one.
+        thread_local size_t index = SIZE_MAX;
+        return index;
+    }
+    PoolQueue& ownQueue() {
+        size_t index = queueIndex();
+        return *queues[index == SIZE_MAX ? queues.size() - 1 : index];
+    }
+
+    void work(size_t index) {
+        queueIndex() = index;
+        while (true) {
+            PoolRange range;
+            if (take(range)) {
+                execute(range);
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [this] { return queued.load() > 0; });
+        }
+    }
+
+    void push(PoolQueue& queue, const PoolRange& range) {
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.ranges.push_back(range);
+            queue.size++;
+        }
+        queued++;
+        { std::lock_guard<std::mutex> guard(sleepLock); }
+        wake.notify_one();
+    }
+
+    bool take(PoolRange& range) {
+        PoolQueue& own = ownQueue();
+        if (own.size.load() > 0) {
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.ranges.empty()) {
+                range = own.ranges.back();
+                own.ranges.pop_back();
+                own.size--;
+                queued--;
+                return true;
+            }
+        }
+        size_t start = queueIndex() == SIZE_MAX ? 0 : queueIndex() + 1;
+        for (size_t i = 0; i < queues.size(); i++) {
+            PoolQueue& victim = *queues[(start + i) % queues.size()];
+            if (&victim == &own || victim.size.load() == 0) continue;
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.ranges.empty()) {
+                range = victim.ranges.front();
+                victim.ranges.pop_front();
+                victim.size--;
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(PoolRange range) {
+        PoolJob& job = *range.job;
+        PoolQueue& own = ownQueue();
+        size_t begin = range.begin;
+        size_t end = range.end;
+        while (begin < end) {
+            while (end - begin >= 2 * job.grain && own.size.load() == 0) {
+                size_t middle = begin + (end - begin) / 2;
+                push(own, {&job, middle, end});
+                end = middle;
+            }
+            size_t stop = std::min(end, begin + job.grain);
+            if (!job.failed.load(std::memory_order_relaxed)) {
+#ifdef UMBRELLA_NO_EXCEPTIONS
+                (*job.body)(begin, stop);
+#else
+                try {
+                    (*job.body)(begin, stop);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(job.errorLock);
+                    if (!job.error) job.error = std::current_exception();
+                    job.failed = true;
+                }
+#endif
+            }
+            size_t done = stop - begin;
+            begin = stop;
+            if (begin == end && queueIndex() != SIZE_MAX) Output::flush();
+            // Last access to the job: its owner may return once this hits zero.
+            job.remaining.fetch_sub(done, std::memory_order_acq_rel);
+        }
+    }
+};
+
+size_t configuredThreads() {
+    if (const char* value = std::getenv("UMBRELLA_THREADS")) {
+        char* end = nullptr;
+        long threads = std::strtol(value, &end, 10);
+        if (end != value && *end == '\0' && threads > 0) return static_cast<size_t>(threads);
+    }
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+WorkStealingPool& pool() {
+    // Created on first use and never destroyed: workers may still be parked
+    // when static destructors run.
+    static WorkStealingPool* instance = new WorkStealingPool(configuredThreads());
+    return *instance;
+}
+}
+
+size_t ThreadPool::concurrency() {
+    return pool().concurrency();
+}
+void ThreadPool::run(size_t count, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    pool().run(count, body);
+}
+
+namespace {
+// Time stamp counter where there is one (converted to nanoseconds at exit
+// against steady_clock), nanoseconds otherwise.
+uint64_t profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+uint64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const uint32_t NO_NODE = UINT32_MAX;
+// One node per distinct call path. Children are found by the site's address;
+// the report merges sites with the same name (template instances of one
+// function have a site each).
+struct ProfileNode {
+    const ProfileSite* site;
+    uint32_t parent;
+    uint32_t firstChild = NO_NODE;
+    uint32_t nextSibling = NO_NODE;
+    uint64_t calls = 0;
+    uint64_t inclusive = 0;
+    uint64_t exclusive = 0;
+};
+struct ProfileFrame {
+    uint32_t node;
+    uint64_t start;
+    uint64_t children; // ticks spent in callees
+};
+struct ProfileThread {
+    std::vector<ProfileNode> nodes{ProfileNode{nullptr, NO_NODE}};
+    std::vector<ProfileFrame> frames;
+    uint32_t current = 0;
+};
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<ProfileThread*> threads;
+    uint64_t startTicks = profileTicks();
+    uint64_t startNanoseconds = steadyNanoseconds();
+};
+void writeProfile();
+ProfileRegistry& profileRegistry() {
+    // Never destroyed: the report runs from atexit, and threads that have
+    // already finished keep their samples here.
+    static ProfileRegistry* registry = [] {
+        auto instance = new ProfileRegistry();
+        std::atexit(writeProfile);
+        return instance;
+    }();
+    return *registry;
+}
+ProfileThread& profileThread() {
+    thread_local ProfileThread* thread = [] {
+        auto& registry = profileRegistry();
+        auto instance = new ProfileThread();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(instance);
+        return instance;
+    }();
+    return *thread;
+}
+void closeFrame(ProfileThread& thread, uint64_t now) {
+    ProfileFrame frame = thread.frames.back();
+    thread.frames.pop_back();
+    ProfileNode& node = thread.nodes[frame.node];
+    uint64_t elapsed = now - frame.start;
+    node.inclusive += elapsed;
+    node.exclusive += elapsed - std::min(elapsed, frame.children);
+    if (!thread.frames.empty()) thread.frames.back().children += elapsed;
+    thread.current = node.parent;
+}
+
+struct FunctionProfile {
+    uint64_t calls = 0;
+    uint64_t inclusive = 0; // outermost activations only, so recursion is not counted twice
+    uint64_t exclusive = 0;
+};
+void collectProfile(const ProfileThread& thread, uint32_t index, const std::string& path,
+                    std::map<std::string, int>& onPath, std::map<std::string, uint64_t>& stacks,
+                    std::map<std::string, FunctionProfile>& functions) {
+    const ProfileNode& node = thread.nodes[index];
+    std::string name = node.site->name;
+    std::string stack = path.empty() ? name : path + ";" + name;
+    stacks[stack] += node.exclusive;
+    FunctionProfile& function = functions[name];
+    function.calls += node.calls;
+    function.exclusive += node.exclusive;
+    if (onPath[name]++ == 0) function.inclusive += node.inclusive;
+    for (uint32_t child = node.firstChild; child != NO_NODE; child = thread.nodes[child].nextSibling) {
+        collectProfile(thread, child, stack, onPath, stacks, functions);
+    }
+    onPath[name]--;
+}
+// Runs from atexit, after the exiting thread's output buffer has been
+// written, so the table follows the program's own output.
+void writeProfile() {
+    auto& registry = profileRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    uint64_t now = profileTicks();
+    // Frames still open when exit() is called from inside a function.
+    ProfileThread& self = profileThread();
+    while (!self.frames.empty()) closeFrame(self, now);
+    double elapsedTicks = static_cast<double>(now - registry.startTicks);
+    double elapsedNanoseconds = static_cast<double>(steadyNanoseconds() - registry.startNanoseconds);
+    double nanosecondsPerTick = elapsedTicks > 0 ? elapsedNanoseconds / elapsedTicks : 1.0;
+
+    std::map<std::string, uint64_t> stacks;
+    std::map<std::string, FunctionProfile> functions;
+    for (const ProfileThread* thread : registry.threads) {
+        std::map<std::string, int> onPath;
+        for (uint32_t root = thread->nodes[0].firstChild; root != NO_NODE; root = thread->nodes[root].nextSibling) {
+            collectProfile(*thread, root, "", onPath, stacks, functions);
+        }
+    }
+    auto micros = [&](uint64_t ticks) { return static_cast<uint64_t>(ticks * nanosecondsPerTick / 1000.0 + 0.5); };
+    auto millis = [&](uint64_t ticks) { return ticks * nanosecondsPerTick / 1e6; };
+
+    const char* path = std::getenv("UMBRELLA_PROFILE");
+    std::string file = path && *path ? path : "umbrella-profile.folded";
+    std::ofstream out(file);
+    for (const auto& [stack, ticks] : stacks) {
+        if (uint64_t weight = micros(ticks)) out << stack << " " << weight << "\n";
+    }
+    out.close();
+
+    std::vector<std::pair<std::string, FunctionProfile>> ranked(functions.begin(), functions.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second.exclusive > b.second.exclusive;
+    });
+    uint64_t totalSelf = 0;
+    for (const auto& entry : ranked) totalSelf += entry.second.exclusive;
+    const size_t TOP = 20;
+    std::ostringstream report;
+    report << "\nProfile: " << ranked.size() << " functions, collapsed stacks in " << file << "\n";
+    report << std::setw(12) << "self ms" << std::setw(8) << "self%" << std::setw(12) << "total ms"
+              << std::setw(12) << "calls" << "  function\n";
+    for (size_t i = 0; i < ranked.size() && i < TOP; i++) {
+        const FunctionProfile& function = ranked[i].second;
+        double share = totalSelf ? 100.0 * function.exclusive / totalSelf : 0.0;
+        report << std::fixed << std::setprecision(2) << std::setw(12) << millis(function.exclusive)
+                  << std::setprecision(1) << std::setw(7) << share << "%" << std::setprecision(2)
+                  << std::setw(12) << millis(function.inclusive) << std::setw(12) << function.calls
+                  << "  " << ranked[i].first << "\n";
+    }
+    std::string text = report.str();
+    writeAll(STDERR_FILENO, text.data(), text.size());
+}
+}
+
+ProfileScope::ProfileScope(const ProfileSite& site) {
+    ProfileThread& thread = profileThread();
+    uint32_t child = thread.nodes[thread.current].firstChild;
+    while (child != NO_NODE && thread.nodes[child].site != &site) child = thread.nodes[child].nextSibling;
+    if (child == NO_NODE) {
+        child = static_cast<uint32_t>(thread.nodes.size());
+        ProfileNode node{&site, thread.current};
+        node.nextSibling = thread.nodes[thread.current].firstChild;
+        thread.nodes[thread.current].firstChild = child;
+        thread.nodes.push_back(node);
+    }
+    thread.nodes[child].calls++;
+    thread.current = child;
+    thread.frames.push_back({child, profileTicks(), 0});
+}
+ProfileScope::~ProfileScope() {
+    uint64_t now = profileTicks();
+    ProfileThread& thread = profileThread();
+    if (!thread.frames.empty()) closeFrame(thread, now);
+}
+
+#ifdef __linux__
+namespace {
+// Sampling profiler, enabled by UMBRELLA_SAMPLE=<hz> (e.g. 1000) without
+// recompiling. SIGPROF fires every 1/hz seconds of process CPU time; the
+// handler captures the interrupted thread's stack into a lock-free ring, and a
+// background thread folds the ring into per-stack counts. At exit the return
+// addresses are symbolized with addr2line: in a binary built with -g the
+// #line directives make that name the .umb file and line directly.
+const int SAMPLE_FRAMES = 64;
+const size_t SAMPLE_RING_SIZE = 4096; // power of two
+struct SampleSlot {
+    std::atomic<uint64_t> sequence;
+    int depth;
+    void* frames[SAMPLE_FRAMES];
+};
+// Bounded multi-producer queue: producers (signal handlers on any thread)
+// claim a slot with a CAS on the enqueue position and publish it through its
+// sequence number; a full ring drops the sample instead of waiting.
+struct SampleRing {
+    SampleSlot slots[SAMPLE_RING_SIZE];
+    std::atomic<uint64_t> enqueuePosition{0};
+    uint64_t dequeuePosition = 0; // consumer side, under SamplerState::mutex
+    std::atomic<uint64_t> dropped{0};
+    SampleRing() {
+        for (size_t i = 0; i < SAMPLE_RING_SIZE; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+};
+struct SamplerState {
+    SampleRing ring;
+    std::mutex mutex;
+    std::map<std::vector<void*>, uint64_t> stacks;
+    uint64_t samples = 0;
+    int hz = 0;
+};
+SamplerState* sampler = nullptr;
+
+void onProfilingSignal(int) {
+    int savedErrno = errno;
+    SampleRing& ring = sampler->ring;
+    uint64_t position = ring.enqueuePosition.load(std::memory_order_relaxed);
+    SampleSlot* slot = nullptr;
+    while (true) {
+        slot = &ring.slots[position & (SAMPLE_RING_SIZE - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (ring.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (sequence < position) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            errno = savedErrno;
+            return;
+        } else {
+            position = ring.enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    // backtrace() only allocates on its first call (loading the unwinder),
+    // which startSampler makes before the timer is armed.
+    slot->depth = backtrace(slot->frames, SAMPLE_FRAMES);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    errno = savedErrno;
+}
+void drainSamples() {
+    SampleRing& ring = sampler->ring;
+    while (true) {
+        SampleSlot& slot = ring.slots[ring.dequeuePosition & (SAMPLE_RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != ring.dequeuePosition + 1) return;
+        // Frames 0 and 1 are the handler and the signal trampoline. Frame 2
+        // is the interrupted instruction itself rather than a return address;
+        // symbolize() looks up address - 1 for every frame, so shift it up.
+        if (slot.depth > 2) {
+            std::vector<void*> stack(slot.frames + 2, slot.frames + slot.depth);
+            stack[0] = static_cast<char*>(stack[0]) + 1;
+            sampler->stacks[std::move(stack)]++;
+            sampler->samples++;
+        }
+        slot.sequence.store(ring.dequeuePosition + SAMPLE_RING_SIZE, std::memory_order_release);
+        ring.dequeuePosition++;
+    }
+}
+
+struct LoadedObject {
+    std::string name;
+    uintptr_t bias;
+    uintptr_t begin;
+    uintptr_t end;
+};
+std::vector<LoadedObject> loadedObjects() {
+    std::vector<LoadedObject> objects;
+    dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) {
+        auto& list = *static_cast<std::vector<LoadedObject>*>(data);
+        for (int i = 0; i < info->dlpi_phnum; i++) {
+            const auto& header = info->dlpi_phdr[i];
+            if (header.p_type != PT_LOAD || !(header.p_flags & PF_X)) continue;
+            uintptr_t begin = info->dlpi_addr + header.p_vaddr;
+            list.push_back({info->dlpi_name ? info->dlpi_name : "", info->dlpi_addr, begin, begin + header.p_memsz});
+        }
+        return 0;
+    }, &objects);
+    return objects;
+}
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+// "work(double)" -> "work"; lambdas keep their enclosing function's name.
+std::string shortFunctionName(const std::string& name) {
+    if (name.rfind("operator", 0) == 0) return name;
+    int depth = 0;
+    for (size_t i = 0; i < name.size(); i++) {
+        if (name[i] == '<') depth++;
+        else if (name[i] == '>') depth--;
+        else if (name[i] == '(' && depth == 0 && i > 0) return name.substr(0, i);
+    }
+    return name;
+}
+// Frame names, innermost first (inlined calls expand into several frames),
+// for each address of the program itself.
+std::map<void*, std::vector<std::string>> symbolize(const std::vector<void*>& addresses) {
+    std::map<void*, std::vector<std::string>> names;
+    std::vector<LoadedObject> objects = loadedObjects();
+    char exe[4096];
+    ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    std::string program = length > 0 ? std::string(exe, length) : "";
+    std::vector<std::pair<void*, uintptr_t>> own; // address, offset in the executable
+    for (void* address : addresses) {
+        uintptr_t pc = reinterpret_cast<uintptr_t>(address);
+        const LoadedObject* object = nullptr;
+        for (const auto& candidate : objects) {
+            if (pc >= candidate.begin && pc < candidate.end) object = &candidate;
+        }
+        if (object && object->name.empty()) {
+            own.push_back({address, pc - object->bias});
+        } else {
+            names[address] = {object ? "[" + baseName(object->name) + "]" : "[unknown]"};
+        }
+    }
+    const size_t BATCH = 256;
+    for (size_t start = 0; start < own.size(); start += BATCH) {
+        std::ostringstream command;
+        command << "addr2line -a -f -C -i -e '" << program << "'";
+        size_t end = std::min(own.size(), start + BATCH);
+        // Return addresses point after the call; look up the call itself.
+        for (size_t i = start; i < end; i++) command << " 0x" << std::hex << own[i].second - 1;
+        command << " 2>/dev/null";
+        FILE* pipe = popen(command.str().c_str(), "r");
+        size_t index = start - 1;
+        std::string function;
+        bool haveFunction = false;
+        char line[8192];
+        while (pipe && fgets(line, sizeof(line), pipe)) {
+            std::string text(line);
+            if (!text.empty() && text.back() == '\n') text.pop_back();
+            if (text.rfind("0x", 0) == 0) {
+                index++;
+                haveFunction = false;
+            } else if (index >= start && index < end) {
+                if (!haveFunction) {
+                    function = text == "??" ? "[unknown]" : shortFunctionName(text);
+                    haveFunction = true;
+                } else {
+                    size_t colon = text.rfind(':');
+                    std::string file = text.substr(0, colon);
+                    std::string lineNumber = colon == std::string::npos ? "" : text.substr(colon + 1);
+                    lineNumber = lineNumber.substr(0, lineNumber.find(' '));
+                    std::string frame = function;
+                    if (file != "??" && lineNumber != "0" && lineNumber != "?") {
+                        frame += " (" + baseName(file) + ":" + lineNumber + ")";
+                    }
+                    names[own[index].first].push_back(frame);
+                    haveFunction = false;
+                }
+            }
+        }
+        if (pipe) pclose(pipe);
+    }
+    for (const auto& entry : own) {
+        if (names[entry.first].empty()) names[entry.first] = {"[unknown]"};
+    }
+    return names;
+}
+
+void stopSampler() {
+    itimerval off{};
+    setitimer(ITIMER_PROF, &off, nullptr);
+    signal(SIGPROF, SIG_IGN);
+    std::lock_guard<std::mutex> lock(sampler->mutex);
+    drainSamples();
+
+    std::vector<void*> addresses;
+    for (const auto& entry : sampler->stacks) {
+        addresses.insert(addresses.end(), entry.first.begin(), entry.first.end());
+    }
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+    auto names = symbolize(addresses);
+
+    std::map<std::string, uint64_t> folded;
+    std::map<std::string, uint64_t> self;
+    for (const auto& [stack, count] : sampler->stacks) {
+        std::vector<std::string> frames; // outermost first
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+            const auto& expanded = names[*it];
+            for (auto name = expanded.rbegin(); name != expanded.rend(); ++name) frames.push_back(*name);
+        }
+        // Start at main when it is on the stack: the frames above it are the C runtime.
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (frames[i].rfind("main", 0) == 0 && (frames[i].size() == 4 || frames[i][4] == ' ')) {
+                frames.erase(frames.begin(), frames.begin() + i);
+                break;
+            }
+        }
+        std::string path;
+        for (const auto& frame : frames) path += (path.empty() ? "" : ";") + frame;
+        folded[path] += count;
+        self[frames.empty() ? "[unknown]" : frames.back()] += count;
+    }
+
+    const char* path = std::getenv("UMBRELLA_SAMPLE_OUT");
+    std::string file = path && *path ? path : "umbrella-samples.folded";
+    std::ofstream out(file);
+    for (const auto& [stack, count] : folded) out << stack << " " << count << "\n";
+    out.close();
+
+    std::vector<std::pair<std::string, uint64_t>> ranked(self.begin(), self.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::ostringstream report;
+    report << "\nSamples: " << sampler->samples << " at " << sampler->hz << " Hz";
+    if (uint64_t dropped = sampler->ring.dropped.load()) report << " (" << dropped << " dropped)";
+    report << ", collapsed stacks in " << file << "\n";
+    report << std::setw(10) << "samples" << std::setw(8) << "self%" << "  location\n";
+    for (size_t i = 0; i < ranked.size() && i < 20; i++) {
+        double share = sampler->samples ? 100.0 * ranked[i].second / sampler->samples : 0.0;
+        report << std::setw(10) << ranked[i].second << std::fixed << std::setprecision(1) << std::setw(7)
+                  << share << "%  " << ranked[i].first << "\n";
+    }
+    std::string text = report.str();
+    writeAll(STDERR_FILENO, text.data(), text.size());
+}
+void startSampler(int hz) {
+    sampler = new SamplerState();
+    sampler->hz = hz;
+    void* warmUp[4];
+    backtrace(warmUp, 4);
+    // Folds the ring often enough that it never fills at this rate; it keeps
+    // SIGPROF blocked so it is never sampled itself.
+    std::thread([] {
+        sigset_t blocked;
+        sigemptyset(&blocked);
+        sigaddset(&blocked, SIGPROF);
+        pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            std::lock_guard<std::mutex> lock(sampler->mutex);
+            drainSamples();
+        }
+    }).detach();
+    struct sigaction action{};
+    action.sa_handler = onProfilingSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+    std::atexit(stopSampler);
+    itimerval timer{};
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = std::max(1, 1000000 / hz);
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+const bool samplerInitialized = [] {
+    const char* value = std::getenv("UMBRELLA_SAMPLE");
+    if (!value || !*value) return false;
+    long hz = std::strtol(value, nullptr, 10);
+    startSampler(hz > 0 ? static_cast<int>(std::min(hz, 100000L)) : 1000);
+    return true;
+}();
+}
+#endif
+
+std::string exceptionMessage(std::exception_ptr error) {
+#ifdef UMBRELLA_NO_EXCEPTIONS
+    (void)error;
+    return "Unknown error";
+#else
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::string& message) {
+        return message;
+    } catch (const char* message) {
+        return message;
+    } catch (...) {
+        return "Unknown error";
+    }
+#endif
+}
+void fatalError(const std::string& message) {
+    Output::flush();
+    std::fprintf(stderr, "Error: %s\n", message.c_str());
+    std::abort();
+}
+
 void print(const std::string& message) {
-    std::cout << message;
+    Output::print(message);
 }
 void println(const std::string& message) {
-    std::cout << message << std::endl;
+    Output::printLine(message);
 }
 std::string toString(double value) {
     // If value is effectively an integer, print as integer
@@ -38,12 +802,15 @@ std::string toString(size_t value) {
 std::string toString(bool value) {
     return value ? "true" : "false";
 }
+// 0 for text that is not a number or is out of range, as std::stod would
+// report by throwing; checked directly, since this path is often hot.
 double toNumber(const std::string& str) {
-    try {
-        return std::stod(str);
-    } catch (...) {
-        return 0.0;
-    }
+    const char* begin = str.c_str();
+    char* end = nullptr;
+    errno = 0;
+    double value = std::strtod(begin, &end);
+    if (end == begin || errno == ERANGE) return 0.0;
+    return value;
 }
 namespace Math {
     double sqrt(double x) {
@@ -79,270 +846,31 @@ namespace Math {
         return static_cast<double>(std::rand()) / RAND_MAX;
     }
 }
-int String::length(const std::string& str) {
-    return static_cast<int>(str.length());
-}
-std::string String::toUpperCase(const std::string& str) {
-    std::string result = str;
-    std::transform(result.begin(), result.end(), result.begin(), ::toupper);
-    return result;
-}
-std::string String::toLowerCase(const std::string& str) {
-    std::string result = str;
-    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-    return result;
-}
-std::string String::substring(const std::string& str, int start, int end) {
-    if (start < 0) start = 0;
-    if (end > static_cast<int>(str.length())) end = str.length();
-    if (start >= end) return "";
-    return str.substr(start, end - start);
-}
-int String::indexOf(const std::string& str, const std::string& search) {
-    size_t pos = str.find(search);
-    return pos == std::string::npos ? -1 : static_cast<int>(pos);
-}
-std::string String::replace(const std::string& str, const std::string& from, const std::string& to) {
-    std::string result = str;
-    size_t pos = result.find(from);
-    if (pos != std::string::npos) {
-        result.replace(pos, from.length(), to);
-    }
-    return result;
-}
-Array<std::string> String::split(const std::string& str, const std::string& delimiter) {
-    std::vector<std::string> tokens;
-    size_t prev = 0, pos = 0;
-    do {
-        pos = str.find(delimiter, prev);
-        if (pos == std::string::npos) pos = str.length();
-        tokens.push_back(str.substr(prev, pos - prev));
-        prev = pos + delimiter.length();
-    } while (pos < str.length() && prev < str.length());
-    return Array<std::string>(tokens);
-}
-std::string String::trim(const std::string& str) {
-    size_t start = str.find_first_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
-    size_t end = str.find_last_not_of(" \t\n\r");
-    return str.substr(start, end - start + 1);
-}
-bool String::startsWith(const std::string& str, const std::string& prefix) {
-    return str.size() >= prefix.size() && 
-           str.compare(0, prefix.size(), prefix) == 0;
-}
-bool String::endsWith(const std::string& str, const std::string& suffix) {
-    return str.size() >= suffix.size() && 
-           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
-}
-std::string String::repeat(const std::string& str, int count) {
-    std::string result;
-    for (int i = 0; i < count; i++) {
-        result += str;
-    }
-    return result;
-}
-std::string String::padStart(const std::string& str, int length, const std::string& pad) {
-    if (static_cast<int>(str.length()) >= length) return str;
-    int padLength = length - str.length();
-    std::string padding;
-    while (static_cast<int>(padding.length()) < padLength) {
-        padding += pad;
-    }
-    return padding.substr(0, padLength) + str;
-}
-std::string String::padEnd(const std::string& str, int length, const std::string& pad) {
-    if (static_cast<int>(str.length()) >= length) return str;
-    int padLength = length - str.length();
-    std::string padding;
-    while (static_cast<int>(padding.length()) < padLength) {
-        padding += pad;
-    }
-    return str + padding.substr(0, padLength);
-}
-long long Date::now() {
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-}
-std::string Date::toISOString(long long timestamp) {
-    std::time_t time = timestamp / 1000;
-    std::tm* tm = std::gmtime(&time);
-    char buffer[30];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", tm);
-    return std::string(buffer);
-}
-std::string Date::toDateString(long long timestamp) {
-    std::time_t time = timestamp / 1000;
-    std::tm* tm = std::localtime(&time);
-    char buffer[30];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", tm);
-    return std::string(buffer);
-}
-std::string Date::toTimeString(long long timestamp) {
-    std::time_t time = timestamp / 1000;
-    std::tm* tm = std::localtime(&time);
-    char buffer[30];
-    std::strftime(buffer, sizeof(buffer), "%H:%M:%S", tm);
-    return std::string(buffer);
-}
-std::string JSON::stringify(const std::string& value) {
-    return "\"" + value + "\"";
-}
-std::string JSON::parse(const std::string& json) {
-    if (json.size() >= 2 && json.front() == '"' && json.back() == '"') {
-        return json.substr(1, json.size() - 2);
-    }
-    return json;
-}
-std::string File::readFile(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + path);
-    }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-void File::writeFile(const std::string& path, const std::string& content) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not write to file: " + path);
-    }
-    file << content;
-}
-bool File::exists(const std::string& path) {
-    std::ifstream file(path);
-    return file.good();
-}
-void File::deleteFile(const std::string& path) {
-    std::remove(path.c_str());
-}
 void Console::log(const std::string& message) {
-    std::cout << message << std::endl;
+    Output::printLine(message);
 }
 void Console::error(const std::string& message) {
-    std::cerr << "[ERROR] " << message << std::endl;
+    // Keep stdout and stderr in order when both go to the same place.
+    Output::flush();
+    std::string line = "[ERROR] " + message + "\n";
+    writeAll(STDERR_FILENO, line.data(), line.size());
 }
 void Console::warn(const std::string& message) {
-    std::cout << "[WARN] " << message << std::endl;
+    Output::printLine("[WARN] ", message);
 }
 void Console::info(const std::string& message) {
-    std::cout << "[INFO] " << message << std::endl;
+    Output::printLine("[INFO] ", message);
+}
+void Console::flush() {
+    Output::flush();
 }
 void Console::clear() {
+    Output::flush();
     #ifdef _WIN32
         system("cls");
     #else
         system("clear");
     #endif
 }
-HTTPResponse HTTP::get(const std::string& url) {
-    return request("GET", url);
-}
-HTTPResponse HTTP::post(const std::string& url, const std::string& body) {
-    return request("POST", url, body);
-}
-HTTPResponse HTTP::put(const std::string& url, const std::string& body) {
-    return request("PUT", url, body);
-}
-HTTPResponse HTTP::del(const std::string& url) {
-    return request("DELETE", url);
-}
-HTTPResponse HTTP::request(const std::string& method, const std::string& url,
-                           const std::string& body,
-                           const std::map<std::string, std::string>& headers) {
-    HTTPResponse response;
-    std::string cmd = "curl -s -w '\\n%{http_code}' ";
-    cmd += "-X " + method + " ";
-    if (!body.empty()) {
-        cmd += "-d '" + body + "' ";
-    }
-    for (const auto& header : headers) {
-        cmd += "-H '" + header.first + ": " + header.second + "' ";
-    }
-    cmd += "'" + url + "'";
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-        response.statusCode = 0;
-        response.body = "Failed to execute request";
-        return response;
-    }
-    char buffer[128];
-    std::string result;
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result += buffer;
-    }
-    pclose(pipe);
-    size_t lastNewline = result.find_last_of('\n');
-    if (lastNewline != std::string::npos && lastNewline > 0) {
-        std::string statusStr = result.substr(lastNewline + 1);
-        response.statusCode = std::stoi(statusStr);
-        response.body = result.substr(0, lastNewline);
-    } else {
-        response.statusCode = 200;
-        response.body = result;
-    }
-    return response;
-}
-Regex::Regex(const std::string& pat) : pattern(pat) {}
-bool Regex::test(const std::string& str) const {
-    std::regex re(pattern);
-    return std::regex_search(str, re);
-}
-Array<std::string> Regex::match(const std::string& str) const {
-    std::vector<std::string> result;
-    std::regex re(pattern);
-    std::smatch matches;
-    if (std::regex_search(str, matches, re)) {
-        for (const auto& match : matches) {
-            result.push_back(match.str());
-        }
-    }
-    return Array<std::string>(result);
-}
-Array<std::string> Regex::findAll(const std::string& str) const {
-    std::vector<std::string> result;
-    std::regex re(pattern);
-    std::sregex_iterator it(str.begin(), str.end(), re);
-    std::sregex_iterator end;
-    while (it != end) {
-        result.push_back(it->str());
-        ++it;
-    }
-    return Array<std::string>(result);
-}
-std::string Regex::replace(const std::string& str, const std::string& replacement) const {
-    std::regex re(pattern);
-    return std::regex_replace(str, re, replacement);
-}
-std::string Env::get(const std::string& name, const std::string& defaultValue) {
-    const char* value = std::getenv(name.c_str());
-    return value ? std::string(value) : defaultValue;
-}
-void Env::set(const std::string& name, const std::string& value) {
-    #ifdef _WIN32
-        _putenv_s(name.c_str(), value.c_str());
-    #else
-        setenv(name.c_str(), value.c_str(), 1);
-    #endif
-}
-bool Env::has(const std::string& name) {
-    return std::getenv(name.c_str()) != nullptr;
-}
-std::string Env::home() {
-    #ifdef _WIN32
-        return get("USERPROFILE", "");
-    #else
-        return get("HOME", "");
-    #endif
-}
-std::string Env::cwd() {
-    char buffer[1024];
-    if (getcwd(buffer, sizeof(buffer)) != nullptr) {
-        return std::string(buffer);
-    }
-    return "";
-}
 }  
 }  
@@ -1,11 +1,32 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <map>
 #include <sstream>
 #include <chrono>
 #include <memory>
 #include <algorithm>
+#include <type_traits>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <variant>
+// Core of the runtime, used by every program. The library classes (String,
+// Map, Regex, JSON, File, HTTP, Database, Thread, Process, Timer, ...) are in
+// headers of their own, included and linked only by programs that use them.
+
+// Runtime errors (an index out of bounds, a missing key, ...) are thrown as
+// exceptions, except when built with --no-exceptions (UMBRELLA_NO_EXCEPTIONS,
+// with -fno-exceptions), where they end the program with the message.
+#ifdef UMBRELLA_NO_EXCEPTIONS
+#define UMBRELLA_THROW(error) ::umbrella::runtime::fatalError((error).what())
+#else
+#define UMBRELLA_THROW(error) throw error
+#endif
 namespace umbrella {
 namespace runtime {
 void print(const std::string& message);
@@ -17,9 +38,221 @@ std::string toString(size_t value);
 std::string toString(bool value);
 double toNumber(const std::string& str);
 
+// Buffered standard output behind print/println and Console. Each thread
+// appends to its own buffer, written out when it fills up, when the thread or
+// the program exits, and on Console.flush(). Spawning or joining a thread,
+// scheduling a timer and releasing a Mutex also write the calling thread's
+// buffer, so output follows the order those establish. When stdout is a
+// terminal the buffer is also written after every line.
+class Output {
+public:
+    template<typename... Args>
+    static void print(const Args&... args) {
+        (write(args), ...);
+    }
+    template<typename... Args>
+    static void printLine(const Args&... args) {
+        (write(args), ...);
+        endLine();
+    }
+    static void write(const char* data, size_t size);
+    static void write(const char* text);
+    static void write(const std::string& text) { write(text.data(), text.size()); }
+    // Numbers and booleans are formatted the way std::ostream does by default.
+    static void write(double value);
+    static void write(bool value) { write(value ? "1" : "0", 1); }
+    static void write(char value) { write(&value, 1); }
+    template<typename T>
+    static void write(const T& value) {
+        if constexpr (std::is_integral_v<T>) {
+            write(static_cast<long long>(value));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            write(static_cast<double>(value));
+        } else {
+            std::ostringstream ss;
+            ss << value;
+            write(ss.str());
+        }
+    }
+    static void write(long long value);
+    static void endLine();
+    // Writes out the calling thread's buffer.
+    static void flush();
+};
+
+// Runs a callable when the enclosing scope is left, normally or by an
+// exception. Backs `finally`; the callable is stored inline, so entering a
+// try block allocates nothing.
+template<typename F>
+class ScopeExit {
+public:
+    explicit ScopeExit(F&& fn) : fn(std::move(fn)) {}
+    ~ScopeExit() { fn(); }
+    ScopeExit(const ScopeExit&) = delete;
+    ScopeExit& operator=(const ScopeExit&) = delete;
+private:
+    F fn;
+};
+template<typename F>
+ScopeExit(F) -> ScopeExit<F>;
+
+// Value bound to the variable of `catch (e)`: the thrown string, or
+// "Unknown error" for anything else.
+std::string exceptionMessage(std::exception_ptr error);
+
+// Writes out this thread's output, prints "Error: <message>" and aborts: an
+// uncaught error under --no-exceptions.
+[[noreturn]] void fatalError(const std::string& message);
+
+// Answer of the non-throwing lookups (tryGet, tryFind, tryPop, tryShift).
+template<typename T>
+class Optional {
+public:
+    Optional() = default;
+    Optional(T value) : slot(std::move(value)) {}
+    bool hasValue() const { return slot.has_value(); }
+    const T& value() const {
+        if (!slot) UMBRELLA_THROW(std::runtime_error("Optional has no value"));
+        return *slot;
+    }
+    T valueOr(T fallback) const { return slot ? *slot : std::move(fallback); }
+    explicit operator bool() const { return slot.has_value(); }
+private:
+    std::optional<T> slot;
+};
+
+// --no-exceptions lowers `throw` and `try` to return values: a function that
+// can throw returns a Result, either its value or the message of the error,
+// and its callers check it and pass the error on to their enclosing `try` or
+// their own caller. No unwinding tables, and no unwinding when an error is
+// raised.
+struct Error {
+    std::string message;
+};
+template<typename T>
+class Result {
+public:
+    template<typename U, typename = std::enable_if_t<std::is_convertible_v<U, T>>>
+    Result(U&& value) : state(std::in_place_index<0>, std::forward<U>(value)) {}
+    Result(Error error) : state(std::in_place_index<1>, std::move(error)) {}
+    bool ok() const { return state.index() == 0; }
+    T take() { return std::move(*std::get_if<0>(&state)); }
+    const std::string& error() const { return std::get_if<1>(&state)->message; }
+private:
+    std::variant<T, Error> state;
+};
+template<>
+class Result<void> {
+public:
+    Result() = default;
+    Result(Error error) : failure(std::move(error.message)), failedCall(true) {}
+    bool ok() const { return !failedCall; }
+    void take() {}
+    const std::string& error() const { return failure; }
+private:
+    std::string failure;
+    bool failedCall = false;
+};
+template<typename T>
+struct IsResult : std::false_type {};
+template<typename T>
+struct IsResult<Result<T>> : std::true_type {};
+
+// Checks the generated code applies to a call that can fail. Any other value
+// passes, so a call to a method that only some classes throw from is checked
+// the same way whatever the receiver.
+template<typename T>
+bool failed(const T& value) {
+    if constexpr (IsResult<T>::value) {
+        return !value.ok();
+    } else {
+        return false;
+    }
+}
+template<typename T>
+std::string errorOf(const T& value) {
+    if constexpr (IsResult<T>::value) {
+        return value.error();
+    } else {
+        return std::string();
+    }
+}
+template<typename T>
+decltype(auto) unwrap(T&& value) {
+    if constexpr (IsResult<std::remove_cvref_t<T>>::value) {
+        return value.take();
+    } else {
+        return std::forward<T>(value);
+    }
+}
+// A failed call where no `try` or Result can take the error: in a lambda, a
+// constructor or at the top level.
+template<typename T>
+decltype(auto) orFail(T&& value) {
+    if (failed(value)) fatalError(errorOf(value));
+    return unwrap(std::forward<T>(value));
+}
+// Message of `throw value`: the string thrown, or "Unknown error" for
+// anything else, as exceptionMessage reports it.
+template<typename T>
+std::string thrownMessage(T&& value) {
+    if constexpr (std::is_convertible_v<T, std::string>) {
+        return std::string(std::forward<T>(value));
+    } else {
+        return "Unknown error";
+    }
+}
+
+// Heap cell for a local shared between a function and a closure that outlives it.
+template<typename T>
+std::shared_ptr<std::decay_t<T>> box(T&& value) {
+    return std::make_shared<std::decay_t<T>>(std::forward<T>(value));
+}
+
+// Shared work-stealing pool behind `parallel for` and the parallel Array
+// methods. Sized by UMBRELLA_THREADS, or the number of hardware threads.
+class ThreadPool {
+public:
+    static size_t concurrency();
+    // Calls body(begin, end) on disjoint ranges covering [0, count), on the
+    // pool's workers and the calling thread, and returns once all are done.
+    // The first exception thrown by body is rethrown here.
+    static void run(size_t count, const std::function<void(size_t, size_t)>& body);
+};
+
+// `parallel for (let i = from; i < to; i = i + 1)`: iterations may run in any
+// order and concurrently.
+template<typename F>
+void parallelFor(double from, double to, F&& body) {
+    if (!(to > from)) return;
+    size_t count = static_cast<size_t>(std::ceil(to - from));
+    ThreadPool::run(count, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) body(from + static_cast<double>(k));
+    });
+}
+
+// Function-level profiler behind `--profile`. Each user function and method
+// opens a ProfileScope on entry; calls and time are accumulated per call path
+// and thread. At exit the paths are written in collapsed-stack form
+// ("main;render;shade 1234", microseconds of self time) to $UMBRELLA_PROFILE
+// or umbrella-profile.folded, for flamegraph.pl or speedscope, and the
+// functions with the most self time are listed on stderr.
+struct ProfileSite {
+    const char* name;
+};
+class ProfileScope {
+public:
+    explicit ProfileScope(const ProfileSite& site);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
 // Forward declaration so Math helpers can accept Array<T>
 template<typename T>
 class Array;
+template<typename T, typename Source>
+class Pipeline;
 
 namespace Math {
     double sqrt(double x);
@@ -38,7 +271,7 @@ namespace Math {
     template<typename T>
     T max(const Array<T>& arr) {
         if (arr.data.empty()) {
-            throw std::runtime_error("Math::max() called on empty array");
+            UMBRELLA_THROW(std::runtime_error("Math::max() called on empty array"));
         }
         T current = arr.data[0];
         for (size_t i = 1; i < arr.data.size(); ++i) {
@@ -52,7 +285,7 @@ namespace Math {
     template<typename T>
     T min(const Array<T>& arr) {
         if (arr.data.empty()) {
-            throw std::runtime_error("Math::min() called on empty array");
+            UMBRELLA_THROW(std::runtime_error("Math::min() called on empty array"));
         }
         T current = arr.data[0];
         for (size_t i = 1; i < arr.data.size(); ++i) {
@@ -70,23 +303,45 @@ public:
     std::vector<T> data;
     Array() = default;
     Array(const std::vector<T>& d) : data(d) {}
+    Array(std::vector<T>&& d) : data(std::move(d)) {}
     Array(std::initializer_list<T> init) : data(init) {}
     size_t length() const { return data.size(); }
+    // Range-for support, used by `for (const x of xs)`.
+    auto begin() { return data.begin(); }
+    auto end() { return data.end(); }
+    auto begin() const { return data.begin(); }
+    auto end() const { return data.end(); }
     void push(const T& value) {
         data.push_back(value);
     }
+    void push(T&& value) {
+        data.push_back(std::move(value));
+    }
     T pop() {
-        if (data.empty()) throw std::runtime_error("Array is empty");
+        if (data.empty()) UMBRELLA_THROW(std::runtime_error("Array is empty"));
         T value = data.back();
         data.pop_back();
         return value;
     }
     T shift() {
-        if (data.empty()) throw std::runtime_error("Array is empty");
+        if (data.empty()) UMBRELLA_THROW(std::runtime_error("Array is empty"));
         T value = data.front();
         data.erase(data.begin());
         return value;
     }
+    // pop and shift that answer an empty Optional on an empty array.
+    Optional<T> tryPop() {
+        if (data.empty()) return {};
+        T value = std::move(data.back());
+        data.pop_back();
+        return value;
+    }
+    Optional<T> tryShift() {
+        if (data.empty()) return {};
+        T value = std::move(data.front());
+        data.erase(data.begin());
+        return value;
+    }
     void unshift(const T& value) {
         data.insert(data.begin(), value);
     }
@@ -152,15 +407,27 @@ public:
                 result.push_back(item);
             }
         }
-        return Array<T>(result);
+        return Array<T>(std::move(result));
     }
-    template<typename Func, typename R>
+    template<typename Func, typename R = std::decay_t<std::invoke_result_t<Func&, const T&>>>
     Array<R> map(Func transform) const {
         std::vector<R> result;
+        result.reserve(data.size());
         for (const auto& item : data) {
             result.push_back(transform(item));
         }
-        return Array<R>(result);
+        return Array<R>(std::move(result));
+    }
+    // Lazy view for chains such as xs.lazy().filter(f).map(g).reduce(h, 0):
+    // the stages run element by element in one pass, with no intermediate
+    // arrays. The view refers to this array, which must outlive it.
+    auto lazy() const {
+        auto source = [items = &data](auto&& sink) {
+            for (const T& item : *items) {
+                if (!sink(item)) return;
+            }
+        };
+        return Pipeline<T, decltype(source)>(source);
     }
     template<typename Func>
     void forEach(Func callback) const {
@@ -190,24 +457,126 @@ public:
         }
         return accumulator;
     }
+    // Parallel counterparts of map/filter/reduce/sort on ThreadPool. The
+    // callbacks run concurrently and must not depend on each other.
+    template<typename Func, typename R = std::decay_t<std::invoke_result_t<Func&, const T&>>>
+    Array<R> parallelMap(Func transform) const {
+        // std::vector<bool> packs bits, so concurrent writes go to chars instead.
+        using Slot = std::conditional_t<std::is_same_v<R, bool>, char, R>;
+        std::vector<Slot> slots(data.size());
+        ThreadPool::run(data.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) slots[i] = transform(data[i]);
+        });
+        if constexpr (std::is_same_v<R, bool>) {
+            return Array<R>(std::vector<R>(slots.begin(), slots.end()));
+        } else {
+            return Array<R>(std::move(slots));
+        }
+    }
+    template<typename Func>
+    Array<T> parallelFilter(Func predicate) const {
+        std::vector<char> keep(data.size());
+        ThreadPool::run(data.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) keep[i] = predicate(data[i]) ? 1 : 0;
+        });
+        std::vector<T> result;
+        for (size_t i = 0; i < data.size(); i++) {
+            if (keep[i]) result.push_back(data[i]);
+        }
+        return Array<T>(std::move(result));
+    }
+    // The reducer must be associative: each range is folded on its own,
+    // starting from its first element, and the partial results are then
+    // folded in order, starting from initialValue. Elements and partial
+    // results go through the same reducer, so R must hold an element.
+    template<typename Func, typename R>
+    R parallelReduce(Func reducer, R initialValue) const {
+        static_assert(std::is_convertible_v<T, R>,
+                      "parallelReduce folds elements and per-chunk results with the same reducer, so the "
+                      "initial value must have the element type; use reduce() to fold into another type");
+        std::mutex lock;
+        std::vector<std::pair<size_t, R>> partials;
+        ThreadPool::run(data.size(), [&](size_t begin, size_t end) {
+            R accumulator = data[begin];
+            for (size_t i = begin + 1; i < end; i++) {
+                accumulator = reducer(accumulator, data[i]);
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            partials.emplace_back(begin, std::move(accumulator));
+        });
+        std::sort(partials.begin(), partials.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        R accumulator = initialValue;
+        for (const auto& partial : partials) {
+            accumulator = reducer(accumulator, partial.second);
+        }
+        return accumulator;
+    }
+    // Sorts blocks concurrently, then merges neighbouring blocks pairwise.
+    void parallelSort() {
+        size_t n = data.size();
+        size_t blocks = std::min(ThreadPool::concurrency() * 4, n / 2048);
+        if (blocks < 2) {
+            std::sort(data.begin(), data.end());
+            return;
+        }
+        std::vector<size_t> bounds(blocks + 1);
+        for (size_t b = 0; b <= blocks; b++) bounds[b] = n * b / blocks;
+        ThreadPool::run(blocks, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; b++) {
+                std::sort(data.begin() + bounds[b], data.begin() + bounds[b + 1]);
+            }
+        });
+        for (size_t width = 1; width < blocks; width *= 2) {
+            size_t merges = (blocks + 2 * width - 1) / (2 * width);
+            ThreadPool::run(merges, [&](size_t begin, size_t end) {
+                for (size_t m = begin; m < end; m++) {
+                    size_t first = m * 2 * width;
+                    size_t middle = std::min(first + width, blocks);
+                    size_t last = std::min(first + 2 * width, blocks);
+                    if (middle < last) {
+                        std::inplace_merge(data.begin() + bounds[first], data.begin() + bounds[middle],
+                                           data.begin() + bounds[last]);
+                    }
+                }
+            });
+        }
+    }
+    // Bounds-checked unless built with --unchecked (UMBRELLA_UNCHECKED).
     T& operator[](size_t index) {
-        if (index >= data.size()) throw std::out_of_range("Array index out of bounds");
+#ifndef UMBRELLA_UNCHECKED
+        if (index >= data.size()) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
+#endif
         return data[index];
     }
     const T& operator[](size_t index) const {
-        if (index >= data.size()) throw std::out_of_range("Array index out of bounds");
+#ifndef UMBRELLA_UNCHECKED
+        if (index >= data.size()) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
+#endif
         return data[index];
     }
     T at(int index) const {
         if (index < 0) index += static_cast<int>(data.size());
-        if (index < 0 || index >= static_cast<int>(data.size())) throw std::out_of_range("Array index out of bounds");
+        if (index < 0 || index >= static_cast<int>(data.size())) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
         return data[index];
     }
     template<typename Func>
     T find(Func predicate) const {
         auto it = std::find_if(data.begin(), data.end(), predicate);
         if (it != data.end()) return *it;
-        throw std::runtime_error("Element not found in Array.find()");
+        UMBRELLA_THROW(std::runtime_error("Element not found in Array.find()"));
+    }
+    // find without the exception when nothing matches.
+    template<typename Func>
+    Optional<T> tryFind(Func predicate) const {
+        auto it = std::find_if(data.begin(), data.end(), predicate);
+        if (it != data.end()) return *it;
+        return {};
+    }
+    template<typename Func>
+    T findOr(Func predicate, T fallback) const {
+        auto it = std::find_if(data.begin(), data.end(), predicate);
+        return it != data.end() ? *it : fallback;
     }
     template<typename Func>
     int findIndex(Func predicate) const {
@@ -217,91 +586,400 @@ public:
     }
 };
 
-class String {
+// Array literal: each element is moved or constructed straight into the
+// storage instead of being copied out of an initializer list.
+template<typename T, typename... Elements>
+Array<T> arrayOf(Elements&&... elements) {
+    Array<T> array;
+    array.data.reserve(sizeof...(Elements));
+    (array.data.emplace_back(std::forward<Elements>(elements)), ...);
+    return array;
+}
+
+// Push-based pipeline of T values. Source is called with a sink that takes
+// each value and returns false to stop early; filter and map wrap it in a
+// new source, and the terminal operations run it once.
+template<typename T, typename Source>
+class Pipeline {
 public:
-    static int length(const std::string& str);
-    static std::string toUpperCase(const std::string& str);
-    static std::string toLowerCase(const std::string& str);
-    static std::string substring(const std::string& str, int start, int end);
-    static int indexOf(const std::string& str, const std::string& search);
-    static std::string replace(const std::string& str, const std::string& from, const std::string& to);
-    static Array<std::string> split(const std::string& str, const std::string& delimiter);
-    static std::string trim(const std::string& str);
-    static bool startsWith(const std::string& str, const std::string& prefix);
-    static bool endsWith(const std::string& str, const std::string& suffix);
-    static std::string repeat(const std::string& str, int count);
-    static std::string padStart(const std::string& str, int length, const std::string& pad = " ");
-    static std::string padEnd(const std::string& str, int length, const std::string& pad = " ");
+    explicit Pipeline(Source s) : source(std::move(s)) {}
+    template<typename Func>
+    auto filter(Func predicate) const {
+        auto next = [source = source, predicate = std::move(predicate)](auto&& sink) mutable {
+            source([&](const T& item) { return predicate(item) ? sink(item) : true; });
+        };
+        return Pipeline<T, decltype(next)>(std::move(next));
+    }
+    template<typename Func>
+    auto map(Func transform) const {
+        using R = std::decay_t<std::invoke_result_t<Func&, const T&>>;
+        auto next = [source = source, transform = std::move(transform)](auto&& sink) mutable {
+            source([&](const T& item) { return sink(transform(item)); });
+        };
+        return Pipeline<R, decltype(next)>(std::move(next));
+    }
+    template<typename Func, typename R>
+    R reduce(Func reducer, R initialValue) const {
+        R accumulator = std::move(initialValue);
+        run([&](const T& item) {
+            accumulator = reducer(accumulator, item);
+            return true;
+        });
+        return accumulator;
+    }
+    template<typename Func>
+    void forEach(Func callback) const {
+        size_t index = 0;
+        run([&](const T& item) {
+            callback(item, index++);
+            return true;
+        });
+    }
+    template<typename Func>
+    bool some(Func predicate) const {
+        bool found = false;
+        run([&](const T& item) {
+            found = predicate(item);
+            return !found;
+        });
+        return found;
+    }
+    template<typename Func>
+    bool every(Func predicate) const {
+        bool all = true;
+        run([&](const T& item) {
+            all = predicate(item);
+            return all;
+        });
+        return all;
+    }
+    Array<T> toArray() const {
+        std::vector<T> result;
+        run([&](const T& item) {
+            result.push_back(item);
+            return true;
+        });
+        return Array<T>(std::move(result));
+    }
+private:
+    Source source;
+    template<typename Sink>
+    void run(Sink&& sink) const {
+        Source pass = source;
+        pass(sink);
+    }
+};
+
+// Struct-of-arrays storage behind Array<T> for a @soa class T: one
+// contiguous column per field, so a loop over one field of every element
+// reads only that field's memory. The code generator specializes Array<T>
+// as a SoAArray<T> and provides, for each @soa class:
+//   - SoALayout<T>::fields, a tuple of pointers to the fields in order;
+//   - SoALayout<T>::Ref<Const>, an element proxy holding a reference to each
+//     field (SoAField<F, Const>), convertible to and assignable from T, so
+//     `xs[i].x` and `xs[i].move(dx)` work on the columns in place;
+//   - a T(SoAFields, field...) constructor used to rebuild whole elements.
+struct SoAFields {};
+template<typename T>
+struct SoALayout;
+template<typename F, bool Const>
+using SoAField = std::conditional_t<Const, const F&, F&>;
+// Column element; the wrapper keeps boolean columns as real bools instead of
+// std::vector<bool> bits, which cannot be bound to a bool&.
+template<typename F>
+struct SoACell {
+    F value;
 };
-template<typename K, typename V>
-class Map {
+
+template<typename T>
+class SoAArray {
+    template<typename C, typename F>
+    static F fieldType(F C::*);
+    template<typename... M>
+    static std::tuple<std::vector<SoACell<decltype(fieldType(std::declval<M>()))>>...> columnsFor(
+        const std::tuple<M...>&);
+    using Columns = decltype(columnsFor(SoALayout<T>::fields));
+    static constexpr size_t FieldCount = std::tuple_size_v<Columns>;
+    using Fields = std::make_index_sequence<FieldCount>;
 public:
-    std::map<K, V> data;
-    Map() = default;
-    Map(const std::map<K, V>& d) : data(d) {}
-    void set(const K& key, const V& value) {
-        data[key] = value;
+    using Ref = typename SoALayout<T>::template Ref<false>;
+    using ConstRef = typename SoALayout<T>::template Ref<true>;
+
+    SoAArray() = default;
+    SoAArray(std::initializer_list<T> init) {
+        reserve(init.size());
+        for (const T& item : init) push(item);
+    }
+    SoAArray(const std::vector<T>& items) {
+        reserve(items.size());
+        for (const T& item : items) push(item);
+    }
+    size_t length() const { return std::get<0>(columns).size(); }
+    void push(const T& value) { pushFields(value, Fields{}); }
+    T pop() {
+        if (length() == 0) UMBRELLA_THROW(std::runtime_error("Array is empty"));
+        T value = get(length() - 1);
+        eraseRange(length() - 1, length(), Fields{});
+        return value;
+    }
+    T shift() {
+        if (length() == 0) UMBRELLA_THROW(std::runtime_error("Array is empty"));
+        T value = get(0);
+        eraseRange(0, 1, Fields{});
+        return value;
+    }
+    Optional<T> tryPop() {
+        if (length() == 0) return {};
+        return pop();
+    }
+    Optional<T> tryShift() {
+        if (length() == 0) return {};
+        return shift();
+    }
+    void unshift(const T& value) {
+        push(value);
+        std::apply([](auto&... column) { (std::rotate(column.rbegin(), column.rbegin() + 1, column.rend()), ...); },
+                   columns);
+    }
+    void reverse() {
+        std::apply([](auto&... column) { (std::reverse(column.begin(), column.end()), ...); }, columns);
+    }
+    void splice(size_t start, size_t deleteCount) {
+        if (start >= length()) return;
+        eraseRange(start, std::min(start + deleteCount, length()), Fields{});
+    }
+    void fill(const T& value, size_t start = 0, size_t end = SIZE_MAX) {
+        for (size_t i = start; i < end && i < length(); i++) (*this)[i] = value;
+    }
+    Array<T> slice(size_t start = 0, size_t end = SIZE_MAX) const {
+        Array<T> result;
+        for (size_t i = start; i < end && i < length(); i++) result.push(get(i));
+        return result;
     }
-    V get(const K& key) const {
-        auto it = data.find(key);
-        if (it == data.end()) throw std::runtime_error("Key not found");
-        return it->second;
+    Array<T> concat(const Array<T>& other) const {
+        Array<T> result;
+        result.reserve(length() + other.length());
+        for (size_t i = 0; i < length(); i++) result.push(get(i));
+        for (size_t i = 0; i < other.length(); i++) result.push(other.get(i));
+        return result;
     }
-    bool has(const K& key) const {
-        return data.find(key) != data.end();
+    void reserve(size_t count) {
+        std::apply([count](auto&... column) { (column.reserve(count), ...); }, columns);
+    }
+
+    // Bounds-checked unless built with --unchecked (UMBRELLA_UNCHECKED).
+    Ref operator[](size_t index) {
+#ifndef UMBRELLA_UNCHECKED
+        if (index >= length()) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
+#endif
+        return refAt<Ref>(*this, index, Fields{});
+    }
+    ConstRef operator[](size_t index) const {
+#ifndef UMBRELLA_UNCHECKED
+        if (index >= length()) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
+#endif
+        return refAt<ConstRef>(*this, index, Fields{});
+    }
+    Ref uncheckedAt(size_t index) { return refAt<Ref>(*this, index, Fields{}); }
+    ConstRef uncheckedAt(size_t index) const { return refAt<ConstRef>(*this, index, Fields{}); }
+    // The element rebuilt as a T.
+    T get(size_t index) const { return getFields(index, Fields{}); }
+    T at(int index) const {
+        if (index < 0) index += static_cast<int>(length());
+        if (index < 0 || index >= static_cast<int>(length())) UMBRELLA_THROW(std::out_of_range("Array index out of bounds"));
+        return get(index);
     }
-    void remove(const K& key) {
-        data.erase(key);
+    // The column of one field, e.g. column<0>() for the first.
+    template<size_t I>
+    auto& column() { return std::get<I>(columns); }
+
+    template<bool Const>
+    class Iterator {
+    public:
+        using Owner = std::conditional_t<Const, const SoAArray, SoAArray>;
+        Iterator(Owner* owner, size_t index) : owner(owner), index(index) {}
+        auto operator*() const { return refAt<std::conditional_t<Const, ConstRef, Ref>>(*owner, index, Fields{}); }
+        Iterator& operator++() {
+            index++;
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+        bool operator==(const Iterator& other) const { return index == other.index; }
+    private:
+        Owner* owner;
+        size_t index;
+    };
+    Iterator<false> begin() { return {this, 0}; }
+    Iterator<false> end() { return {this, length()}; }
+    Iterator<true> begin() const { return {this, 0}; }
+    Iterator<true> end() const { return {this, length()}; }
+
+    // Callbacks receive whole elements, as they do for an ordinary Array<T>.
+    template<typename Func>
+    Array<T> filter(Func predicate) const {
+        Array<T> result;
+        for (size_t i = 0; i < length(); i++) {
+            T item = get(i);
+            if (predicate(item)) result.push(item);
+        }
+        return result;
     }
-    size_t size() const {
-        return data.size();
+    template<typename Func, typename R = std::decay_t<std::invoke_result_t<Func&, const T&>>>
+    Array<R> map(Func transform) const {
+        std::vector<R> result;
+        result.reserve(length());
+        for (size_t i = 0; i < length(); i++) result.push_back(transform(get(i)));
+        return Array<R>(std::move(result));
+    }
+    auto lazy() const {
+        auto source = [self = this](auto&& sink) {
+            for (size_t i = 0; i < self->length(); i++) {
+                if (!sink(self->get(i))) return;
+            }
+        };
+        return Pipeline<T, decltype(source)>(source);
     }
-    void clear() {
-        data.clear();
+    template<typename Func>
+    void forEach(Func callback) const {
+        for (size_t i = 0; i < length(); i++) callback(get(i), i);
     }
-    Array<K> keys() const {
-        std::vector<K> result;
-        for (const auto& pair : data) {
-            result.push_back(pair.first);
+    template<typename Func>
+    bool some(Func predicate) const {
+        for (size_t i = 0; i < length(); i++) {
+            if (predicate(get(i))) return true;
         }
-        return Array<K>(result);
+        return false;
     }
-    Array<V> values() const {
-        std::vector<V> result;
-        for (const auto& pair : data) {
-            result.push_back(pair.second);
+    template<typename Func>
+    bool every(Func predicate) const {
+        for (size_t i = 0; i < length(); i++) {
+            if (!predicate(get(i))) return false;
         }
-        return Array<V>(result);
+        return true;
+    }
+    template<typename Func, typename R>
+    R reduce(Func reducer, R initialValue) const {
+        R accumulator = initialValue;
+        for (size_t i = 0; i < length(); i++) accumulator = reducer(accumulator, get(i));
+        return accumulator;
+    }
+    template<typename Func>
+    T find(Func predicate) const {
+        int index = findIndex(predicate);
+        if (index >= 0) return get(index);
+        UMBRELLA_THROW(std::runtime_error("Element not found in Array.find()"));
+    }
+    template<typename Func>
+    Optional<T> tryFind(Func predicate) const {
+        int index = findIndex(predicate);
+        if (index >= 0) return get(index);
+        return {};
+    }
+    template<typename Func>
+    T findOr(Func predicate, T fallback) const {
+        int index = findIndex(predicate);
+        return index >= 0 ? get(index) : fallback;
+    }
+    template<typename Func>
+    int findIndex(Func predicate) const {
+        for (size_t i = 0; i < length(); i++) {
+            if (predicate(get(i))) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    template<typename Func, typename R = std::decay_t<std::invoke_result_t<Func&, const T&>>>
+    Array<R> parallelMap(Func transform) const {
+        using Slot = std::conditional_t<std::is_same_v<R, bool>, char, R>;
+        std::vector<Slot> slots(length());
+        ThreadPool::run(length(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) slots[i] = transform(get(i));
+        });
+        return Array<R>(std::vector<R>(slots.begin(), slots.end()));
+    }
+    template<typename Func>
+    Array<T> parallelFilter(Func predicate) const {
+        std::vector<char> keep(length());
+        ThreadPool::run(length(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) keep[i] = predicate(get(i)) ? 1 : 0;
+        });
+        Array<T> result;
+        for (size_t i = 0; i < length(); i++) {
+            if (keep[i]) result.push(get(i));
+        }
+        return result;
+    }
+    template<typename Func, typename R>
+    R parallelReduce(Func reducer, R initialValue) const {
+        static_assert(std::is_convertible_v<T, R>,
+                      "parallelReduce folds elements and per-chunk results with the same reducer, so the "
+                      "initial value must have the element type; use reduce() to fold into another type");
+        std::mutex lock;
+        std::vector<std::pair<size_t, R>> partials;
+        ThreadPool::run(length(), [&](size_t begin, size_t end) {
+            R accumulator = get(begin);
+            for (size_t i = begin + 1; i < end; i++) accumulator = reducer(accumulator, get(i));
+            std::lock_guard<std::mutex> guard(lock);
+            partials.emplace_back(begin, std::move(accumulator));
+        });
+        std::sort(partials.begin(), partials.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        R accumulator = initialValue;
+        for (const auto& partial : partials) accumulator = reducer(accumulator, partial.second);
+        return accumulator;
+    }
+private:
+    Columns columns;
+
+    template<typename R, typename Self, size_t... I>
+    static R refAt(Self& self, size_t index, std::index_sequence<I...>) {
+        return R{std::get<I>(self.columns)[index].value...};
+    }
+    template<size_t... I>
+    void pushFields(const T& value, std::index_sequence<I...>) {
+        (std::get<I>(columns).push_back({value.*std::get<I>(SoALayout<T>::fields)}), ...);
+    }
+    template<size_t... I>
+    T getFields(size_t index, std::index_sequence<I...>) const {
+        return T(SoAFields{}, std::get<I>(columns)[index].value...);
+    }
+    template<size_t... I>
+    void eraseRange(size_t first, size_t last, std::index_sequence<I...>) {
+        (std::get<I>(columns).erase(std::get<I>(columns).begin() + first, std::get<I>(columns).begin() + last), ...);
     }
 };
 
-// Simple row type used by Database::query
-struct Row {
-    Map<std::string, std::string> data;
+// Copy of a collection for a for-of loop whose body may resize it.
+template<typename C>
+C snapshot(const C& collection) {
+    return collection;
+}
 
-    std::string get(const std::string& column) const {
-        return data.get(column);
+// Element access the optimizer has proven in range (e.g. `a[i]` in
+// `for (let i = 0; i < a.length; i = i + 1)` with `a` never resized).
+// Arrays of @soa classes return an element proxy instead of a reference.
+template<typename T>
+inline decltype(auto) uncheckedAt(Array<T>& array, size_t index) {
+    if constexpr (requires { array.uncheckedAt(index); }) {
+        return array.uncheckedAt(index);
+    } else {
+        return (array.data[index]);
     }
-};
-class Date {
-public:
-    static long long now();   
-    static std::string toISOString(long long timestamp);
-    static std::string toDateString(long long timestamp);
-    static std::string toTimeString(long long timestamp);
-};
-class JSON {
-public:
-    static std::string stringify(const std::string& value);
-    static std::string parse(const std::string& json);
-};
-class File {
-public:
-    static std::string readFile(const std::string& path);
-    static void writeFile(const std::string& path, const std::string& content);
-    static bool exists(const std::string& path);
-    static void deleteFile(const std::string& path);
-};
+}
+template<typename T>
+inline decltype(auto) uncheckedAt(const Array<T>& array, size_t index) {
+    if constexpr (requires { array.uncheckedAt(index); }) {
+        return array.uncheckedAt(index);
+    } else {
+        return (array.data[index]);
+    }
+}
+inline char& uncheckedAt(std::string& text, size_t index) {
+    return text[index];
+}
+inline const char& uncheckedAt(const std::string& text, size_t index) {
+    return text[index];
+}
+
 class Console {
 public:
     static void log(const std::string& message);
@@ -309,38 +987,7 @@ public:
     static void warn(const std::string& message);
     static void info(const std::string& message);
     static void clear();
-};
-struct HTTPResponse {
-    int statusCode;
-    std::string body;
-    std::map<std::string, std::string> headers;
-};
-class HTTP {
-public:
-    static HTTPResponse get(const std::string& url);
-    static HTTPResponse post(const std::string& url, const std::string& body);
-    static HTTPResponse put(const std::string& url, const std::string& body);
-    static HTTPResponse del(const std::string& url);
-    static HTTPResponse request(const std::string& method, const std::string& url, 
-                               const std::string& body = "",
-                               const std::map<std::string, std::string>& headers = {});
-};
-class Regex {
-public:
-    std::string pattern;
-    Regex(const std::string& pat);
-    bool test(const std::string& str) const;
-    Array<std::string> match(const std::string& str) const;
-    Array<std::string> findAll(const std::string& str) const;
-    std::string replace(const std::string& str, const std::string& replacement) const;
-};
-class Env {
-public:
-    static std::string get(const std::string& name, const std::string& defaultValue = "");
-    static void set(const std::string& name, const std::string& value);
-    static bool has(const std::string& name);
-    static std::string home();
-    static std::string cwd();
+    static void flush();
 };
 }  
 }  
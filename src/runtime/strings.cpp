@@ -0,0 +1,135 @@
+#include "strings.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+namespace umbrella {
+namespace runtime {
+int String::length(std::string_view str) {
+    return static_cast<int>(str.length());
+}
+std::string String::toUpperCase(std::string_view str) {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+    return result;
+}
+std::string String::toLowerCase(std::string_view str) {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+}
+std::string String::substring(std::string_view str, int start, int end) {
+    if (start < 0) start = 0;
+    if (end > static_cast<int>(str.length())) end = str.length();
+    if (start >= end) return "";
+    return std::string(str.substr(start, end - start));
+}
+int String::indexOf(std::string_view str, std::string_view search) {
+    size_t pos = str.find(search);
+    return pos == std::string_view::npos ? -1 : static_cast<int>(pos);
+}
+std::string String::replace(std::string_view str, std::string_view from, std::string_view to) {
+    std::string result(str);
+    size_t pos = result.find(from);
+    if (pos != std::string::npos) {
+        result.replace(pos, from.length(), to);
+    }
+    return result;
+}
+Array<std::string> String::split(std::string_view str, std::string_view delimiter) {
+    std::vector<std::string> tokens;
+    size_t prev = 0, pos = 0;
+    do {
+        pos = str.find(delimiter, prev);
+        if (pos == std::string_view::npos) pos = str.length();
+        tokens.emplace_back(str.substr(prev, pos - prev));
+        prev = pos + delimiter.length();
+    } while (pos < str.length() && prev < str.length());
+    return Array<std::string>(std::move(tokens));
+}
+std::string String::trim(std::string_view str) {
+    size_t start = str.find_first_not_of(" \t\n\r");
+    if (start == std::string_view::npos) return "";
+    size_t end = str.find_last_not_of(" \t\n\r");
+    return std::string(str.substr(start, end - start + 1));
+}
+bool String::startsWith(std::string_view str, std::string_view prefix) {
+    return str.starts_with(prefix);
+}
+bool String::endsWith(std::string_view str, std::string_view suffix) {
+    return str.ends_with(suffix);
+}
+std::string String::repeat(std::string_view str, int count) {
+    std::string result;
+    if (count > 0) result.reserve(str.size() * count);
+    for (int i = 0; i < count; i++) {
+        result += str;
+    }
+    return result;
+}
+std::string String::padStart(std::string_view str, int length, std::string_view pad) {
+    if (static_cast<int>(str.length()) >= length) return std::string(str);
+    int padLength = length - str.length();
+    std::string padding;
+    while (static_cast<int>(padding.length()) < padLength) {
+        padding += pad;
+    }
+    padding.resize(padLength);
+    return padding += str;
+}
+std::string String::padEnd(std::string_view str, int length, std::string_view pad) {
+    if (static_cast<int>(str.length()) >= length) return std::string(str);
+    int padLength = length - str.length();
+    std::string result(str);
+    size_t target = str.length() + padLength;
+    while (result.length() < target) {
+        result += pad;
+    }
+    result.resize(target);
+    return result;
+}
+void StringBuilder::appendRaw(const char* piece, size_t count) {
+    size += count;
+    while (count > 0) {
+        if (chunks.empty() || chunks.back().size() == chunks.back().capacity()) {
+            // Each new chunk is as large as everything before it, so the
+            // number of chunks stays logarithmic in the final length.
+            chunks.emplace_back();
+            chunks.back().reserve(std::max(MIN_CHUNK, std::max(size, count)));
+        }
+        std::string& chunk = chunks.back();
+        size_t room = std::min(count, chunk.capacity() - chunk.size());
+        chunk.append(piece, room);
+        piece += room;
+        count -= room;
+    }
+}
+StringBuilder& StringBuilder::append(const std::string& piece) {
+    appendRaw(piece.data(), piece.size());
+    return *this;
+}
+StringBuilder& StringBuilder::append(const char* piece) {
+    appendRaw(piece, std::strlen(piece));
+    return *this;
+}
+StringBuilder& StringBuilder::append(double value) {
+    return append(umbrella::runtime::toString(value));
+}
+StringBuilder& StringBuilder::appendLine(const std::string& piece) {
+    appendRaw(piece.data(), piece.size());
+    appendRaw("\n", 1);
+    return *this;
+}
+void StringBuilder::clear() {
+    chunks.clear();
+    size = 0;
+}
+std::string StringBuilder::toString() const {
+    std::string result;
+    result.reserve(size);
+    for (const auto& chunk : chunks) {
+        result += chunk;
+    }
+    return result;
+}
+}  
+}  
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+// Parameters are views, so literal and substring arguments are read in place
+// instead of being copied into a temporary std::string first.
+class String {
+public:
+    static int length(std::string_view str);
+    static std::string toUpperCase(std::string_view str);
+    static std::string toLowerCase(std::string_view str);
+    static std::string substring(std::string_view str, int start, int end);
+    static int indexOf(std::string_view str, std::string_view search);
+    static std::string replace(std::string_view str, std::string_view from, std::string_view to);
+    static Array<std::string> split(std::string_view str, std::string_view delimiter);
+    static std::string trim(std::string_view str);
+    static bool startsWith(std::string_view str, std::string_view prefix);
+    static bool endsWith(std::string_view str, std::string_view suffix);
+    static std::string repeat(std::string_view str, int count);
+    static std::string padStart(std::string_view str, int length, std::string_view pad = " ");
+    static std::string padEnd(std::string_view str, int length, std::string_view pad = " ");
+};
+
+// Append-only string buffer. Pieces are copied into chunks that are never
+// reallocated, so building a string piece by piece is linear instead of
+// copying the whole prefix on every `s = s + piece`.
+class StringBuilder {
+public:
+    StringBuilder() = default;
+    StringBuilder& append(const std::string& piece);
+    StringBuilder& append(const char* piece);
+    StringBuilder& append(double value);
+    StringBuilder& appendLine(const std::string& piece = "");
+    size_t length() const { return size; }
+    bool isEmpty() const { return size == 0; }
+    void clear();
+    std::string toString() const;
+private:
+    static constexpr size_t MIN_CHUNK = 256;
+    std::vector<std::string> chunks;
+    size_t size = 0;
+    void appendRaw(const char* piece, size_t count);
+};
+}  
+}  
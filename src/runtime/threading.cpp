@@ -0,0 +1,59 @@
+#include "threading.h"
+#include <thread>
+#include <mutex>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+Thread Thread::spawn(std::function<void()> func) {
+    // Output printed before the spawn appears before anything the thread prints.
+    Output::flush();
+    Thread t;
+    t.handle = new std::thread(func);
+    return t;
+}
+void Thread::join() {
+    // Output printed before the join appears before anything the thread printed.
+    Output::flush();
+    if (handle) {
+        ((std::thread*)handle)->join();
+    }
+}
+void Thread::detach() {
+    if (handle) {
+        ((std::thread*)handle)->detach();
+    }
+}
+bool Thread::joinable() {
+    if (handle) {
+        return ((std::thread*)handle)->joinable();
+    }
+    return false;
+}
+Mutex::Mutex() {
+    handle = new std::mutex();
+}
+Mutex::~Mutex() {
+    if (handle) {
+        delete (std::mutex*)handle;
+    }
+}
+void Mutex::lock() {
+    if (handle) {
+        ((std::mutex*)handle)->lock();
+    }
+}
+void Mutex::unlock() {
+    // Output printed while holding the lock appears before the next holder's.
+    Output::flush();
+    if (handle) {
+        ((std::mutex*)handle)->unlock();
+    }
+}
+bool Mutex::tryLock() {
+    if (handle) {
+        return ((std::mutex*)handle)->try_lock();
+    }
+    return false;
+}
+}  
+}  
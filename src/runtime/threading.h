@@ -0,0 +1,23 @@
+#pragma once
+#include <functional>
+namespace umbrella {
+namespace runtime {
+class Thread {
+public:
+    void* handle;   
+    static Thread spawn(std::function<void()> func);
+    void join();
+    void detach();
+    bool joinable();
+};
+class Mutex {
+public:
+    void* handle;   
+    Mutex();
+    ~Mutex();
+    void lock();
+    void unlock();
+    bool tryLock();
+};
+}  
+}  
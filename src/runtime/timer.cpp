@@ -0,0 +1,57 @@
+#include "timer.h"
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include "runtime.h"
+namespace umbrella {
+namespace runtime {
+void Timer::sleep(int milliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+void Timer::setTimeout(std::function<void()> callback, int milliseconds) {
+    // Output printed before scheduling appears before anything the callback prints.
+    Output::flush();
+    std::thread([callback, milliseconds]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+        callback();
+        Output::flush();
+    }).detach();
+}
+void Timer::setInterval(std::function<void()> callback, int milliseconds) {
+    Output::flush();
+    std::thread([callback, milliseconds]() {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+            callback();
+            Output::flush();
+        }
+    }).detach();
+}
+long long Date::now() {
+    auto now = std::chrono::system_clock::now();
+    auto duration = now.time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+std::string Date::toISOString(long long timestamp) {
+    std::time_t time = timestamp / 1000;
+    std::tm* tm = std::gmtime(&time);
+    char buffer[30];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", tm);
+    return std::string(buffer);
+}
+std::string Date::toDateString(long long timestamp) {
+    std::time_t time = timestamp / 1000;
+    std::tm* tm = std::localtime(&time);
+    char buffer[30];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", tm);
+    return std::string(buffer);
+}
+std::string Date::toTimeString(long long timestamp) {
+    std::time_t time = timestamp / 1000;
+    std::tm* tm = std::localtime(&time);
+    char buffer[30];
+    std::strftime(buffer, sizeof(buffer), "%H:%M:%S", tm);
+    return std::string(buffer);
+}
+}  
+}  
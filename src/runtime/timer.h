@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <functional>
+namespace umbrella {
+namespace runtime {
+class Timer {
+public:
+    static void sleep(int milliseconds);
+    static void setTimeout(std::function<void()> callback, int milliseconds);
+    static void setInterval(std::function<void()> callback, int milliseconds);
+};
+class Date {
+public:
+    static long long now();   
+    static std::string toISOString(long long timestamp);
+    static std::string toDateString(long long timestamp);
+    static std::string toTimeString(long long timestamp);
+};
+}  
+}  
@@ -3,6 +3,10 @@
 #include <sstream>
 #include <string>
 #include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
 #else
@@ -12,6 +16,7 @@
 #include <sys/stat.h>
 #include "compiler/lexer.h"
 #include "compiler/parser.h"
+#include "compiler/optimizer.h"
 #include "compiler/codegen.h"
 using namespace umbrella;
 std::string getExecutablePath() {
@@ -46,6 +51,73 @@ void writeFile(const std::string& filename, const std::string& content) {
     }
     file << content;
 }
+// C++ line -> .umb line table written next to a -g binary, for tools that
+// read the generated file rather than the debug info.
+void writeSourceMap(const std::string& filename, const std::string& source, const std::string& generated,
+                    const std::vector<CodeGenerator::SourceMapping>& mappings) {
+    auto quote = [](const std::string& str) {
+        std::stringstream ss;
+        ss << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') ss << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) ss << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+            else ss << c;
+        }
+        ss << '"';
+        return ss.str();
+    };
+    std::stringstream json;
+    json << "{\n  \"version\": 1,\n  \"source\": " << quote(source) << ",\n  \"generated\": " << quote(generated)
+         << ",\n  \"mappings\": [";
+    for (size_t i = 0; i < mappings.size(); i++) {
+        json << (i == 0 ? "\n    " : ",\n    ") << "[" << mappings[i].cppLine << ", " << mappings[i].umbLine
+             << ", " << mappings[i].umbColumn << "]";
+    }
+    json << "\n  ]\n}\n";
+    writeFile(filename, json.str());
+}
+// Object file for a runtime module, compiled on first use and kept in the
+// cache. The name hashes the flags, the module's source and every runtime
+// header, so editing the runtime or changing -g/--unchecked/--no-exceptions
+// rebuilds it.
+// Returns an empty string if the module does not compile.
+std::string runtimeObject(const RuntimeModule& module, const std::string& includeDir, const std::string& flags,
+                          const std::string& cacheDir, bool verbose) {
+    std::string key = flags + "\n" + readFile(includeDir + "/" + module.source);
+    std::vector<std::filesystem::path> headers;
+    for (const auto& entry : std::filesystem::directory_iterator(includeDir + "/runtime")) {
+        if (entry.path().extension() == ".h") headers.push_back(entry.path());
+    }
+    std::sort(headers.begin(), headers.end());
+    for (const auto& header : headers) key += "\n" + readFile(header.string());
+    std::string objectDir = cacheDir + "/runtime";
+    std::filesystem::create_directories(objectDir);
+    std::string object = objectDir + "/" + module.name + "-" + std::to_string(std::hash<std::string>()(key)) + ".o";
+    if (std::filesystem::exists(object)) return object;
+    // Built under a temporary name so a concurrent compile never links a half-written object.
+    std::string partial = object + "." + std::to_string(getpid());
+    std::string compileCmd = "g++ " + flags + "-I" + includeDir + " -c " + includeDir + "/" + module.source +
+                             " -o " + partial;
+    if (verbose) {
+        std::cout << "Compiling runtime module " << module.name << ": " << compileCmd << "\n";
+    }
+    if (system(compileCmd.c_str()) != 0) {
+        remove(partial.c_str());
+        return "";
+    }
+    std::filesystem::rename(partial, object);
+    return object;
+}
+// Full static linking needs libc.a, which macOS and some distributions lack.
+bool staticLibcAvailable() {
+    FILE* pipe = popen("g++ -print-file-name=libc.a", "r");
+    if (!pipe) return false;
+    char path[PATH_MAX] = {};
+    bool found = fgets(path, sizeof(path), pipe) != nullptr;
+    pclose(pipe);
+    // g++ echoes the bare name back when it finds no such file.
+    return found && std::string(path).find('/') != std::string::npos;
+}
 void printVersion() {
     std::cout << "Umbrella Programming Language Compiler v1.0.0" << std::endl;
     std::cout << "Copyright (c) 2025 Umbrella Programming Language" << std::endl;
@@ -59,6 +131,14 @@ void printHelp() {
     std::cout << "  -o <output>     Specify output executable name (default: a.out)" << std::endl;
     std::cout << "  --emit-cpp      Only generate C++ code without compiling" << std::endl;
     std::cout << "  --verbose       Show detailed compilation steps" << std::endl;
+    std::cout << "  --no-opt        Skip the AST optimization pass" << std::endl;
+    std::cout << "  --unchecked     Drop the remaining array bounds checks (trusted code)" << std::endl;
+    std::cout << "  --dump-ast      Print the AST after optimization" << std::endl;
+    std::cout << "  --opt-report    List the recursive functions turned into loops" << std::endl;
+    std::cout << "  --profile       Time every function; writes collapsed stacks and a summary at exit" << std::endl;
+    std::cout << "  --fast-start    Link statically (where possible) so the program starts faster" << std::endl;
+    std::cout << "  --no-exceptions Build with -fno-exceptions; throw/try become Result values" << std::endl;
+    std::cout << "  -g              Debug info pointing at .umb lines; keeps <output>.cpp and <output>.map.json" << std::endl;
     std::cout << "  --version       Show version information" << std::endl;
     std::cout << "  --help          Show this help message" << std::endl;
 }
@@ -77,6 +157,14 @@ int main(int argc, char* argv[]) {
     bool emitCppOnly = false;
     bool verbose = true;
     bool run = true;
+    bool optimize = true;
+    bool unchecked = false;
+    bool dumpAst = false;
+    bool optReport = false;
+    bool debugInfo = false;
+    bool profile = false;
+    bool fastStart = false;
+    bool noExceptions = false;
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--help") {
@@ -90,6 +178,22 @@ int main(int argc, char* argv[]) {
             run = true;
         } else if (arg == "--no-run") {
             run = false;
+        } else if (arg == "--no-opt") {
+            optimize = false;
+        } else if (arg == "--unchecked") {
+            unchecked = true;
+        } else if (arg == "--dump-ast") {
+            dumpAst = true;
+        } else if (arg == "--opt-report") {
+            optReport = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--fast-start") {
+            fastStart = true;
+        } else if (arg == "--no-exceptions") {
+            noExceptions = true;
+        } else if (arg == "-g") {
+            debugInfo = true;
         } else if (arg == "-o" && i + 1 < argc) {
             outputFile = argv[++i];
         } else if (arg[0] != '-') {
@@ -108,9 +212,15 @@ int main(int argc, char* argv[]) {
         }
         std::string source = readFile(inputFile);
         
-        // Simple hash of standard source content to avoid re-compilation
+        // Simple hash of source content and code-affecting options to avoid re-compilation
+        std::string optionsKey = optimize ? "opt" : "no-opt";
+        if (unchecked) optionsKey += ",unchecked";
+        if (debugInfo) optionsKey += ",debug";
+        if (profile) optionsKey += ",profile";
+        if (fastStart) optionsKey += ",fast-start";
+        if (noExceptions) optionsKey += ",no-exceptions";
         std::hash<std::string> hasher;
-        size_t sourceHash = hasher(source);
+        size_t sourceHash = hasher(source + "\n" + optionsKey);
         std::string cacheDir = std::string(getenv("HOME")) + "/.umbrella/cache";
         std::string cachedBinary = cacheDir + "/" + std::to_string(sourceHash);
         
@@ -120,7 +230,7 @@ int main(int argc, char* argv[]) {
 
         // Check if cached binary exists
         bool useCache = false;
-        if (run && !emitCppOnly) {
+        if (run && !emitCppOnly && !dumpAst && !optReport) {
             std::ifstream cacheFile(cachedBinary);
             if (cacheFile.good()) {
                 useCache = true;
@@ -131,6 +241,9 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        // Cache output file
+        std::string targetBinary = (run && outputFile == "a.out") ? cachedBinary : outputFile;
+
         if (!useCache) {
             if (verbose) {
                 std::cout << "Lexical analysis..." << std::endl;
@@ -152,17 +265,50 @@ int main(int argc, char* argv[]) {
                 std::cout << "AST generated successfully" << std::endl;
                 std::cout.flush();
             }
+            if (optimize) {
+                if (verbose) {
+                    std::cout << "Optimizing AST..." << std::endl;
+                    std::cout.flush();
+                }
+                Optimizer optimizer;
+                optimizer.optimize(*program);
+                if (optReport) {
+                    std::cout << "Optimization report:\n";
+                    for (const auto& line : optimizer.report()) {
+                        std::cout << "  " << line << "\n";
+                    }
+                    if (optimizer.report().empty()) std::cout << "  no recursive functions\n";
+                }
+            }
+            if (dumpAst) {
+                std::cout << "Optimized AST:\n";
+                std::cout << "-------------------\n";
+                std::cout << program->toString();
+                std::cout << "-------------------\n";
+            }
             if (verbose) {
                 std::cout << "Generating C++ code..." << std::endl;
                 std::cout.flush();
             }
+            std::string cppFile = "/tmp/umbrella_temp_" + std::to_string(sourceHash) + ".cpp";
             CodeGenerator codegen;
+            codegen.setProfiling(profile);
+            codegen.setExceptions(!noExceptions);
+            if (debugInfo) {
+                // perf, gdb and sanitizers report .umb lines through #line; the
+                // generated file is kept next to the binary for the glue code.
+                if (!emitCppOnly) cppFile = std::filesystem::absolute(targetBinary).string() + ".cpp";
+                codegen.setLineDirectives(std::filesystem::absolute(inputFile).string(), cppFile);
+            }
             std::string cppCode = codegen.generate(*program);
             if (cppCode.find("int main(") == std::string::npos) {
                 cppCode += "\nint main() {\n    return 0;\n}\n";
             }
-            std::string cppFile = "/tmp/umbrella_temp_" + std::to_string(sourceHash) + ".cpp";
             writeFile(cppFile, cppCode);
+            if (debugInfo && !emitCppOnly) {
+                writeSourceMap(targetBinary + ".map.json", std::filesystem::absolute(inputFile).string(), cppFile,
+                               codegen.sourceMap());
+            }
             if (verbose || emitCppOnly) {
                 std::cout << "Generated C++ code:\n";
                 std::cout << "-------------------\n";
@@ -187,8 +333,6 @@ int main(int argc, char* argv[]) {
                 : ".";
 
             // 1. Try development/build path: ../src/runtime/runtime.cpp
-        std::string runtimePath = compilerDir + "/../src/runtime/runtime.cpp";
-        std::string advancedPath = compilerDir + "/../src/runtime/advanced.cpp";
         std::string includeDir = compilerDir + "/../src";
         
         // Helper to check file existence
@@ -197,40 +341,65 @@ int main(int argc, char* argv[]) {
             return f.good();
         };
 
-        if (!fileExists(runtimePath)) {
+        if (!fileExists(includeDir + "/runtime/runtime.cpp")) {
             // 2. Try installed path: ../include/umbrella/runtime/runtime.cpp
             // (Assuming install(DIRECTORY src/ DESTINATION include/umbrella))
-            std::string installedRuntime = compilerDir + "/../include/umbrella/runtime/runtime.cpp";
-            std::string installedAdvanced = compilerDir + "/../include/umbrella/runtime/advanced.cpp";
             std::string installedInclude = compilerDir + "/../include/umbrella";
             
-            if (fileExists(installedRuntime)) {
-                runtimePath = installedRuntime;
-                advancedPath = installedAdvanced;
+            if (fileExists(installedInclude + "/runtime/runtime.cpp")) {
                 includeDir = installedInclude;
             } else {
                 // If neither found, keep default but warn? Or let g++ fail.
                 if (verbose) {
                     std::cout << "Warning: Could not locate runtime.cpp. Checked:\n"
-                              << "  " << runtimePath << "\n"
-                              << "  " << installedRuntime << "\n";
+                              << "  " << includeDir << "/runtime/runtime.cpp\n"
+                              << "  " << installedInclude << "/runtime/runtime.cpp\n";
                 }
             }
         }
 
-        // Cache output file
-        std::string targetBinary = (run && outputFile == "a.out") ? cachedBinary : outputFile;
-
+        std::string codeFlags = "-std=c++20 -O3 "; // Optimization on by default
+        if (debugInfo) {
+            // DWARF 4: addr2line and older perf misread the DWARF 5 file
+            // table and report the generated file for #line'd code.
+            codeFlags += "-gdwarf-4 -fno-omit-frame-pointer ";
+        }
+        if (unchecked) {
+            codeFlags += "-DUMBRELLA_UNCHECKED ";
+        }
+        if (noExceptions) {
+            // The runtime modules too: no unwinding tables anywhere.
+            codeFlags += "-fno-exceptions -DUMBRELLA_NO_EXCEPTIONS ";
+        }
+        // Only the runtime modules the program uses are linked, each from a
+        // cached object, so only the program itself is compiled every time.
         std::stringstream compileCmd;
-        compileCmd << "g++ -std=c++20 -O3 "; // Optimization on by default
+        compileCmd << "g++ " << codeFlags;
         compileCmd << "-I" << includeDir << " ";
         compileCmd << cppFile << " ";
-        compileCmd << runtimePath << " ";
-        compileCmd << advancedPath << " ";
-        compileCmd << "-o " << targetBinary;
-            
-            // Add sqlite3 if we are linking it
-            compileCmd << " -lsqlite3 "; 
+        std::string libraries;
+        if (verbose) std::cout << "Runtime modules:";
+        for (const RuntimeModule* module : codegen.runtimeModules()) {
+            if (verbose) std::cout << " " << module->name;
+            if (*module->libraries) libraries += std::string(" ") + module->libraries;
+        }
+        if (verbose) std::cout << std::endl;
+        for (const RuntimeModule* module : codegen.runtimeModules()) {
+            if (!module->source) continue;
+            std::string object = runtimeObject(*module, includeDir, codeFlags, cacheDir, verbose);
+            if (object.empty()) {
+                std::cerr << "Error: Could not compile runtime module " << module->name << "\n";
+                return 1;
+            }
+            compileCmd << object << " ";
+        }
+        compileCmd << "-o " << targetBinary << libraries;
+        if (fastStart) {
+            // No dynamic loader work at startup: no shared libraries to map,
+            // no symbol relocation. Without a static libc only the C++ runtime
+            // is linked in.
+            compileCmd << (staticLibcAvailable() ? " -static" : " -static-libstdc++ -static-libgcc");
+        }
 
             if (verbose) {
                 std::cout << "Compile command: " << compileCmd.str() << "\n";
@@ -252,7 +421,7 @@ int main(int argc, char* argv[]) {
                 std::cout << "Output written to: " << outputFile << "\n";
             }
 
-            remove(cppFile.c_str());
+            if (!debugInfo) remove(cppFile.c_str());
         }
 
         if (run) {